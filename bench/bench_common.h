@@ -0,0 +1,193 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Shared helpers for the benchmark programs: timing, key streams and
+ * CSV/JSON result output.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64*, fixed seed so that runs are comparable between releases */
+static inline uint64_t bench_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/* Bijective 64-bit mixer, used to scatter Zipfian ranks over the key space */
+static inline uint64_t bench_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+enum bench_dist {
+    BENCH_DIST_SEQ,
+    BENCH_DIST_RANDOM,
+    BENCH_DIST_ZIPF,
+    BENCH_DIST_SAWTOOTH,
+    BENCH_DIST_NR,
+};
+
+static const char* const bench_dist_names[BENCH_DIST_NR] = {
+    [BENCH_DIST_SEQ] = "seq",
+    [BENCH_DIST_RANDOM] = "random",
+    [BENCH_DIST_ZIPF] = "zipf",
+    [BENCH_DIST_SAWTOOTH] = "sawtooth",
+};
+
+static inline int bench_dist_parse(const char* name) {
+    for (int d = 0; d < BENCH_DIST_NR; d++)
+        if (!strcmp(name, bench_dist_names[d]))
+            return d;
+    return -1;
+}
+
+/*
+ * Zipfian generator over [0, n) with skew theta, after Gray et al.
+ * "Quickly Generating Billion-Record Synthetic Databases" (as used by YCSB).
+ */
+struct bench_zipf {
+    uint64_t n;
+    double theta, alpha, zetan, eta;
+};
+
+static inline void bench_zipf_init(struct bench_zipf* z, uint64_t n,
+                                   double theta) {
+    double zeta2 = 1.0 + pow(0.5, theta);
+
+    z->n = n;
+    z->theta = theta;
+    z->zetan = 0;
+    for (uint64_t i = 1; i <= n; i++)
+        z->zetan += 1.0 / pow((double)i, theta);
+    z->alpha = 1.0 / (1.0 - theta);
+    z->eta =
+        (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+static inline uint64_t bench_zipf_next(const struct bench_zipf* z,
+                                       uint64_t* state) {
+    double u = (double)(bench_rand(state) >> 11) * 0x1.0p-53;
+    double uz = u * z->zetan;
+    uint64_t r;
+
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + pow(0.5, z->theta))
+        return 1;
+    r = (uint64_t)((double)z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return r < z->n ? r : z->n - 1;
+}
+
+/*
+ * Fill @out with @n keys following @dist.
+ *
+ *  seq:      0, 1, 2, ...  (pure append)
+ *  random:   a random permutation of [0, n)
+ *  zipf:     Zipfian (theta 0.99) draws, hot ranks scattered over [0, n)
+ *  sawtooth: ascending runs of ~sqrt(n) keys that restart below the last run,
+ *            each run interleaving into the keys already present
+ */
+static inline void bench_fill_keys(uint64_t* out, size_t n, int dist,
+                                   uint64_t seed) {
+    uint64_t state = seed | 1;
+    size_t i;
+
+    switch (dist) {
+    case BENCH_DIST_SEQ:
+        for (i = 0; i < n; i++)
+            out[i] = i;
+        break;
+    case BENCH_DIST_RANDOM:
+        for (i = 0; i < n; i++)
+            out[i] = i;
+        for (i = n; i > 1; i--) {
+            size_t j = bench_rand(&state) % i;
+            uint64_t t = out[i - 1];
+            out[i - 1] = out[j];
+            out[j] = t;
+        }
+        break;
+    case BENCH_DIST_ZIPF: {
+        struct bench_zipf z;
+
+        bench_zipf_init(&z, n, 0.99);
+        for (i = 0; i < n; i++)
+            out[i] = bench_mix(bench_zipf_next(&z, &state)) % n;
+        break;
+    }
+    case BENCH_DIST_SAWTOOTH: {
+        size_t run = (size_t)sqrt((double)n);
+        size_t teeth;
+
+        if (!run)
+            run = 1;
+        teeth = (n + run - 1) / run;
+        for (i = 0; i < n; i++)
+            out[i] = (i % run) * teeth + i / run;
+        break;
+    }
+    }
+}
+
+/*
+ * Result reporting. CSV prints one row per measurement, JSON prints one
+ * array of objects; both carry the same fields.
+ */
+enum bench_format { BENCH_FMT_CSV, BENCH_FMT_JSON };
+
+struct bench_report {
+    FILE* out;
+    enum bench_format fmt;
+    unsigned long rows;
+};
+
+static inline void bench_report_begin(struct bench_report* r) {
+    r->rows = 0;
+    if (r->fmt == BENCH_FMT_CSV)
+        fprintf(r->out, "op,dist,n,ops,total_ns,ns_per_op\n");
+    else
+        fprintf(r->out, "[\n");
+}
+
+static inline void bench_report_row(struct bench_report* r, const char* op,
+                                    const char* dist, size_t n, uint64_t ops,
+                                    uint64_t total_ns) {
+    double per_op = ops ? (double)total_ns / (double)ops : 0.0;
+
+    if (r->fmt == BENCH_FMT_CSV)
+        fprintf(r->out, "%s,%s,%zu,%llu,%llu,%.2f\n", op, dist, n,
+                (unsigned long long)ops, (unsigned long long)total_ns, per_op);
+    else
+        fprintf(r->out,
+                "%s  {\"op\": \"%s\", \"dist\": \"%s\", \"n\": %zu, "
+                "\"ops\": %llu, \"total_ns\": %llu, \"ns_per_op\": %.2f}",
+                r->rows ? ",\n" : "", op, dist, n, (unsigned long long)ops,
+                (unsigned long long)total_ns, per_op);
+    fflush(r->out);
+    r->rows++;
+}
+
+static inline void bench_report_end(struct bench_report* r) {
+    if (r->fmt == BENCH_FMT_JSON)
+        fprintf(r->out, "\n]\n");
+}
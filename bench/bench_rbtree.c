@@ -0,0 +1,462 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Core operation benchmark: chx_rb_add, chx_rb_find, chx_rb_find_add,
+ * chx_rb_add_hint, chx_rb_next/chx_rb_prev iteration, chx_rb_erase, the
+ * _cached variants, the prefetching variants and a CHX_RB_DECLARE_TREE typed
+ * tree, over a range of tree sizes and key distributions.
+ *
+ * The _prefetch ops prefetch children, the _prefetch2 ops grandchildren too.
+ * Compare them with add/find/find_add across sizes: they should only win once
+ * the tree no longer fits in the last level cache. The same goes for the
+ * _batch ops, which look up BENCH_BATCH keys per call. iter_next/iter_prev
+ * scan with struct chx_rb_iter instead of chx_rb_next/chx_rb_prev.
+ * frozen_find looks up the same keys in a chx_rb_freeze() snapshot, the
+ * eytz_ ops in a chx_rb_eytz_build() export.
+ *
+ * usage: bench_rbtree [-n max_nodes] [-m min_nodes] [-d dist[,dist...]]
+ *                     [-o op[,op...]] [-f csv|json] [-s seed]
+ *
+ * Tree sizes go from min_nodes to max_nodes in steps of 10x.
+ */
+
+#include "bench_common.h"
+#include "rbtree.h"
+#include "rbtree_eytz.h"
+#include "rbtree_frozen.h"
+#include <getopt.h>
+
+struct bench_node {
+    uint64_t key;
+    struct chx_rb_node rb;
+};
+
+#define bench_entry(ptr) chx_rb_entry(ptr, struct bench_node, rb)
+
+static bool bench_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return bench_entry(a)->key < bench_entry(b)->key;
+}
+
+static int bench_cmp(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    uint64_t ka = bench_entry(a)->key, kb = bench_entry(b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static void bench_frozen_key(void* dst, const struct chx_rb_node* node) {
+    memcpy(dst, &bench_entry(node)->key, sizeof(uint64_t));
+}
+
+static int bench_frozen_cmp(const void* key, const void* fkey) {
+    uint64_t k = *(const uint64_t*)key, fk = *(const uint64_t*)fkey;
+    return k < fk ? -1 : k > fk;
+}
+
+static uint64_t bench_eytz_key(const struct chx_rb_node* node) {
+    return bench_entry(node)->key;
+}
+
+static int bench_cmp_cached(const struct chx_rb_node* a,
+                            const struct chx_rb_node* b) {
+    uint64_t ka = bench_entry(a)->key, kb = bench_entry(b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int bench_key_cmp(const void* key, const struct chx_rb_node* node) {
+    uint64_t k = *(const uint64_t*)key, nk = bench_entry(node)->key;
+    return k < nk ? -1 : k > nk;
+}
+
+CHX_RB_DECLARE_TREE(bench_typed, struct bench_node, rb, uint64_t, key,
+                    chx_rb_cmp_scalar)
+
+#define BENCH_BATCH 64
+
+/* Keep the optimizer from discarding lookups whose result is unused */
+static volatile uintptr_t bench_sink;
+
+enum bench_op {
+    OP_ADD,
+    OP_FIND,
+    OP_NEXT,
+    OP_PREV,
+    OP_ERASE,
+    OP_FIND_ADD,
+    OP_ADD_HINT,
+    OP_ADD_TYPED,
+    OP_FIND_TYPED,
+    OP_ADD_PREFETCH,
+    OP_FIND_PREFETCH,
+    OP_FIND_PREFETCH2,
+    OP_FIND_ADD_PREFETCH,
+    OP_FIND_BATCH,
+    OP_FIND_ADD_BATCH,
+    OP_ITER_NEXT,
+    OP_ITER_PREV,
+    OP_FROZEN_FIND,
+    OP_EYTZ_FIND,
+    OP_EYTZ_FIND_BATCH,
+    OP_ADD_CACHED,
+    OP_ERASE_CACHED,
+    OP_FIND_ADD_CACHED,
+    OP_NR,
+};
+
+static const char* const bench_op_names[OP_NR] = {
+    [OP_ADD] = "add",
+    [OP_FIND] = "find",
+    [OP_NEXT] = "next",
+    [OP_PREV] = "prev",
+    [OP_ERASE] = "erase",
+    [OP_FIND_ADD] = "find_add",
+    [OP_ADD_HINT] = "add_hint",
+    [OP_ADD_TYPED] = "add_typed",
+    [OP_FIND_TYPED] = "find_typed",
+    [OP_ADD_PREFETCH] = "add_prefetch",
+    [OP_FIND_PREFETCH] = "find_prefetch",
+    [OP_FIND_PREFETCH2] = "find_prefetch2",
+    [OP_FIND_ADD_PREFETCH] = "find_add_prefetch",
+    [OP_FIND_BATCH] = "find_batch",
+    [OP_FIND_ADD_BATCH] = "find_add_batch",
+    [OP_ITER_NEXT] = "iter_next",
+    [OP_ITER_PREV] = "iter_prev",
+    [OP_FROZEN_FIND] = "frozen_find",
+    [OP_EYTZ_FIND] = "eytz_find",
+    [OP_EYTZ_FIND_BATCH] = "eytz_find_batch",
+    [OP_ADD_CACHED] = "add_cached",
+    [OP_ERASE_CACHED] = "erase_cached",
+    [OP_FIND_ADD_CACHED] = "find_add_cached",
+};
+
+struct bench_run {
+    struct bench_node* nodes;
+    uint64_t* queries;
+    size_t n;
+    uint64_t ns[OP_NR];
+    uint64_t ops[OP_NR];
+};
+
+static void bench_reset(struct bench_run* b) {
+    for (size_t i = 0; i < b->n; i++)
+        CHX_RB_CLEAR_NODE(&b->nodes[i].rb);
+}
+
+static void bench_plain(struct bench_run* b) {
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_node *node, *batch[BENCH_BATCH], *out[BENCH_BATCH];
+    const void* keys[BENCH_BATCH];
+    struct chx_rb_iter iter;
+    struct chx_rb_frozen frozen;
+    struct chx_rb_eytz eytz;
+    uintptr_t acc = 0;
+    uint64_t t;
+    size_t i;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        chx_rb_add(&b->nodes[i].rb, &root, bench_less);
+    b->ns[OP_ADD] += bench_now_ns() - t;
+    b->ops[OP_ADD] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find(&b->queries[i], &root, bench_key_cmp);
+    b->ns[OP_FIND] += bench_now_ns() - t;
+    b->ops[OP_FIND] += b->n;
+
+    /* Snapshot built outside the timed region */
+    if (chx_rb_freeze(&frozen, &root, sizeof(uint64_t), bench_frozen_key)) {
+        t = bench_now_ns();
+        for (i = 0; i < b->n; i++)
+            acc += (uintptr_t)chx_rb_frozen_find(&frozen, &b->queries[i],
+                                                 bench_frozen_cmp);
+        b->ns[OP_FROZEN_FIND] += bench_now_ns() - t;
+        b->ops[OP_FROZEN_FIND] += b->n;
+        chx_rb_frozen_destroy(&frozen);
+    }
+    if (chx_rb_eytz_build(&eytz, &root, bench_eytz_key)) {
+        t = bench_now_ns();
+        for (i = 0; i < b->n; i++)
+            acc += (uintptr_t)chx_rb_eytz_find(&eytz, b->queries[i]);
+        b->ns[OP_EYTZ_FIND] += bench_now_ns() - t;
+        b->ops[OP_EYTZ_FIND] += b->n;
+
+        t = bench_now_ns();
+        for (i = 0; i < b->n; i += BENCH_BATCH) {
+            size_t m = b->n - i < BENCH_BATCH ? b->n - i : BENCH_BATCH;
+
+            chx_rb_eytz_find_batch(&eytz, &b->queries[i], m, out);
+            acc += (uintptr_t)out[m - 1];
+        }
+        b->ns[OP_EYTZ_FIND_BATCH] += bench_now_ns() - t;
+        b->ops[OP_EYTZ_FIND_BATCH] += b->n;
+        chx_rb_eytz_destroy(&eytz);
+    }
+
+    t = bench_now_ns();
+    for (node = chx_rb_first(&root); node; node = chx_rb_next(node))
+        acc += (uintptr_t)node;
+    b->ns[OP_NEXT] += bench_now_ns() - t;
+    b->ops[OP_NEXT] += b->n;
+
+    t = bench_now_ns();
+    for (node = chx_rb_last(&root); node; node = chx_rb_prev(node))
+        acc += (uintptr_t)node;
+    b->ns[OP_PREV] += bench_now_ns() - t;
+    b->ops[OP_PREV] += b->n;
+
+    t = bench_now_ns();
+    chx_rb_iter_for_each(node, &iter, &root)
+        acc += (uintptr_t)node;
+    b->ns[OP_ITER_NEXT] += bench_now_ns() - t;
+    b->ops[OP_ITER_NEXT] += b->n;
+
+    t = bench_now_ns();
+    chx_rb_iter_for_each_reverse(node, &iter, &root)
+        acc += (uintptr_t)node;
+    b->ns[OP_ITER_PREV] += bench_now_ns() - t;
+    b->ops[OP_ITER_PREV] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        chx_rb_erase(&b->nodes[i].rb, &root);
+    b->ns[OP_ERASE] += bench_now_ns() - t;
+    b->ops[OP_ERASE] += b->n;
+
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find_add(&b->nodes[i].rb, &root, bench_cmp);
+    b->ns[OP_FIND_ADD] += bench_now_ns() - t;
+    b->ops[OP_FIND_ADD] += b->n;
+
+    /* Hint with the previously inserted node, right for append patterns */
+    root = CHX_RB_ROOT;
+    bench_reset(b);
+    t = bench_now_ns();
+    chx_rb_add_hint(&b->nodes[0].rb, NULL, &root, bench_less);
+    for (i = 1; i < b->n; i++)
+        chx_rb_add_hint(&b->nodes[i].rb, &b->nodes[i - 1].rb, &root,
+                        bench_less);
+    b->ns[OP_ADD_HINT] += bench_now_ns() - t;
+    b->ops[OP_ADD_HINT] += b->n;
+
+    /* Same as add and find, with the comparison inlined */
+    root = CHX_RB_ROOT;
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        bench_typed_insert(&b->nodes[i], &root);
+    b->ns[OP_ADD_TYPED] += bench_now_ns() - t;
+    b->ops[OP_ADD_TYPED] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)bench_typed_find(b->queries[i], &root);
+    b->ns[OP_FIND_TYPED] += bench_now_ns() - t;
+    b->ops[OP_FIND_TYPED] += b->n;
+
+    root = CHX_RB_ROOT;
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        chx_rb_add_prefetch(&b->nodes[i].rb, &root, bench_less, 1);
+    b->ns[OP_ADD_PREFETCH] += bench_now_ns() - t;
+    b->ops[OP_ADD_PREFETCH] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find_prefetch(&b->queries[i], &root,
+                                               bench_key_cmp, 1);
+    b->ns[OP_FIND_PREFETCH] += bench_now_ns() - t;
+    b->ops[OP_FIND_PREFETCH] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find_prefetch(&b->queries[i], &root,
+                                               bench_key_cmp, 2);
+    b->ns[OP_FIND_PREFETCH2] += bench_now_ns() - t;
+    b->ops[OP_FIND_PREFETCH2] += b->n;
+
+    root = CHX_RB_ROOT;
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find_add_prefetch(&b->nodes[i].rb, &root,
+                                                   bench_cmp, 1);
+    b->ns[OP_FIND_ADD_PREFETCH] += bench_now_ns() - t;
+    b->ops[OP_FIND_ADD_PREFETCH] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i += BENCH_BATCH) {
+        size_t m = b->n - i < BENCH_BATCH ? b->n - i : BENCH_BATCH;
+
+        for (size_t j = 0; j < m; j++)
+            keys[j] = &b->queries[i + j];
+        chx_rb_find_batch(keys, m, &root, bench_key_cmp, out);
+        acc += (uintptr_t)out[0];
+    }
+    b->ns[OP_FIND_BATCH] += bench_now_ns() - t;
+    b->ops[OP_FIND_BATCH] += b->n;
+
+    root = CHX_RB_ROOT;
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i += BENCH_BATCH) {
+        size_t m = b->n - i < BENCH_BATCH ? b->n - i : BENCH_BATCH;
+
+        for (size_t j = 0; j < m; j++)
+            batch[j] = &b->nodes[i + j].rb;
+        chx_rb_find_add_batch(batch, m, &root, bench_cmp, out);
+        acc += (uintptr_t)out[0];
+    }
+    b->ns[OP_FIND_ADD_BATCH] += bench_now_ns() - t;
+    b->ops[OP_FIND_ADD_BATCH] += b->n;
+
+    bench_sink = acc;
+    bench_reset(b);
+}
+
+static void bench_cached(struct bench_run* b) {
+    struct chx_rb_root_cached root = CHX_RB_ROOT_CACHED;
+    uintptr_t acc = 0;
+    uint64_t t;
+    size_t i;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_add_cached(&b->nodes[i].rb, &root, bench_less);
+    b->ns[OP_ADD_CACHED] += bench_now_ns() - t;
+    b->ops[OP_ADD_CACHED] += b->n;
+
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_erase_cached(&b->nodes[i].rb, &root);
+    b->ns[OP_ERASE_CACHED] += bench_now_ns() - t;
+    b->ops[OP_ERASE_CACHED] += b->n;
+
+    bench_reset(b);
+    t = bench_now_ns();
+    for (i = 0; i < b->n; i++)
+        acc += (uintptr_t)chx_rb_find_add_cached(&b->nodes[i].rb, &root,
+                                                 bench_cmp_cached);
+    b->ns[OP_FIND_ADD_CACHED] += bench_now_ns() - t;
+    b->ops[OP_FIND_ADD_CACHED] += b->n;
+
+    bench_sink = acc;
+    bench_reset(b);
+}
+
+static unsigned parse_list(char* arg, const char* const* names, int nr) {
+    unsigned mask = 0;
+
+    for (char* tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+        int i;
+
+        for (i = 0; i < nr; i++)
+            if (!strcmp(tok, names[i]))
+                break;
+        if (i == nr) {
+            fprintf(stderr, "unknown name '%s'\n", tok);
+            exit(2);
+        }
+        mask |= 1u << i;
+    }
+    return mask;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [-n max_nodes] [-m min_nodes] [-d dist[,dist...]]\n"
+            "          [-o op[,op...]] [-f csv|json] [-s seed]\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    struct bench_report report = {.out = stdout, .fmt = BENCH_FMT_CSV};
+    size_t min_n = 1000, max_n = 1000000;
+    unsigned dists = (1u << BENCH_DIST_NR) - 1;
+    unsigned ops = (1u << OP_NR) - 1;
+    uint64_t seed = 0x5eed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:d:o:f:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            max_n = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            min_n = strtoull(optarg, NULL, 0);
+            break;
+        case 'd':
+            dists = parse_list(optarg, bench_dist_names, BENCH_DIST_NR);
+            break;
+        case 'o':
+            ops = parse_list(optarg, bench_op_names, OP_NR);
+            break;
+        case 'f':
+            if (!strcmp(optarg, "csv"))
+                report.fmt = BENCH_FMT_CSV;
+            else if (!strcmp(optarg, "json"))
+                report.fmt = BENCH_FMT_JSON;
+            else
+                usage(argv[0]);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!min_n || min_n > max_n)
+        usage(argv[0]);
+
+    bench_report_begin(&report);
+    for (size_t n = min_n; n <= max_n; n *= 10) {
+        struct bench_run b = {.n = n};
+        uint64_t* keys;
+        /* Small trees are repeated so that every row covers ~1M operations */
+        size_t rounds = n < 1000000 ? 1000000 / n : 1;
+
+        b.nodes = malloc(n * sizeof(*b.nodes));
+        b.queries = malloc(n * sizeof(*b.queries));
+        keys = malloc(n * sizeof(*keys));
+        if (!b.nodes || !b.queries || !keys) {
+            fprintf(stderr, "out of memory at n=%zu\n", n);
+            return 1;
+        }
+
+        for (int d = 0; d < BENCH_DIST_NR; d++) {
+            if (!(dists & (1u << d)))
+                continue;
+
+            bench_fill_keys(keys, n, d, seed);
+            for (size_t i = 0; i < n; i++)
+                b.nodes[i].key = keys[i];
+            bench_fill_keys(b.queries, n, d, seed * 31 + 7);
+            bench_reset(&b);
+            memset(b.ns, 0, sizeof(b.ns));
+            memset(b.ops, 0, sizeof(b.ops));
+
+            for (size_t r = 0; r < rounds; r++) {
+                bench_plain(&b);
+                bench_cached(&b);
+            }
+
+            for (int op = 0; op < OP_NR; op++)
+                if (ops & (1u << op))
+                    bench_report_row(&report, bench_op_names[op],
+                                     bench_dist_names[d], n, b.ops[op],
+                                     b.ns[op]);
+        }
+
+        free(keys);
+        free(b.queries);
+        free(b.nodes);
+        if (n > max_n / 10)
+            break;
+    }
+    bench_report_end(&report);
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+  Interval Trees
+  (C) 2012  Michel Lespinasse <walken@google.com>
+
+
+  include/linux/interval_tree_generic.h
+*/
+
+#pragma once
+
+#include "rbtree_augmented.h"
+
+/*
+ * Template for implementing interval trees
+ *
+ * ITSTRUCT:   struct type of the interval tree nodes
+ * ITRB:       name of struct chx_rb_node field within ITSTRUCT
+ * ITTYPE:     type of the interval endpoints
+ * ITSUBTREE:  name of ITTYPE field within ITSTRUCT holding last-in-subtree
+ * ITSTART(n): start endpoint of ITSTRUCT node n
+ * ITLAST(n):  last endpoint of ITSTRUCT node n
+ * ITSTATIC:   'static' or empty
+ * ITPREFIX:   prefix to use for the inline tree definitions
+ *
+ * Intervals are closed, [ITSTART(n), ITLAST(n)]. The generated functions are
+ *
+ *  ITPREFIX_insert(node, root)       - O(log n)
+ *  ITPREFIX_remove(node, root)       - O(log n)
+ *  ITPREFIX_iter_first(root, s, l)   - first interval overlapping [s, l],
+ *                                      O(log n)
+ *  ITPREFIX_iter_next(node, s, l)    - next one, O(log n) each and
+ *                                      O(log n + k) for a whole query
+ *  ITPREFIX_stab_batch(root, points, n, fn, ctx)
+ *                                    - call fn(node, i, ctx) for every
+ *                                      interval containing points[i], for
+ *                                      all i of an ascending points[] array
+ *
+ * on a struct chx_rb_root_cached.
+ */
+
+#define CHX_INTERVAL_TREE_DEFINE(ITSTRUCT, ITRB, ITTYPE, ITSUBTREE, ITSTART,   \
+                                 ITLAST, ITSTATIC, ITPREFIX)                   \
+    __CHX_INTERVAL_TREE_DEFINE(ITSTRUCT, ITRB, ITTYPE, ITSUBTREE, ITSTART,     \
+                               ITLAST, ITSTATIC, ITPREFIX)
+
+#define __CHX_INTERVAL_TREE_DEFINE(ITSTRUCT, ITRB, ITTYPE, ITSUBTREE, ITSTART, \
+                                   ITLAST, ITSTATIC, ITPREFIX)                 \
+                                                                               \
+    /* Callbacks for augmented rbtree insert and remove */                     \
+                                                                               \
+    CHX_RB_DECLARE_CALLBACKS_MAX(static, ITPREFIX##_augment, ITSTRUCT, ITRB,   \
+                                 ITTYPE, ITSUBTREE, ITLAST)                    \
+                                                                               \
+    /* Insert / remove interval nodes from the tree */                         \
+                                                                               \
+    ITSTATIC void ITPREFIX##_insert(ITSTRUCT* node,                            \
+                                    struct chx_rb_root_cached* root) {         \
+        struct chx_rb_node **link = &root->rb_root.rb_node, *rb_parent = NULL; \
+        ITTYPE start = ITSTART(node), last = ITLAST(node);                     \
+        ITSTRUCT* parent;                                                      \
+        bool leftmost = true;                                                  \
+                                                                               \
+        while (*link) {                                                        \
+            rb_parent = *link;                                                 \
+            parent = chx_rb_entry(rb_parent, ITSTRUCT, ITRB);                  \
+            if (parent->ITSUBTREE < last)                                      \
+                parent->ITSUBTREE = last;                                      \
+            if (start < ITSTART(parent))                                       \
+                link = &parent->ITRB.rb_left;                                  \
+            else {                                                             \
+                link = &parent->ITRB.rb_right;                                 \
+                leftmost = false;                                              \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        node->ITSUBTREE = last;                                                \
+        chx_rb_link_node(&node->ITRB, rb_parent, link);                        \
+        chx_rb_insert_augmented_cached(&node->ITRB, root, leftmost,            \
+                                       &ITPREFIX##_augment);                   \
+    }                                                                          \
+                                                                               \
+    ITSTATIC void ITPREFIX##_remove(ITSTRUCT* node,                            \
+                                    struct chx_rb_root_cached* root) {         \
+        chx_rb_erase_augmented_cached(&node->ITRB, root, &ITPREFIX##_augment); \
+    }                                                                          \
+                                                                               \
+    /*                                                                         \
+     * Iterate over intervals intersecting [start;last]                        \
+     *                                                                         \
+     * Note that a node's interval intersects [start;last] iff:                \
+     *   Cond1: ITSTART(node) <= last                                          \
+     * and                                                                     \
+     *   Cond2: start <= ITLAST(node)                                          \
+     */                                                                        \
+                                                                               \
+    static ITSTRUCT* ITPREFIX##_subtree_search(ITSTRUCT* node, ITTYPE start,   \
+                                               ITTYPE last) {                  \
+        while (true) {                                                         \
+            /*                                                                 \
+             * Loop invariant: start <= node->ITSUBTREE                        \
+             * (Cond2 is satisfied by one of the subtree nodes)                \
+             */                                                                \
+            if (node->ITRB.rb_left) {                                          \
+                ITSTRUCT* left =                                               \
+                    chx_rb_entry(node->ITRB.rb_left, ITSTRUCT, ITRB);          \
+                if (start <= left->ITSUBTREE) {                                \
+                    /*                                                         \
+                     * Some nodes in left subtree satisfy Cond2.               \
+                     * Iterate to find the leftmost such node N.               \
+                     * If it also satisfies Cond1, that's the                  \
+                     * match we are looking for. Otherwise, there              \
+                     * is no matching interval as nodes to the                 \
+                     * right of N can't satisfy Cond1 either.                  \
+                     */                                                        \
+                    node = left;                                               \
+                    continue;                                                  \
+                }                                                              \
+            }                                                                  \
+            if (ITSTART(node) <= last) {   /* Cond1 */                         \
+                if (start <= ITLAST(node)) /* Cond2 */                         \
+                    return node;           /* node is leftmost match */        \
+                if (node->ITRB.rb_right) {                                     \
+                    node = chx_rb_entry(node->ITRB.rb_right, ITSTRUCT, ITRB);  \
+                    if (start <= node->ITSUBTREE)                              \
+                        continue;                                              \
+                }                                                              \
+            }                                                                  \
+            return NULL; /* No match */                                        \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    ITSTATIC ITSTRUCT* ITPREFIX##_iter_first(struct chx_rb_root_cached* root,  \
+                                             ITTYPE start, ITTYPE last) {      \
+        ITSTRUCT *node, *leftmost;                                             \
+                                                                               \
+        if (!root->rb_root.rb_node)                                            \
+            return NULL;                                                       \
+                                                                               \
+        /*                                                                     \
+         * Fastpath range intersection/overlap between A: [a0, a1] and         \
+         * B: [b0, b1] is given by:                                            \
+         *                                                                     \
+         *         a0 <= b1 && b0 <= a1                                        \
+         *                                                                     \
+         *  ... where A holds the query range and B holds the smallest         \
+         * 'start' and largest 'last' in the tree. For the later, we           \
+         * rely on the root node, which by augmented interval tree             \
+         * property, holds the largest value in its last-in-subtree.           \
+         * This allows mitigating some of the tree walk overhead for           \
+         * non-intersecting ranges, maintained and consulted in O(1).          \
+         */                                                                    \
+        node = chx_rb_entry(root->rb_root.rb_node, ITSTRUCT, ITRB);            \
+        if (node->ITSUBTREE < start)                                           \
+            return NULL;                                                       \
+                                                                               \
+        leftmost = chx_rb_entry(root->rb_leftmost, ITSTRUCT, ITRB);            \
+        if (ITSTART(leftmost) > last)                                          \
+            return NULL;                                                       \
+                                                                               \
+        return ITPREFIX##_subtree_search(node, start, last);                   \
+    }                                                                          \
+                                                                               \
+    ITSTATIC ITSTRUCT* ITPREFIX##_iter_next(ITSTRUCT* node, ITTYPE start,      \
+                                            ITTYPE last) {                     \
+        struct chx_rb_node *rb = node->ITRB.rb_right, *prev;                   \
+                                                                               \
+        while (true) {                                                         \
+            /*                                                                 \
+             * Loop invariants:                                                \
+             *   Cond1: ITSTART(node) <= last                                  \
+             *   rb == node->ITRB.rb_right                                     \
+             *                                                                 \
+             * First, search right subtree if suitable                         \
+             */                                                                \
+            if (rb) {                                                          \
+                ITSTRUCT* right = chx_rb_entry(rb, ITSTRUCT, ITRB);            \
+                if (start <= right->ITSUBTREE)                                 \
+                    return ITPREFIX##_subtree_search(right, start, last);      \
+            }                                                                  \
+                                                                               \
+            /* Move up the tree until we come from a node's left child */      \
+            do {                                                               \
+                rb = chx_rb_parent(&node->ITRB);                               \
+                if (!rb)                                                       \
+                    return NULL;                                               \
+                prev = &node->ITRB;                                            \
+                node = chx_rb_entry(rb, ITSTRUCT, ITRB);                       \
+                rb = node->ITRB.rb_right;                                      \
+            } while (prev == rb);                                              \
+                                                                               \
+            /* Check if the node intersects [start;last] */                    \
+            if (last < ITSTART(node)) /* !Cond1 */                             \
+                return NULL;                                                   \
+            else if (start <= ITLAST(node)) /* Cond2 */                        \
+                return node;                                                   \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /*                                                                         \
+     * Batch stabbing queries.                                                 \
+     *                                                                         \
+     * Rather than descending once per point, the sorted points are pushed     \
+     * down the tree together: a subtree only receives the slice of points     \
+     * that can still hit it, so a node is visited once for the whole batch    \
+     * instead of once per point.                                              \
+     *                                                                         \
+     * Within a subtree rooted at node, a point p can only hit an interval if  \
+     * p <= node->ITSUBTREE (Cond2 for some node), and the right subtree and   \
+     * node itself can only be hit by p >= ITSTART(node) (Cond1, as every      \
+     * start there is >= ITSTART(node)).                                       \
+     */                                                                        \
+                                                                               \
+    static size_t ITPREFIX##_stab_lower_bound(const ITTYPE* points, size_t lo, \
+                                              size_t hi, ITTYPE key) {         \
+        while (lo < hi) {                                                      \
+            size_t mid = lo + (hi - lo) / 2;                                   \
+            if (points[mid] < key)                                             \
+                lo = mid + 1;                                                  \
+            else                                                               \
+                hi = mid;                                                      \
+        }                                                                      \
+        return lo;                                                             \
+    }                                                                          \
+                                                                               \
+    static size_t ITPREFIX##_stab_upper_bound(const ITTYPE* points, size_t lo, \
+                                              size_t hi, ITTYPE key) {         \
+        while (lo < hi) {                                                      \
+            size_t mid = lo + (hi - lo) / 2;                                   \
+            if (key < points[mid])                                             \
+                hi = mid;                                                      \
+            else                                                               \
+                lo = mid + 1;                                                  \
+        }                                                                      \
+        return lo;                                                             \
+    }                                                                          \
+                                                                               \
+    static void ITPREFIX##_stab_subtree(                                       \
+        ITSTRUCT* node, const ITTYPE* points, size_t lo, size_t hi,            \
+        void (*fn)(ITSTRUCT* node, size_t idx, void* ctx), void* ctx) {        \
+        size_t i;                                                              \
+                                                                               \
+        while (true) {                                                         \
+            /* Drop the points beyond the last endpoint in this subtree */     \
+            hi = ITPREFIX##_stab_upper_bound(points, lo, hi, node->ITSUBTREE); \
+            if (lo == hi)                                                      \
+                return;                                                        \
+                                                                               \
+            if (node->ITRB.rb_left)                                            \
+                ITPREFIX##_stab_subtree(                                       \
+                    chx_rb_entry(node->ITRB.rb_left, ITSTRUCT, ITRB), points,  \
+                    lo, hi, fn, ctx);                                          \
+                                                                               \
+            /* Only points >= ITSTART(node) can hit node and its right */      \
+            lo = ITPREFIX##_stab_lower_bound(points, lo, hi, ITSTART(node));   \
+            for (i = lo; i < hi && points[i] <= ITLAST(node); i++)             \
+                fn(node, i, ctx);                                              \
+                                                                               \
+            if (!node->ITRB.rb_right)                                          \
+                return;                                                        \
+            node = chx_rb_entry(node->ITRB.rb_right, ITSTRUCT, ITRB);          \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    ITSTATIC void ITPREFIX##_stab_batch(                                       \
+        struct chx_rb_root_cached* root, const ITTYPE* points, size_t npoints, \
+        void (*fn)(ITSTRUCT* node, size_t idx, void* ctx), void* ctx) {        \
+        if (!root->rb_root.rb_node || !npoints)                                \
+            return;                                                            \
+        ITPREFIX##_stab_subtree(                                               \
+            chx_rb_entry(root->rb_root.rb_node, ITSTRUCT, ITRB), points, 0,    \
+            npoints, fn, ctx);                                                 \
+    }
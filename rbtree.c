@@ -21,41 +21,22 @@
 #define unlikely(x) __builtin_expect(!!(x), 0)
 #endif
 
+/*
+ * Relaxed atomics rather than volatile accesses, so that the stores lockless
+ * readers race with are well defined under the C11 memory model. They compile
+ * to plain loads and stores.
+ */
 #ifndef READ_ONCE
-#define READ_ONCE(x) (*(volatile typeof(x)*)&(x))
+#define READ_ONCE(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
 #endif
 
 #ifndef WRITE_ONCE
-#define WRITE_ONCE(x, val) (*(volatile typeof(x)*)&(x) = (val))
+#define WRITE_ONCE(x, val) __atomic_store_n(&(x), (val), __ATOMIC_RELAXED)
 #endif
 
-/* RCU dummy macros for userland */
-#define rcu_assign_pointer(p, v) WRITE_ONCE(p, v)
-#define rcu_dereference_raw(p) READ_ONCE(p)
-
-#define chx_rb_parent(r) ((struct chx_rb_node*)((r)->__rb_parent_color & ~3))
-
-#define CHX_RB_RED 0
-#define CHX_RB_BLACK 1
-
-#define __chx_rb_parent(pc) ((struct chx_rb_node*)(pc & ~3))
-
-#define __chx_rb_color(pc) ((pc) & 1)
-#define __chx_rb_is_black(pc) __chx_rb_color(pc)
-#define __chx_rb_is_red(pc) (!__chx_rb_color(pc))
-#define chx_rb_color(rb) __chx_rb_color((rb)->__rb_parent_color)
-#define chx_rb_is_red(rb) __chx_rb_is_red((rb)->__rb_parent_color)
-#define chx_rb_is_black(rb) __chx_rb_is_black((rb)->__rb_parent_color)
-
-static inline void chx_rb_set_parent(struct chx_rb_node* rb,
-                                     struct chx_rb_node* p) {
-    rb->__rb_parent_color = chx_rb_color(rb) + (unsigned long)p;
-}
-
-static inline void chx_rb_set_parent_color(struct chx_rb_node* rb,
-                                           struct chx_rb_node* p, int color) {
-    rb->__rb_parent_color = (unsigned long)p + color;
-}
+/* RCU publish/subscribe for userland, see rbtree.h */
+#define rcu_assign_pointer(p, v) chx_rcu_assign_pointer(p, v)
+#define rcu_dereference_raw(p) chx_rcu_dereference(p)
 
 static inline void __chx_rb_change_child(struct chx_rb_node* old,
                                          struct chx_rb_node* new_node,
@@ -120,6 +101,11 @@ static inline void __chx_rb_change_child_rcu(struct chx_rb_node* old,
  * It also guarantees that if the lookup returns an element it is the 'correct'
  * one. But not returning an element does _NOT_ mean it's not present.
  *
+ * Newly linked and replacement nodes are published with rcu_assign_pointer()
+ * (a store-release), so a reader that reaches them through
+ * rcu_dereference_raw() also sees their initialized contents. Erased nodes
+ * must not be freed while readers may still hold them; see rbtree_rcu.h.
+ *
  * NOTE:
  *
  * Stores to __rb_parent_color are not important for simple lookups so those
@@ -150,11 +136,16 @@ static inline void __chx_rb_rotate_set_parents(struct chx_rb_node* old,
     __chx_rb_change_child(old, new, parent, root);
 }
 
-static inline void
+/*
+ * Returns true when the fixup ended by blackening the root, which adds one to
+ * the black height of the whole tree; chx_rb_join() keeps track of it.
+ */
+static inline bool
 __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                 void (*augment_rotate)(struct chx_rb_node* old,
                                        struct chx_rb_node* new_node)) {
     struct chx_rb_node *parent = chx_rb_red_parent(node), *gparent, *tmp;
+    unsigned level = 0;
 
     while (true) {
         /*
@@ -167,7 +158,7 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
              * are no longer violating 4).
              */
             chx_rb_set_parent_color(node, NULL, CHX_RB_BLACK);
-            break;
+            return true;
         }
 
         /*
@@ -202,6 +193,9 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                 node = gparent;
                 parent = chx_rb_parent(node);
                 chx_rb_set_parent_color(node, parent, CHX_RB_RED);
+                chx_rb_stat_inc(insert_recolors);
+                chx_rb_trace3(insert_case, root, level, 1);
+                level++;
                 continue;
             }
 
@@ -227,6 +221,8 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                     chx_rb_set_parent_color(tmp, parent, CHX_RB_BLACK);
                 chx_rb_set_parent_color(parent, node, CHX_RB_RED);
                 augment_rotate(parent, node);
+                chx_rb_stat_inc(insert_rotations);
+                chx_rb_trace3(insert_case, root, level, 2);
                 parent = node;
                 tmp = node->rb_right;
             }
@@ -247,6 +243,8 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                 chx_rb_set_parent_color(tmp, gparent, CHX_RB_BLACK);
             __chx_rb_rotate_set_parents(gparent, parent, root, CHX_RB_RED);
             augment_rotate(gparent, parent);
+            chx_rb_stat_inc(insert_rotations);
+            chx_rb_trace3(insert_case, root, level, 3);
             break;
         } else {
             tmp = gparent->rb_left;
@@ -257,6 +255,9 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                 node = gparent;
                 parent = chx_rb_parent(node);
                 chx_rb_set_parent_color(node, parent, CHX_RB_RED);
+                chx_rb_stat_inc(insert_recolors);
+                chx_rb_trace3(insert_case, root, level, 1);
+                level++;
                 continue;
             }
 
@@ -270,6 +271,8 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                     chx_rb_set_parent_color(tmp, parent, CHX_RB_BLACK);
                 chx_rb_set_parent_color(parent, node, CHX_RB_RED);
                 augment_rotate(parent, node);
+                chx_rb_stat_inc(insert_rotations);
+                chx_rb_trace3(insert_case, root, level, 2);
                 parent = node;
                 tmp = node->rb_left;
             }
@@ -281,9 +284,12 @@ __chx_rb_insert(struct chx_rb_node* node, struct chx_rb_root* root,
                 chx_rb_set_parent_color(tmp, gparent, CHX_RB_BLACK);
             __chx_rb_rotate_set_parents(gparent, parent, root, CHX_RB_RED);
             augment_rotate(gparent, parent);
+            chx_rb_stat_inc(insert_rotations);
+            chx_rb_trace3(insert_case, root, level, 3);
             break;
         }
     }
+    return false;
 }
 
 /*
@@ -295,6 +301,7 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                        void (*augment_rotate)(struct chx_rb_node* old,
                                               struct chx_rb_node* new_node)) {
     struct chx_rb_node *node = NULL, *sibling, *tmp1, *tmp2;
+    unsigned level = 0;
 
     while (true) {
         /*
@@ -322,6 +329,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 chx_rb_set_parent_color(tmp1, parent, CHX_RB_BLACK);
                 __chx_rb_rotate_set_parents(parent, sibling, root, CHX_RB_RED);
                 augment_rotate(parent, sibling);
+                chx_rb_stat_inc(erase_rotations);
+                chx_rb_trace3(erase_color_case, root, level, 1);
                 sibling = tmp1;
             }
             tmp1 = sibling->rb_right;
@@ -344,11 +353,14 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                      * p is red when coming from Case 1.
                      */
                     chx_rb_set_parent_color(sibling, parent, CHX_RB_RED);
+                    chx_rb_stat_inc(erase_recolors);
+                    chx_rb_trace3(erase_color_case, root, level, 2);
                     if (chx_rb_is_red(parent))
                         chx_rb_set_black(parent);
                     else {
                         node = parent;
                         parent = chx_rb_parent(node);
+                        level++;
                         if (parent)
                             continue;
                     }
@@ -388,6 +400,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 if (tmp1)
                     chx_rb_set_parent_color(tmp1, sibling, CHX_RB_BLACK);
                 augment_rotate(sibling, tmp2);
+                chx_rb_stat_inc(erase_rotations);
+                chx_rb_trace3(erase_color_case, root, level, 3);
                 tmp1 = sibling;
                 sibling = tmp2;
             }
@@ -411,6 +425,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 chx_rb_set_parent(tmp2, parent);
             __chx_rb_rotate_set_parents(parent, sibling, root, CHX_RB_BLACK);
             augment_rotate(parent, sibling);
+            chx_rb_stat_inc(erase_rotations);
+            chx_rb_trace3(erase_color_case, root, level, 4);
             break;
         } else {
             sibling = parent->rb_left;
@@ -422,6 +438,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 chx_rb_set_parent_color(tmp1, parent, CHX_RB_BLACK);
                 __chx_rb_rotate_set_parents(parent, sibling, root, CHX_RB_RED);
                 augment_rotate(parent, sibling);
+                chx_rb_stat_inc(erase_rotations);
+                chx_rb_trace3(erase_color_case, root, level, 1);
                 sibling = tmp1;
             }
             tmp1 = sibling->rb_left;
@@ -430,11 +448,14 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 if (!tmp2 || chx_rb_is_black(tmp2)) {
                     /* Case 2 - sibling color flip */
                     chx_rb_set_parent_color(sibling, parent, CHX_RB_RED);
+                    chx_rb_stat_inc(erase_recolors);
+                    chx_rb_trace3(erase_color_case, root, level, 2);
                     if (chx_rb_is_red(parent))
                         chx_rb_set_black(parent);
                     else {
                         node = parent;
                         parent = chx_rb_parent(node);
+                        level++;
                         if (parent)
                             continue;
                     }
@@ -448,6 +469,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 if (tmp1)
                     chx_rb_set_parent_color(tmp1, sibling, CHX_RB_BLACK);
                 augment_rotate(sibling, tmp2);
+                chx_rb_stat_inc(erase_rotations);
+                chx_rb_trace3(erase_color_case, root, level, 3);
                 tmp1 = sibling;
                 sibling = tmp2;
             }
@@ -460,6 +483,8 @@ ____chx_rb_erase_color(struct chx_rb_node* parent, struct chx_rb_root* root,
                 chx_rb_set_parent(tmp2, parent);
             __chx_rb_rotate_set_parents(parent, sibling, root, CHX_RB_BLACK);
             augment_rotate(parent, sibling);
+            chx_rb_stat_inc(erase_rotations);
+            chx_rb_trace3(erase_color_case, root, level, 4);
             break;
         }
     }
@@ -674,6 +699,19 @@ struct chx_rb_node* chx_rb_first_postorder(const struct chx_rb_root* root) {
     return chx_rb_left_deepest_node(root->rb_node);
 }
 
+void chx_rb_destroy(struct chx_rb_root* root,
+                    void (*release)(struct chx_rb_node* node, void* ctx),
+                    void* ctx) {
+    struct chx_rb_node *node, *next;
+
+    /* Children are released before their parent, so nothing is relinked */
+    for (node = chx_rb_first_postorder(root); node; node = next) {
+        next = chx_rb_next_postorder(node);
+        release(node, ctx);
+    }
+    root->rb_node = NULL;
+}
+
 struct chx_rb_node*
 __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
                          const struct chx_rb_augment_callbacks* augment) {
@@ -699,6 +737,8 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
         } else
             rebalance = __chx_rb_is_black(pc) ? parent : NULL;
         tmp = parent;
+        chx_rb_stat_inc(erase_cases[0]);
+        chx_rb_trace3(erase_case, root, 0, 1);
     } else if (!child) {
         /* Still case 1, but this time the child is node->rb_left */
         tmp->__rb_parent_color = pc = node->__rb_parent_color;
@@ -706,8 +746,11 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
         __chx_rb_change_child(node, tmp, parent, root);
         rebalance = NULL;
         tmp = parent;
+        chx_rb_stat_inc(erase_cases[0]);
+        chx_rb_trace3(erase_case, root, 0, 1);
     } else {
         struct chx_rb_node *successor = child, *child2;
+        unsigned steps = 0;
 
         tmp = child->rb_left;
         if (!tmp) {
@@ -724,6 +767,8 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
             child2 = successor->rb_right;
 
             augment->copy(node, successor);
+            chx_rb_stat_inc(erase_cases[1]);
+            chx_rb_trace3(erase_case, root, 0, 2);
         } else {
             /*
              * Case 3: node's successor is leftmost under
@@ -743,6 +788,7 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
                 parent = successor;
                 successor = tmp;
                 tmp = tmp->rb_left;
+                steps++;
             } while (tmp);
             child2 = successor->rb_right;
             WRITE_ONCE(parent->rb_left, child2);
@@ -751,6 +797,9 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
 
             augment->copy(node, successor);
             augment->propagate(parent, successor);
+            chx_rb_stat_inc(erase_cases[2]);
+            chx_rb_stat_add(successor_steps, steps);
+            chx_rb_trace3(erase_case, root, steps, 3);
         }
 
         tmp = node->rb_left;
@@ -774,3 +823,166 @@ __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
     augment->propagate(tmp, NULL);
     return rebalance;
 }
+
+/*
+ * Join and split.
+ *
+ * The black height of a subtree is the number of black nodes on any path from
+ * its root down to a leaf, the root included; an empty tree has height 0.
+ * Joining two trees of black heights lh >= rh walks down the right spine of
+ * the taller one to the black node at height rh, puts the red pivot in its
+ * place with the shorter tree as right child, and lets the insert fixup
+ * repair a possible red-red pair. That costs O(lh - rh + 1).
+ *
+ * Splitting cuts the search path for the key: walking back up it, every
+ * path node together with its off-path subtree is joined onto the < or the
+ * >= side. The heights joined on each side only grow, so the join costs
+ * telescope and the whole split is O(log n).
+ */
+
+unsigned __chx_rb_black_height(const struct chx_rb_node* node) {
+    unsigned h = 0;
+
+    for (; node; node = node->rb_left)
+        h += chx_rb_is_black(node);
+    return h;
+}
+
+/*
+ * Join the subtrees @left and @right, of black heights @lh and @rh, with
+ * @pivot in between. Their root parent pointers and colors are not trusted,
+ * so subtrees cut out of another tree can be passed as they are. Returns the
+ * new root and its black height in @h.
+ */
+struct chx_rb_node* __chx_rb_join(struct chx_rb_node* left, unsigned lh,
+                                  struct chx_rb_node* pivot,
+                                  struct chx_rb_node* right, unsigned rh,
+                                  unsigned* h) {
+    struct chx_rb_node *parent = NULL, *cur;
+    struct chx_rb_root root;
+
+    /* Make both sides proper trees: black root, no parent */
+    if (left) {
+        lh += chx_rb_is_red(left);
+        chx_rb_set_parent_color(left, NULL, CHX_RB_BLACK);
+    }
+    if (right) {
+        rh += chx_rb_is_red(right);
+        chx_rb_set_parent_color(right, NULL, CHX_RB_BLACK);
+    }
+
+    if (lh == rh) {
+        pivot->rb_left = left;
+        pivot->rb_right = right;
+        if (left)
+            chx_rb_set_parent(left, pivot);
+        if (right)
+            chx_rb_set_parent(right, pivot);
+        chx_rb_set_parent_color(pivot, NULL, CHX_RB_BLACK);
+        *h = lh + 1;
+        return pivot;
+    }
+
+    if (lh > rh) {
+        root.rb_node = left;
+        cur = left;
+        *h = lh;
+        while (lh > rh || (cur && chx_rb_is_red(cur))) {
+            parent = cur;
+            lh -= chx_rb_is_black(cur);
+            cur = cur->rb_right;
+        }
+        pivot->rb_left = cur;
+        pivot->rb_right = right;
+        parent->rb_right = pivot;
+        if (right)
+            chx_rb_set_parent(right, pivot);
+    } else {
+        root.rb_node = right;
+        cur = right;
+        *h = rh;
+        while (rh > lh || (cur && chx_rb_is_red(cur))) {
+            parent = cur;
+            rh -= chx_rb_is_black(cur);
+            cur = cur->rb_left;
+        }
+        pivot->rb_left = left;
+        pivot->rb_right = cur;
+        parent->rb_left = pivot;
+        if (left)
+            chx_rb_set_parent(left, pivot);
+    }
+    if (cur)
+        chx_rb_set_parent(cur, pivot);
+    chx_rb_set_parent_color(pivot, parent, CHX_RB_RED);
+
+    *h += __chx_rb_insert(pivot, &root, dummy_rotate);
+    return root.rb_node;
+}
+
+void chx_rb_join(struct chx_rb_root* left, struct chx_rb_node* pivot,
+                 struct chx_rb_root* right) {
+    unsigned h;
+
+    if (!pivot) {
+        if (!right->rb_node)
+            return;
+        pivot = chx_rb_first(right);
+        chx_rb_erase(pivot, right);
+    }
+
+    left->rb_node = __chx_rb_join(
+        left->rb_node, __chx_rb_black_height(left->rb_node), pivot,
+        right->rb_node, __chx_rb_black_height(right->rb_node), &h);
+    right->rb_node = NULL;
+}
+
+void chx_rb_split(struct chx_rb_root* tree, const void* key,
+                  int (*cmp)(const void* key, const struct chx_rb_node*),
+                  struct chx_rb_root* ge) {
+    struct chx_rb_node *node = tree->rb_node, *last = NULL, *child = NULL;
+    struct chx_rb_node *lt_root = NULL, *ge_root = NULL, *parent;
+    unsigned lt_h = 0, ge_h = 0, h = 0;
+    bool left = false;
+    int black;
+
+    while (node) {
+        last = node;
+        left = cmp(key, node) <= 0;
+        node = left ? node->rb_left : node->rb_right;
+    }
+
+    /*
+     * Walk back up the search path. @h is the black height of the children of
+     * @node in the original tree; @child is the path node below @node, which
+     * tells the direction taken at @node.
+     */
+    for (node = last; node; child = node, node = parent) {
+        parent = chx_rb_parent(node);
+        black = chx_rb_is_black(node);
+        if (child)
+            left = node->rb_left == child;
+
+        if (left)
+            ge_root = __chx_rb_join(ge_root, ge_h, node, node->rb_right, h,
+                                    &ge_h);
+        else
+            lt_root =
+                __chx_rb_join(node->rb_left, h, node, lt_root, lt_h, &lt_h);
+        h += black;
+    }
+
+    tree->rb_node = lt_root;
+    ge->rb_node = ge_root;
+}
+
+/* Statistics, see rbtree_stats.h */
+__thread struct chx_rb_stats __chx_rb_stats;
+
+void chx_rb_stats_snapshot(struct chx_rb_stats* stats) {
+    *stats = __chx_rb_stats;
+}
+
+void chx_rb_stats_reset(void) {
+    __chx_rb_stats = (struct chx_rb_stats){0};
+}
@@ -17,6 +17,8 @@
 #pragma once
 
 #include "rbtree_types.h"
+#include "rbtree_stats.h"
+#include "rbtree_trace.h"
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -31,6 +33,23 @@
 
 #define chx_rb_entry(ptr, type, member) container_of(ptr, type, member)
 
+/*
+ * Userspace RCU publish/subscribe primitives.
+ *
+ * chx_rcu_assign_pointer() is a store-release: everything written to the
+ * object before it is published is visible to a reader that observes the
+ * new pointer. chx_rcu_dereference() is the matching load-consume (which
+ * compilers currently promote to load-acquire; both are plain loads on x86).
+ *
+ * Readers must additionally be inside a chx_rb_rcu_read_lock() section (see
+ * rbtree_rcu.h) for the memory they reach to stay valid.
+ */
+#define chx_rcu_assign_pointer(p, v)                                           \
+    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define chx_rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+#define chx_rb_parent(r) ((struct chx_rb_node*)((r)->__rb_parent_color & ~3))
+
 #define CHX_RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
 
 /* 'empty' nodes are nodes that are known not to be inserted in an rbtree */
@@ -52,6 +71,15 @@ extern struct chx_rb_node* chx_rb_last(const struct chx_rb_root*);
 extern struct chx_rb_node* chx_rb_first_postorder(const struct chx_rb_root*);
 extern struct chx_rb_node* chx_rb_next_postorder(const struct chx_rb_node*);
 
+/*
+ * Hand every node of @root to @release, children before parents, and leave
+ * @root empty. O(n) with no rebalancing, for dropping a whole tree whose nodes
+ * are not pool allocated. @release may free the node.
+ */
+extern void chx_rb_destroy(struct chx_rb_root* root,
+                           void (*release)(struct chx_rb_node* node, void* ctx),
+                           void* ctx);
+
 /* Fast replacement of a single node without remove/rebalance/add/rebalance */
 extern void chx_rb_replace_node(struct chx_rb_node* victim,
                                 struct chx_rb_node* new_node,
@@ -60,6 +88,87 @@ extern void chx_rb_replace_node_rcu(struct chx_rb_node* victim,
                                     struct chx_rb_node* new_node,
                                     struct chx_rb_root* root);
 
+/*
+ * Link @n nodes, already sorted, into a balanced valid rbtree in O(n) with no
+ * comparator calls or rotations. @root is overwritten, so it should be empty.
+ * The parallel variant builds the top level subtrees on up to @nthreads
+ * threads and produces the same tree.
+ */
+extern void chx_rb_build_sorted(struct chx_rb_node** nodes, size_t n,
+                                struct chx_rb_root* root);
+extern void chx_rb_build_sorted_parallel(struct chx_rb_node** nodes, size_t n,
+                                         struct chx_rb_root* root,
+                                         unsigned nthreads);
+
+/*
+ * chx_rb_join() moves every node of @right into @left, with @pivot linked in
+ * between. All nodes of @left must order before @pivot and all nodes of
+ * @right after it. A NULL @pivot concatenates the two trees, using the first
+ * node of @right. @right is left empty. O(log n).
+ *
+ * chx_rb_split() moves the nodes of @tree that do not order before @key into
+ * @ge, which is overwritten, so it should be empty. @cmp has the same meaning
+ * as for chx_rb_find(). O(log n).
+ *
+ * Neither maintains augmented data.
+ */
+extern void chx_rb_join(struct chx_rb_root* left, struct chx_rb_node* pivot,
+                        struct chx_rb_root* right);
+extern void chx_rb_split(struct chx_rb_root* tree, const void* key,
+                         int (*cmp)(const void* key,
+                                    const struct chx_rb_node*),
+                         struct chx_rb_root* ge);
+
+/*
+ * Set operations: the result is left in @a and @b is emptied. On equal keys
+ * the node from @b is kept. Every node of either tree that is not part of
+ * the result is passed to @drop (if not NULL) with @ctx; above a size cutoff
+ * the work is spread over up to @nthreads threads, so @drop may be called
+ * concurrently. Keys should be unique within each tree.
+ *
+ * chx_rb_union():      nodes in @a or @b
+ * chx_rb_intersect():  nodes in both @a and @b
+ * chx_rb_difference(): nodes in @a but not in @b
+ */
+extern void chx_rb_union(struct chx_rb_root* a, struct chx_rb_root* b,
+                         int (*cmp)(const struct chx_rb_node* a,
+                                    const struct chx_rb_node* b),
+                         void (*drop)(struct chx_rb_node* node, void* ctx),
+                         void* ctx, unsigned nthreads);
+extern void chx_rb_intersect(struct chx_rb_root* a, struct chx_rb_root* b,
+                             int (*cmp)(const struct chx_rb_node* a,
+                                        const struct chx_rb_node* b),
+                             void (*drop)(struct chx_rb_node* node, void* ctx),
+                             void* ctx, unsigned nthreads);
+extern void chx_rb_difference(struct chx_rb_root* a, struct chx_rb_root* b,
+                              int (*cmp)(const struct chx_rb_node* a,
+                                         const struct chx_rb_node* b),
+                              void (*drop)(struct chx_rb_node* node, void* ctx),
+                              void* ctx, unsigned nthreads);
+
+/*
+ * Visit every node on up to @nthreads threads. The top of the tree is cut
+ * into in-order pieces, whole subtrees and the nodes between them, which
+ * threads claim one at a time; @fn is called concurrently but each piece is
+ * visited in order. The tree must not change meanwhile. Small trees are
+ * visited on the calling thread, and @nthreads is capped at 256.
+ *
+ * chx_rb_parallel_reduce() folds each piece into its own copy of @acc, of
+ * @acc_size bytes, which holds the identity on entry. The copies are then
+ * merged into @acc from left to right with @combine(acc, right, ctx), so
+ * the result is the in-order fold; @combine must be associative but need
+ * not be commutative.
+ */
+extern void chx_rb_parallel_for_each(const struct chx_rb_root* root,
+                                     void (*fn)(struct chx_rb_node* node,
+                                                void* ctx),
+                                     void* ctx, unsigned nthreads);
+extern void chx_rb_parallel_reduce(
+    const struct chx_rb_root* root,
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx),
+    void (*combine)(void* acc, const void* right, void* ctx), void* acc,
+    size_t acc_size, void* ctx, unsigned nthreads);
+
 static inline void chx_rb_link_node(struct chx_rb_node* node,
                                     struct chx_rb_node* parent,
                                     struct chx_rb_node** rb_link) {
@@ -75,7 +184,7 @@ static inline void chx_rb_link_node_rcu(struct chx_rb_node* node,
     node->__rb_parent_color = (unsigned long)parent;
     node->rb_left = node->rb_right = NULL;
 
-    *rb_link = node;
+    chx_rcu_assign_pointer(*rb_link, node);
 }
 
 #define chx_rb_entry_safe(ptr, type, member)                                   \
@@ -134,6 +243,51 @@ chx_rb_erase_cached(struct chx_rb_node* node, struct chx_rb_root_cached* root) {
     return leftmost;
 }
 
+static inline void
+chx_rb_destroy_cached(struct chx_rb_root_cached* root,
+                      void (*release)(struct chx_rb_node* node, void* ctx),
+                      void* ctx) {
+    chx_rb_destroy(&root->rb_root, release, ctx);
+    root->rb_leftmost = NULL;
+}
+
+static inline void chx_rb_build_sorted_cached(struct chx_rb_node** nodes,
+                                              size_t n,
+                                              struct chx_rb_root_cached* root) {
+    chx_rb_build_sorted(nodes, n, &root->rb_root);
+    root->rb_leftmost = n ? nodes[0] : NULL;
+}
+
+static inline void
+chx_rb_build_sorted_parallel_cached(struct chx_rb_node** nodes, size_t n,
+                                    struct chx_rb_root_cached* root,
+                                    unsigned nthreads) {
+    chx_rb_build_sorted_parallel(nodes, n, &root->rb_root, nthreads);
+    root->rb_leftmost = n ? nodes[0] : NULL;
+}
+
+static inline void chx_rb_join_cached(struct chx_rb_root_cached* left,
+                                      struct chx_rb_node* pivot,
+                                      struct chx_rb_root_cached* right) {
+    struct chx_rb_node* leftmost = left->rb_leftmost;
+
+    if (!leftmost)
+        leftmost = pivot ? pivot : right->rb_leftmost;
+    chx_rb_join(&left->rb_root, pivot, &right->rb_root);
+    left->rb_leftmost = leftmost;
+    right->rb_leftmost = NULL;
+}
+
+static inline void
+chx_rb_split_cached(struct chx_rb_root_cached* tree, const void* key,
+                    int (*cmp)(const void* key, const struct chx_rb_node*),
+                    struct chx_rb_root_cached* ge) {
+    chx_rb_split(&tree->rb_root, key, cmp, &ge->rb_root);
+    ge->rb_leftmost = chx_rb_first(&ge->rb_root);
+    if (!tree->rb_root.rb_node)
+        tree->rb_leftmost = NULL;
+}
+
 static inline void chx_rb_replace_node_cached(struct chx_rb_node* victim,
                                               struct chx_rb_node* new_node,
                                               struct chx_rb_root_cached* root) {
@@ -142,6 +296,41 @@ static inline void chx_rb_replace_node_cached(struct chx_rb_node* victim,
     chx_rb_replace_node(victim, new_node, &root->rb_root);
 }
 
+/* Same as chx_rb_first() and chx_rb_last(), but O(1) */
+#define chx_rb_first_cached2(root) (root)->rb_leftmost
+#define chx_rb_last_cached2(root) (root)->rb_rightmost
+
+static inline void chx_rb_insert_color_cached2(struct chx_rb_node* node,
+                                               struct chx_rb_root_cached2* root,
+                                               bool leftmost, bool rightmost) {
+    if (leftmost)
+        root->rb_leftmost = node;
+    if (rightmost)
+        root->rb_rightmost = node;
+    chx_rb_insert_color(node, &root->rb_root);
+}
+
+static inline void chx_rb_erase_cached2(struct chx_rb_node* node,
+                                        struct chx_rb_root_cached2* root) {
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = chx_rb_next(node);
+    if (root->rb_rightmost == node)
+        root->rb_rightmost = chx_rb_prev(node);
+
+    chx_rb_erase(node, &root->rb_root);
+}
+
+static inline void
+chx_rb_replace_node_cached2(struct chx_rb_node* victim,
+                            struct chx_rb_node* new_node,
+                            struct chx_rb_root_cached2* root) {
+    if (root->rb_leftmost == victim)
+        root->rb_leftmost = new_node;
+    if (root->rb_rightmost == victim)
+        root->rb_rightmost = new_node;
+    chx_rb_replace_node(victim, new_node, &root->rb_root);
+}
+
 /*
  * The below helper functions use 2 operators with 3 different
  * calling conventions. The operators are related like:
@@ -173,8 +362,10 @@ static inline struct chx_rb_node* chx_rb_add_cached(
     struct chx_rb_node* parent = NULL;
     bool leftmost = true;
 
+    chx_rb_stat_inc(descents);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
         if (less(node, parent)) {
             link = &parent->rb_left;
         } else {
@@ -201,8 +392,10 @@ chx_rb_add(struct chx_rb_node* node, struct chx_rb_root* tree,
     struct chx_rb_node** link = &tree->rb_node;
     struct chx_rb_node* parent = NULL;
 
+    chx_rb_stat_inc(descents);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
         if (less(node, parent))
             link = &parent->rb_left;
         else
@@ -213,6 +406,123 @@ chx_rb_add(struct chx_rb_node* node, struct chx_rb_root* tree,
     chx_rb_insert_color(node, tree);
 }
 
+/*
+ * Find where @node goes relative to @hint, a node already in the tree:
+ * directly after it (hint <= node < next) or directly before it
+ * (prev <= node < hint), matching the position chx_rb_add() would pick.
+ * The slot is always free: either @hint's own child, or the missing inner
+ * child of its neighbour. Returns NULL when @hint is not adjacent to @node.
+ *
+ * Finding the neighbour is an in-order step from @hint, which from the last
+ * node climbs all the way to the root. When the caller knows the @first
+ * and @last nodes of the tree (NULL if not) a hint at that end has no
+ * neighbour on that side, and the step is skipped.
+ */
+static inline struct chx_rb_node** __chx_rb_hint_link(
+    struct chx_rb_node* node, struct chx_rb_node* hint,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*),
+    const struct chx_rb_node* first, const struct chx_rb_node* last,
+    struct chx_rb_node** parent, bool* leftmost, bool* rightmost) {
+    struct chx_rb_node* nb;
+
+    if (!hint)
+        return NULL;
+
+    if (!less(node, hint)) {
+        nb = hint == last ? NULL : chx_rb_next(hint);
+        if (nb && !less(node, nb))
+            return NULL;
+        *leftmost = false;
+        *rightmost = !nb;
+        if (!hint->rb_right) {
+            *parent = hint;
+            return &hint->rb_right;
+        }
+        *parent = nb;
+        return &nb->rb_left;
+    }
+
+    nb = hint == first ? NULL : chx_rb_prev(hint);
+    if (nb && less(node, nb))
+        return NULL;
+    *leftmost = !nb;
+    *rightmost = false;
+    if (!hint->rb_left) {
+        *parent = hint;
+        return &hint->rb_left;
+    }
+    *parent = nb;
+    return &nb->rb_right;
+}
+
+/**
+ * chx_rb_add_hint() - insert @node into @tree next to @hint
+ * @node: node to insert
+ * @hint: node of @tree expected to be adjacent to @node, or NULL
+ * @tree: tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * Checks @hint and its in-order neighbour with at most two @less calls and
+ * links @node there directly, without comparing down from the root. A
+ * wrong hint falls back to chx_rb_add(). Rebalancing is amortized O(1)
+ * either way.
+ *
+ * Stepping to the neighbour costs O(1) amortized for clustered keys, but
+ * from the last node it climbs to the root: appends with the previous node
+ * as hint still make O(log n) dependent loads, only without comparisons.
+ * chx_rb_add_hint_cached2() avoids that, and chx_rb_add_hint_cached() does
+ * the same for prepends.
+ */
+static inline void
+chx_rb_add_hint(struct chx_rb_node* node, struct chx_rb_node* hint,
+                struct chx_rb_root* tree,
+                bool (*less)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node* parent;
+    struct chx_rb_node** link;
+    bool leftmost, rightmost;
+
+    link = __chx_rb_hint_link(node, hint, less, NULL, NULL, &parent,
+                              &leftmost, &rightmost);
+    if (!link) {
+        chx_rb_add(node, tree, less);
+        return;
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color(node, tree);
+}
+
+/**
+ * chx_rb_add_hint_cached() - insert @node into the leftmost cached tree @tree
+ * next to @hint
+ * @node: node to insert
+ * @hint: node of @tree expected to be adjacent to @node, or NULL
+ * @tree: leftmost cached tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * A prepend before the cached leftmost is O(1).
+ *
+ * Returns @node when it is the new leftmost, or NULL.
+ */
+static inline struct chx_rb_node* chx_rb_add_hint_cached(
+    struct chx_rb_node* node, struct chx_rb_node* hint,
+    struct chx_rb_root_cached* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node* parent;
+    struct chx_rb_node** link;
+    bool leftmost, rightmost;
+
+    link = __chx_rb_hint_link(node, hint, less, tree->rb_leftmost, NULL,
+                              &parent, &leftmost, &rightmost);
+    if (!link)
+        return chx_rb_add_cached(node, tree, less);
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color_cached(node, tree, leftmost);
+
+    return leftmost ? node : NULL;
+}
+
 /**
  * chx_rb_find_add_cached() - find equivalent @node in @tree, or add @node
  * @node: node to look-for / insert
@@ -229,9 +539,14 @@ static inline struct chx_rb_node* chx_rb_find_add_cached(
     struct chx_rb_node** link = &tree->rb_root.rb_node;
     struct chx_rb_node* parent = NULL;
     int c;
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        visited++;
         c = cmp(node, parent);
 
         if (c < 0) {
@@ -240,13 +555,122 @@ static inline struct chx_rb_node* chx_rb_find_add_cached(
             link = &parent->rb_right;
             leftmost = false;
         } else {
-            return parent;
+            return __chx_rb_find_return(tree, visited, parent);
         }
     }
 
     chx_rb_link_node(node, parent, link);
     chx_rb_insert_color_cached(node, tree, leftmost);
-    return NULL;
+    return __chx_rb_find_return(tree, visited, NULL);
+}
+
+/**
+ * chx_rb_add_cached2() - insert @node into the both ends cached tree @tree
+ * @node: node to insert
+ * @tree: both ends cached tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * Returns @node when it is the new leftmost or the new rightmost, or NULL.
+ */
+static inline struct chx_rb_node* chx_rb_add_cached2(
+    struct chx_rb_node* node, struct chx_rb_root_cached2* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node** link = &tree->rb_root.rb_node;
+    struct chx_rb_node* parent = NULL;
+    bool leftmost = true, rightmost = true;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        if (less(node, parent)) {
+            link = &parent->rb_left;
+            rightmost = false;
+        } else {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color_cached2(node, tree, leftmost, rightmost);
+
+    return leftmost || rightmost ? node : NULL;
+}
+
+/**
+ * chx_rb_add_hint_cached2() - insert @node into the both ends cached tree
+ * @tree next to @hint
+ * @node: node to insert
+ * @hint: node of @tree expected to be adjacent to @node, or NULL
+ * @tree: both ends cached tree to insert @node into
+ * @less: operator defining the (partial) node order
+ *
+ * Appends after the cached rightmost and prepends before the cached
+ * leftmost are O(1) apart from the amortized O(1) rebalancing.
+ *
+ * Returns @node when it is the new leftmost or the new rightmost, or NULL.
+ */
+static inline struct chx_rb_node* chx_rb_add_hint_cached2(
+    struct chx_rb_node* node, struct chx_rb_node* hint,
+    struct chx_rb_root_cached2* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node* parent;
+    struct chx_rb_node** link;
+    bool leftmost, rightmost;
+
+    link = __chx_rb_hint_link(node, hint, less, tree->rb_leftmost,
+                              tree->rb_rightmost, &parent, &leftmost,
+                              &rightmost);
+    if (!link)
+        return chx_rb_add_cached2(node, tree, less);
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color_cached2(node, tree, leftmost, rightmost);
+
+    return leftmost || rightmost ? node : NULL;
+}
+
+/**
+ * chx_rb_find_add_cached2() - find equivalent @node in @tree, or add @node
+ * @node: node to look-for / insert
+ * @tree: both ends cached tree to search / modify
+ * @cmp: operator defining the node order
+ *
+ * Returns the chx_rb_node matching @node, or NULL when no match is found and
+ * @node is inserted.
+ */
+static inline struct chx_rb_node* chx_rb_find_add_cached2(
+    struct chx_rb_node* node, struct chx_rb_root_cached2* tree,
+    int (*cmp)(const struct chx_rb_node* a, const struct chx_rb_node* b)) {
+    bool leftmost = true, rightmost = true;
+    struct chx_rb_node** link = &tree->rb_root.rb_node;
+    struct chx_rb_node* parent = NULL;
+    int c;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        c = cmp(node, parent);
+
+        if (c < 0) {
+            link = &parent->rb_left;
+            rightmost = false;
+        } else if (c > 0) {
+            link = &parent->rb_right;
+            leftmost = false;
+        } else {
+            return __chx_rb_find_return(tree, visited, parent);
+        }
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color_cached2(node, tree, leftmost, rightmost);
+    return __chx_rb_find_return(tree, visited, NULL);
 }
 
 /**
@@ -264,9 +688,14 @@ chx_rb_find_add(struct chx_rb_node* node, struct chx_rb_root* tree,
     struct chx_rb_node** link = &tree->rb_node;
     struct chx_rb_node* parent = NULL;
     int c;
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        visited++;
         c = cmp(node, parent);
 
         if (c < 0)
@@ -274,12 +703,12 @@ chx_rb_find_add(struct chx_rb_node* node, struct chx_rb_root* tree,
         else if (c > 0)
             link = &parent->rb_right;
         else
-            return parent;
+            return __chx_rb_find_return(tree, visited, parent);
     }
 
     chx_rb_link_node(node, parent, link);
     chx_rb_insert_color(node, tree);
-    return NULL;
+    return __chx_rb_find_return(tree, visited, NULL);
 }
 
 /**
@@ -299,9 +728,14 @@ static inline struct chx_rb_node* chx_rb_find_add_rcu(
     struct chx_rb_node** link = &tree->rb_node;
     struct chx_rb_node* parent = NULL;
     int c;
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        visited++;
         c = cmp(node, parent);
 
         if (c < 0)
@@ -309,12 +743,12 @@ static inline struct chx_rb_node* chx_rb_find_add_rcu(
         else if (c > 0)
             link = &parent->rb_right;
         else
-            return parent;
+            return __chx_rb_find_return(tree, visited, parent);
     }
 
     chx_rb_link_node_rcu(node, parent, link);
     chx_rb_insert_color(node, tree);
-    return NULL;
+    return __chx_rb_find_return(tree, visited, NULL);
 }
 
 /**
@@ -329,19 +763,318 @@ static inline struct chx_rb_node*
 chx_rb_find(const void* key, const struct chx_rb_root* tree,
             int (*cmp)(const void* key, const struct chx_rb_node*)) {
     struct chx_rb_node* node = tree->rb_node;
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (node) {
         int c = cmp(key, node);
 
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        if (c < 0)
+            node = node->rb_left;
+        else if (c > 0)
+            node = node->rb_right;
+        else
+            return __chx_rb_find_return(tree, visited, node);
+    }
+
+    return __chx_rb_find_return(tree, visited, NULL);
+}
+
+/*
+ * Prefetching variants of chx_rb_add(), chx_rb_add_cached(), chx_rb_find_add()
+ * and chx_rb_find().
+ *
+ * Once a tree outgrows the last level cache every level of a descent is a
+ * cache miss. These variants start loading both children of a node before
+ * comparing against it, so the miss on the next level overlaps with the
+ * comparison. With @depth 2 the four grandchildren are prefetched too, which
+ * first needs the children's pointers and so stalls until they arrive; it
+ * only pays off when the comparison is slow. On trees that fit in cache the
+ * extra prefetches are pure overhead. @depth should be a constant, 1 or 2.
+ *
+ * Only the cache line of the chx_rb_node is fetched, so the key should sit
+ * next to it in the containing struct.
+ */
+static inline void chx_rb_prefetch_children(const struct chx_rb_node* node,
+                                            unsigned depth) {
+    struct chx_rb_node *left = node->rb_left, *right = node->rb_right;
+
+    /* Prefetching NULL is harmless, it never faults */
+    __builtin_prefetch(left);
+    __builtin_prefetch(right);
+    if (depth < 2)
+        return;
+    if (left) {
+        __builtin_prefetch(left->rb_left);
+        __builtin_prefetch(left->rb_right);
+    }
+    if (right) {
+        __builtin_prefetch(right->rb_left);
+        __builtin_prefetch(right->rb_right);
+    }
+}
+
+static inline void chx_rb_add_prefetch(
+    struct chx_rb_node* node, struct chx_rb_root* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*),
+    unsigned depth) {
+    struct chx_rb_node** link = &tree->rb_node;
+    struct chx_rb_node* parent = NULL;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        chx_rb_prefetch_children(parent, depth);
+        if (less(node, parent))
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color(node, tree);
+}
+
+static inline struct chx_rb_node* chx_rb_add_cached_prefetch(
+    struct chx_rb_node* node, struct chx_rb_root_cached* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*),
+    unsigned depth) {
+    struct chx_rb_node** link = &tree->rb_root.rb_node;
+    struct chx_rb_node* parent = NULL;
+    bool leftmost = true;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        chx_rb_prefetch_children(parent, depth);
+        if (less(node, parent)) {
+            link = &parent->rb_left;
+        } else {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color_cached(node, tree, leftmost);
+
+    return leftmost ? node : NULL;
+}
+
+static inline struct chx_rb_node* chx_rb_find_add_prefetch(
+    struct chx_rb_node* node, struct chx_rb_root* tree,
+    int (*cmp)(struct chx_rb_node*, const struct chx_rb_node*),
+    unsigned depth) {
+    struct chx_rb_node** link = &tree->rb_node;
+    struct chx_rb_node* parent = NULL;
+    int c;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        chx_rb_prefetch_children(parent, depth);
+        c = cmp(node, parent);
+
+        if (c < 0)
+            link = &parent->rb_left;
+        else if (c > 0)
+            link = &parent->rb_right;
+        else
+            return __chx_rb_find_return(tree, visited, parent);
+    }
+
+    chx_rb_link_node(node, parent, link);
+    chx_rb_insert_color(node, tree);
+    return __chx_rb_find_return(tree, visited, NULL);
+}
+
+static inline struct chx_rb_node*
+chx_rb_find_prefetch(const void* key, const struct chx_rb_root* tree,
+                     int (*cmp)(const void* key, const struct chx_rb_node*),
+                     unsigned depth) {
+    struct chx_rb_node* node = tree->rb_node;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (node) {
+        int c;
+
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        chx_rb_prefetch_children(node, depth);
+        c = cmp(key, node);
         if (c < 0)
             node = node->rb_left;
         else if (c > 0)
             node = node->rb_right;
         else
-            return node;
+            return __chx_rb_find_return(tree, visited, node);
     }
 
-    return NULL;
+    return __chx_rb_find_return(tree, visited, NULL);
+}
+
+/*
+ * Batched lookups. Instead of finishing one descent before starting the
+ * next, up to CHX_RB_BATCH_INFLIGHT descents advance in turn, one level
+ * each, prefetching the node each one moves to. By the time a descent comes
+ * round again its node has usually arrived, so the cache misses of the
+ * lookups in flight overlap instead of adding up. A slot whose descent ends
+ * takes the next key straight away, so short and long paths mix freely.
+ *
+ * This pays on trees much larger than the cache; on small trees the round
+ * robin bookkeeping costs more than it hides.
+ */
+#define CHX_RB_BATCH_INFLIGHT 8
+/* Nodes chx_rb_find_add_batch() looks up before inserting the misses */
+#define CHX_RB_BATCH_WINDOW 64
+
+struct __chx_rb_batch_slot {
+    struct chx_rb_node** link;
+    struct chx_rb_node* parent;
+    size_t idx;
+};
+
+/*
+ * The interleaved descent of items FIRST to END - 1 into TREE, shared by
+ * the batch helpers. CMP(i, node) compares item i with a node like cmp()
+ * does; DONE(i, node, parent, link) runs once per item, with the node it
+ * matched, or with node NULL and the empty link below parent where it
+ * would be inserted. Nothing in the tree is written.
+ */
+#define __CHX_RB_BATCH_DESCEND(TREE, FIRST, END, CMP, DONE)                    \
+    do {                                                                       \
+        struct __chx_rb_batch_slot __slot[CHX_RB_BATCH_INFLIGHT];              \
+        struct chx_rb_node** __top = (struct chx_rb_node**)&(TREE)->rb_node;   \
+        size_t __next = (FIRST), __end = (END), __active = 0;                  \
+        unsigned __s;                                                          \
+                                                                               \
+        for (__s = 0; __s < CHX_RB_BATCH_INFLIGHT; __s++) {                    \
+            __slot[__s] =                                                      \
+                (struct __chx_rb_batch_slot){__top, NULL, __end};              \
+            if (__next < __end) {                                              \
+                __slot[__s].idx = __next++;                                    \
+                __active++;                                                    \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        while (__active) {                                                     \
+            for (__s = 0; __s < CHX_RB_BATCH_INFLIGHT; __s++) {                \
+                struct __chx_rb_batch_slot* __sl = &__slot[__s];               \
+                struct chx_rb_node* __node = *__sl->link;                      \
+                size_t __i = __sl->idx;                                        \
+                int __c;                                                       \
+                                                                               \
+                if (__i == __end)                                              \
+                    continue;                                                  \
+                __c = __node ? CMP(__i, __node) : 0;                           \
+                if (__c) {                                                     \
+                    __sl->parent = __node;                                     \
+                    __sl->link =                                               \
+                        __c < 0 ? &__node->rb_left : &__node->rb_right;        \
+                    __builtin_prefetch(*__sl->link);                           \
+                    continue;                                                  \
+                }                                                              \
+                                                                               \
+                /* Found, or fell off the tree with __node NULL */             \
+                DONE(__i, __node, __sl->parent, __sl->link);                   \
+                *__sl = (struct __chx_rb_batch_slot){__top, NULL, __end};      \
+                if (__next < __end)                                            \
+                    __sl->idx = __next++;                                      \
+                else                                                           \
+                    __active--;                                                \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+/**
+ * chx_rb_find_batch() - find each of @keys in tree @tree
+ * @keys: keys to match
+ * @n: number of keys
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ * @out: receives the node matching @keys[i], or NULL, in @out[i]
+ */
+static inline void
+chx_rb_find_batch(const void* const* keys, size_t n,
+                  const struct chx_rb_root* tree,
+                  int (*cmp)(const void* key, const struct chx_rb_node*),
+                  struct chx_rb_node** out) {
+#define __CHX_RB_FIND_CMP(i, node) cmp(keys[i], node)
+#define __CHX_RB_FIND_DONE(i, node, parent, link) (out[i] = (node))
+    __CHX_RB_BATCH_DESCEND(tree, 0, n, __CHX_RB_FIND_CMP, __CHX_RB_FIND_DONE);
+#undef __CHX_RB_FIND_CMP
+#undef __CHX_RB_FIND_DONE
+}
+
+/**
+ * chx_rb_find_add_batch() - chx_rb_find_add() each of @nodes into @tree
+ * @nodes: nodes to look-for / insert
+ * @n: number of nodes
+ * @tree: tree to search / modify
+ * @cmp: operator defining the node order
+ * @out: receives the node matching @nodes[i], or NULL when @nodes[i] was
+ *       inserted, in @out[i]
+ *
+ * Works through @nodes CHX_RB_BATCH_WINDOW at a time. The descents of a
+ * window run batched as in chx_rb_find_batch(), noting for each miss the
+ * empty link it ended on, and the misses are then linked there in order.
+ * All descents of a window see the same tree, so a miss's link marks a gap
+ * between two nodes which only the inserts that ended on the same link can
+ * change. A node goes through chx_rb_find_add() instead when an earlier
+ * insert of the window ended on its link, which is also how it finds an
+ * equal node inserted just before, or when a rotation moved the gap to
+ * another link. The result is that of chx_rb_find_add() on each node in
+ * turn.
+ */
+static inline void chx_rb_find_add_batch(
+    struct chx_rb_node** nodes, size_t n, struct chx_rb_root* tree,
+    int (*cmp)(struct chx_rb_node*, const struct chx_rb_node*),
+    struct chx_rb_node** out) {
+    struct chx_rb_node* parent[CHX_RB_BATCH_WINDOW];
+    struct chx_rb_node** link[CHX_RB_BATCH_WINDOW];
+    struct chx_rb_node** taken[CHX_RB_BATCH_WINDOW];
+
+    for (size_t base = 0; base < n; base += CHX_RB_BATCH_WINDOW) {
+        size_t end = n - base < CHX_RB_BATCH_WINDOW ? n : base +
+                                                          CHX_RB_BATCH_WINDOW;
+        unsigned ntaken = 0;
+
+#define __CHX_RB_FIND_ADD_CMP(i, node) cmp(nodes[i], node)
+#define __CHX_RB_FIND_ADD_DONE(i, node, p, l)                                  \
+    (out[i] = (node), parent[(i) - base] = (p), link[(i) - base] = (l))
+        __CHX_RB_BATCH_DESCEND(tree, base, end, __CHX_RB_FIND_ADD_CMP,
+                               __CHX_RB_FIND_ADD_DONE);
+#undef __CHX_RB_FIND_ADD_CMP
+#undef __CHX_RB_FIND_ADD_DONE
+
+        for (size_t i = base; i < end; i++) {
+            struct chx_rb_node** l = link[i - base];
+            bool fresh = !*l;
+
+            if (out[i])
+                continue;
+            for (unsigned t = 0; t < ntaken && fresh; t++)
+                fresh = taken[t] != l;
+            taken[ntaken++] = l;
+            if (!fresh) {
+                out[i] = chx_rb_find_add(nodes[i], tree, cmp);
+                continue;
+            }
+            chx_rb_link_node(nodes[i], parent[i - base], l);
+            chx_rb_insert_color(nodes[i], tree);
+        }
+    }
 }
 
 /**
@@ -351,27 +1084,32 @@ chx_rb_find(const void* key, const struct chx_rb_root* tree,
  * @cmp: operator defining the node order
  *
  * Notably, tree descent vs concurrent tree rotations is unsound and can result
- * in false-negatives.
+ * in false-negatives. Use rbtree_latch.h when lookups must be exact.
  *
  * Returns the chx_rb_node matching @key or NULL.
  */
 static inline struct chx_rb_node*
 chx_rb_find_rcu(const void* key, const struct chx_rb_root* tree,
                 int (*cmp)(const void* key, const struct chx_rb_node*)) {
-    struct chx_rb_node* node = tree->rb_node;
+    struct chx_rb_node* node = chx_rcu_dereference(tree->rb_node);
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (node) {
         int c = cmp(key, node);
 
+        chx_rb_stat_inc(descent_steps);
+        visited++;
         if (c < 0)
-            node = node->rb_left;
+            node = chx_rcu_dereference(node->rb_left);
         else if (c > 0)
-            node = node->rb_right;
+            node = chx_rcu_dereference(node->rb_right);
         else
-            return node;
+            return __chx_rb_find_return(tree, visited, node);
     }
 
-    return NULL;
+    return __chx_rb_find_return(tree, visited, NULL);
 }
 
 /**
@@ -387,10 +1125,15 @@ chx_rb_find_first(const void* key, const struct chx_rb_root* tree,
                   int (*cmp)(const void* key, const struct chx_rb_node*)) {
     struct chx_rb_node* node = tree->rb_node;
     struct chx_rb_node* match = NULL;
+    unsigned visited = 0;
 
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
     while (node) {
         int c = cmp(key, node);
 
+        chx_rb_stat_inc(descent_steps);
+        visited++;
         if (c <= 0) {
             if (!c)
                 match = node;
@@ -400,7 +1143,7 @@ chx_rb_find_first(const void* key, const struct chx_rb_root* tree,
         }
     }
 
-    return match;
+    return __chx_rb_find_return(tree, visited, match);
 }
 
 /**
@@ -430,3 +1173,513 @@ chx_rb_next_match(const void* key, struct chx_rb_node* node,
 #define chx_rb_for_each(node, key, tree, cmp)                                  \
     for ((node) = chx_rb_find_first((key), (tree), (cmp)); (node);             \
          (node) = chx_rb_next_match((key), (node), (cmp)))
+
+/*
+ * Lower bound of @key below @node, or @match if nothing there qualifies.
+ * Adds the nodes compared to @visited.
+ */
+static inline struct chx_rb_node*
+__chx_rb_lower_bound(const void* key, struct chx_rb_node* node,
+                     struct chx_rb_node* match,
+                     int (*cmp)(const void* key, const struct chx_rb_node*),
+                     unsigned* visited) {
+    while (node) {
+        chx_rb_stat_inc(descent_steps);
+        (*visited)++;
+        if (cmp(key, node) <= 0) {
+            match = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    return match;
+}
+
+/*
+ * Bound searches, one descent each. With @cmp as for chx_rb_find():
+ *
+ *  chx_rb_lower_bound() - first node not ordering before @key
+ *  chx_rb_upper_bound() - first node ordering after @key
+ *  chx_rb_floor()       - last node not ordering after @key
+ *  chx_rb_ceil()        - same as chx_rb_lower_bound()
+ *
+ * Among nodes equal to @key, lower_bound returns the leftmost and floor the
+ * rightmost. All return NULL when there is no such node.
+ */
+static inline struct chx_rb_node*
+chx_rb_lower_bound(const void* key, const struct chx_rb_root* tree,
+                   int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node* match;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    match = __chx_rb_lower_bound(key, tree->rb_node, NULL, cmp, &visited);
+    return __chx_rb_find_return(tree, visited, match);
+}
+
+static inline struct chx_rb_node*
+chx_rb_upper_bound(const void* key, const struct chx_rb_root* tree,
+                   int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node *node = tree->rb_node, *match = NULL;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (node) {
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        if (cmp(key, node) < 0) {
+            match = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    return __chx_rb_find_return(tree, visited, match);
+}
+
+static inline struct chx_rb_node*
+chx_rb_floor(const void* key, const struct chx_rb_root* tree,
+             int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node *node = tree->rb_node, *match = NULL;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (node) {
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        if (cmp(key, node) >= 0) {
+            match = node;
+            node = node->rb_right;
+        } else {
+            node = node->rb_left;
+        }
+    }
+
+    return __chx_rb_find_return(tree, visited, match);
+}
+
+static inline struct chx_rb_node*
+chx_rb_ceil(const void* key, const struct chx_rb_root* tree,
+            int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    return chx_rb_lower_bound(key, tree, cmp);
+}
+
+/*
+ * The _cached variants first check the leftmost node, so keys at or below
+ * the minimum, as in priority queues and timer wheels, cost one comparison.
+ */
+static inline struct chx_rb_node*
+chx_rb_lower_bound_cached(const void* key,
+                          const struct chx_rb_root_cached* tree,
+                          int (*cmp)(const void* key,
+                                     const struct chx_rb_node*)) {
+    struct chx_rb_node* leftmost = tree->rb_leftmost;
+
+    if (!leftmost || cmp(key, leftmost) <= 0)
+        return leftmost;
+    return chx_rb_lower_bound(key, &tree->rb_root, cmp);
+}
+
+static inline struct chx_rb_node*
+chx_rb_upper_bound_cached(const void* key,
+                          const struct chx_rb_root_cached* tree,
+                          int (*cmp)(const void* key,
+                                     const struct chx_rb_node*)) {
+    struct chx_rb_node* leftmost = tree->rb_leftmost;
+
+    if (!leftmost || cmp(key, leftmost) < 0)
+        return leftmost;
+    return chx_rb_upper_bound(key, &tree->rb_root, cmp);
+}
+
+static inline struct chx_rb_node*
+chx_rb_floor_cached(const void* key, const struct chx_rb_root_cached* tree,
+                    int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node* leftmost = tree->rb_leftmost;
+
+    if (!leftmost || cmp(key, leftmost) < 0)
+        return NULL;
+    return chx_rb_floor(key, &tree->rb_root, cmp);
+}
+
+static inline struct chx_rb_node*
+chx_rb_ceil_cached(const void* key, const struct chx_rb_root_cached* tree,
+                   int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    return chx_rb_lower_bound_cached(key, tree, cmp);
+}
+
+/**
+ * chx_rb_range_first() - find the bounds of the range [@lo, @hi) in @tree
+ * @lo: lowest key in the range
+ * @hi: first key past the range
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ * @end: receives the first node past the range, or NULL
+ *
+ * A single descent compares each node against both keys until the paths to
+ * @lo and @hi part, then finishes each path in its own subtree, so no node
+ * is loaded twice.
+ *
+ * Returns the first node in the range, or @end when the range is empty.
+ */
+static inline struct chx_rb_node*
+chx_rb_range_first(const void* lo, const void* hi,
+                   const struct chx_rb_root* tree,
+                   int (*cmp)(const void* key, const struct chx_rb_node*),
+                   struct chx_rb_node** end) {
+    struct chx_rb_node *node = tree->rb_node, *match = NULL, *first;
+    unsigned visited = 0;
+
+    chx_rb_stat_inc(descents);
+    chx_rb_trace1(find_entry, tree);
+    while (node) {
+        bool lo_left = cmp(lo, node) <= 0;
+
+        chx_rb_stat_inc(descent_steps);
+        visited++;
+        if (lo_left != (cmp(hi, node) <= 0)) {
+            /* @lo above @hi: empty, only @end is wanted */
+            if (!lo_left) {
+                *end = __chx_rb_lower_bound(hi, node->rb_left, node, cmp,
+                                            &visited);
+                return __chx_rb_find_return(tree, visited, *end);
+            }
+            *end = __chx_rb_lower_bound(hi, node->rb_right, match, cmp,
+                                        &visited);
+            first = __chx_rb_lower_bound(lo, node->rb_left, node, cmp,
+                                         &visited);
+            return __chx_rb_find_return(tree, visited, first);
+        }
+        if (lo_left) {
+            match = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    /* The paths never parted: both bounds are the same node */
+    *end = match;
+    return __chx_rb_find_return(tree, visited, match);
+}
+
+/**
+ * chx_rb_for_each_range() - iterate the nodes in [@lo, @hi) in order
+ * @node: iterator
+ * @end: another 'struct chx_rb_node *', holding the first node past the range
+ * @lo: lowest key in the range
+ * @hi: first key past the range
+ * @tree: tree to search
+ * @cmp: operator defining node order
+ *
+ * chx_rb_range_first() finds both ends up front; stepping does no
+ * comparisons. @end must stay in the tree during the walk.
+ */
+#define chx_rb_for_each_range(node, end, lo, hi, tree, cmp)                    \
+    for ((node) = chx_rb_range_first((lo), (hi), (tree), (cmp), &(end));       \
+         (node) != (end); (node) = chx_rb_next(node))
+
+/*
+ * Stack based in-order iteration with struct chx_rb_iter. Each step either
+ * descends from the current node or pops the path, never loading a parent
+ * pointer, so a full scan reads every node once and nothing else. The tree
+ * must not change while an iterator is in use.
+ *
+ * All of these return the new current node, or NULL once the iteration runs
+ * off either end, after which the iterator must be restarted.
+ */
+static inline struct chx_rb_node*
+__chx_rb_iter_descend(struct chx_rb_iter* iter, struct chx_rb_node* node,
+                      bool left) {
+    while (node) {
+        iter->path[iter->depth++] = node;
+        node = left ? node->rb_left : node->rb_right;
+    }
+    return iter->depth ? iter->path[iter->depth - 1] : NULL;
+}
+
+static inline struct chx_rb_node*
+__chx_rb_iter_step(struct chx_rb_iter* iter, bool forward) {
+    struct chx_rb_node *node, *child;
+
+    if (!iter->depth)
+        return NULL;
+    node = iter->path[iter->depth - 1];
+    child = forward ? node->rb_right : node->rb_left;
+    if (child)
+        return __chx_rb_iter_descend(iter, child, forward);
+
+    /* Climb past every ancestor we came up to from its forward side */
+    do {
+        child = iter->path[--iter->depth];
+        node = iter->depth ? iter->path[iter->depth - 1] : NULL;
+    } while (node && (forward ? node->rb_right : node->rb_left) == child);
+    return node;
+}
+
+static inline struct chx_rb_node*
+chx_rb_iter_first(struct chx_rb_iter* iter, const struct chx_rb_root* root) {
+    iter->depth = 0;
+    return __chx_rb_iter_descend(iter, root->rb_node, true);
+}
+
+static inline struct chx_rb_node*
+chx_rb_iter_last(struct chx_rb_iter* iter, const struct chx_rb_root* root) {
+    iter->depth = 0;
+    return __chx_rb_iter_descend(iter, root->rb_node, false);
+}
+
+static inline struct chx_rb_node* chx_rb_iter_next(struct chx_rb_iter* iter) {
+    return __chx_rb_iter_step(iter, true);
+}
+
+static inline struct chx_rb_node* chx_rb_iter_prev(struct chx_rb_iter* iter) {
+    return __chx_rb_iter_step(iter, false);
+}
+
+/**
+ * chx_rb_iter_seek() - position @iter at the lower bound of @key
+ * @iter: iterator to position
+ * @key: key to seek to
+ * @root: tree to search
+ * @cmp: operator defining the node order
+ *
+ * Returns the first node not ordering before @key, as chx_rb_lower_bound()
+ * does. Iteration may continue in either direction from there.
+ */
+static inline struct chx_rb_node*
+chx_rb_iter_seek(struct chx_rb_iter* iter, const void* key,
+                 const struct chx_rb_root* root,
+                 int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node* node = root->rb_node;
+    unsigned match = 0;
+
+    iter->depth = 0;
+    while (node) {
+        iter->path[iter->depth++] = node;
+        if (cmp(key, node) <= 0) {
+            match = iter->depth;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    /* The match is on the path, cut it back to there */
+    iter->depth = match;
+    return match ? iter->path[match - 1] : NULL;
+}
+
+#define chx_rb_iter_for_each(node, iter, root)                                 \
+    for ((node) = chx_rb_iter_first((iter), (root)); (node);                   \
+         (node) = chx_rb_iter_next(iter))
+
+#define chx_rb_iter_for_each_reverse(node, iter, root)                         \
+    for ((node) = chx_rb_iter_last((iter), (root)); (node);                    \
+         (node) = chx_rb_iter_prev(iter))
+
+/* Three way compare of two scalar keys, for use as RBCMP below */
+#define chx_rb_cmp_scalar(a, b) (((a) > (b)) - ((a) < (b)))
+
+/*
+ * Template for declaring a statically typed tree of RBSTRUCT ordered by a key
+ * field, with the comparison inlined into every descent instead of called
+ * through a function pointer.
+ *
+ * RBNAME:    prefix of the generated functions
+ * RBSTRUCT:  struct type of the tree nodes
+ * RBFIELD:   name of struct chx_rb_node field within RBSTRUCT
+ * RBKEYTYPE: type of the key
+ * RBKEY:     name of RBKEYTYPE field within RBSTRUCT holding the key
+ * RBCMP:     macro or function called as RBCMP(a, b) on two RBKEYTYPE values,
+ *            returning <0, 0 or >0 like memcmp(), e.g. chx_rb_cmp_scalar
+ *
+ * The generated functions are
+ *
+ *  RBNAME_insert(node, root)         - chx_rb_add(), equal keys go right
+ *  RBNAME_insert_cached(node, root)  - chx_rb_add_cached()
+ *  RBNAME_find(key, root)            - any node with @key, or NULL
+ *  RBNAME_find_add(node, root)       - chx_rb_find_add()
+ *  RBNAME_find_add_cached(node, root)
+ *                                    - chx_rb_find_add_cached()
+ *  RBNAME_lower_bound(key, root)     - leftmost node whose key is not less
+ *                                      than @key, or NULL
+ *  RBNAME_erase(node, root)          - chx_rb_erase()
+ *  RBNAME_erase_cached(node, root)   - chx_rb_erase_cached()
+ *
+ * taking and returning RBSTRUCT pointers, on a struct chx_rb_root or, for the
+ * _cached ones, a struct chx_rb_root_cached.
+ *
+ * Compilers tend to turn the two way descent of _insert into conditional
+ * moves, a win on random keys but a loss on ascending ones, where the
+ * branches predict perfectly. Appends are better served by
+ * chx_rb_add_hint_cached2().
+ */
+
+#define CHX_RB_DECLARE_TREE(RBNAME, RBSTRUCT, RBFIELD, RBKEYTYPE, RBKEY,       \
+                            RBCMP)                                             \
+    static inline int RBNAME##_cmp(RBKEYTYPE key,                              \
+                                   const struct chx_rb_node* node) {           \
+        return RBCMP(key, chx_rb_entry(node, RBSTRUCT, RBFIELD)->RBKEY);       \
+    }                                                                          \
+                                                                               \
+    static inline void RBNAME##_insert(RBSTRUCT* node,                         \
+                                       struct chx_rb_root* root) {             \
+        struct chx_rb_node **link = &root->rb_node, *parent = NULL;            \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        while (*link) {                                                        \
+            parent = *link;                                                    \
+            chx_rb_stat_inc(descent_steps);                                    \
+            if (RBNAME##_cmp(node->RBKEY, parent) < 0)                         \
+                link = &parent->rb_left;                                       \
+            else                                                               \
+                link = &parent->rb_right;                                      \
+        }                                                                      \
+                                                                               \
+        chx_rb_link_node(&node->RBFIELD, parent, link);                        \
+        chx_rb_insert_color(&node->RBFIELD, root);                             \
+    }                                                                          \
+                                                                               \
+    static inline RBSTRUCT* RBNAME##_insert_cached(                            \
+        RBSTRUCT* node, struct chx_rb_root_cached* root) {                     \
+        struct chx_rb_node **link = &root->rb_root.rb_node, *parent = NULL;    \
+        bool leftmost = true;                                                  \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        while (*link) {                                                        \
+            parent = *link;                                                    \
+            chx_rb_stat_inc(descent_steps);                                    \
+            if (RBNAME##_cmp(node->RBKEY, parent) < 0) {                       \
+                link = &parent->rb_left;                                       \
+            } else {                                                           \
+                link = &parent->rb_right;                                      \
+                leftmost = false;                                              \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        chx_rb_link_node(&node->RBFIELD, parent, link);                        \
+        chx_rb_insert_color_cached(&node->RBFIELD, root, leftmost);            \
+        return leftmost ? node : NULL;                                         \
+    }                                                                          \
+                                                                               \
+    static inline RBSTRUCT* RBNAME##_find(RBKEYTYPE key,                       \
+                                          const struct chx_rb_root* root) {    \
+        struct chx_rb_node* node = root->rb_node;                              \
+        unsigned visited = 0;                                                  \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        chx_rb_trace1(find_entry, root);                                       \
+        while (node) {                                                         \
+            int c = RBNAME##_cmp(key, node);                                   \
+                                                                               \
+            chx_rb_stat_inc(descent_steps);                                    \
+            visited++;                                                         \
+            if (c < 0)                                                         \
+                node = node->rb_left;                                          \
+            else if (c > 0)                                                    \
+                node = node->rb_right;                                         \
+            else                                                               \
+                return chx_rb_entry(__chx_rb_find_return(root, visited, node), \
+                                    RBSTRUCT, RBFIELD);                        \
+        }                                                                      \
+        __chx_rb_find_return(root, visited, NULL);                             \
+        return NULL;                                                           \
+    }                                                                          \
+                                                                               \
+    static inline struct chx_rb_node** RBNAME##_find_link(                     \
+        RBSTRUCT* node, struct chx_rb_node** link,                             \
+        struct chx_rb_node** parent, bool* leftmost, unsigned* visited) {      \
+        while (*link) {                                                        \
+            int c;                                                             \
+                                                                               \
+            *parent = *link;                                                   \
+            chx_rb_stat_inc(descent_steps);                                    \
+            (*visited)++;                                                      \
+            c = RBNAME##_cmp(node->RBKEY, *parent);                            \
+            if (c < 0) {                                                       \
+                link = &(*parent)->rb_left;                                    \
+            } else if (c > 0) {                                                \
+                link = &(*parent)->rb_right;                                   \
+                *leftmost = false;                                             \
+            } else {                                                           \
+                return NULL;                                                   \
+            }                                                                  \
+        }                                                                      \
+        return link;                                                           \
+    }                                                                          \
+                                                                               \
+    static inline RBSTRUCT* RBNAME##_find_add(RBSTRUCT* node,                  \
+                                              struct chx_rb_root* root) {      \
+        struct chx_rb_node *parent = NULL, **link;                             \
+        bool leftmost = true;                                                  \
+        unsigned visited = 0;                                                  \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        chx_rb_trace1(find_entry, root);                                       \
+        link = RBNAME##_find_link(node, &root->rb_node, &parent, &leftmost,    \
+                                  &visited);                                   \
+        if (!link)                                                             \
+            return chx_rb_entry(__chx_rb_find_return(root, visited, parent),   \
+                                RBSTRUCT, RBFIELD);                            \
+        chx_rb_link_node(&node->RBFIELD, parent, link);                        \
+        chx_rb_insert_color(&node->RBFIELD, root);                             \
+        __chx_rb_find_return(root, visited, NULL);                             \
+        return NULL;                                                           \
+    }                                                                          \
+                                                                               \
+    static inline RBSTRUCT* RBNAME##_find_add_cached(                          \
+        RBSTRUCT* node, struct chx_rb_root_cached* root) {                     \
+        struct chx_rb_node *parent = NULL, **link;                             \
+        bool leftmost = true;                                                  \
+        unsigned visited = 0;                                                  \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        chx_rb_trace1(find_entry, root);                                       \
+        link = RBNAME##_find_link(node, &root->rb_root.rb_node, &parent,       \
+                                  &leftmost, &visited);                        \
+        if (!link)                                                             \
+            return chx_rb_entry(__chx_rb_find_return(root, visited, parent),   \
+                                RBSTRUCT, RBFIELD);                            \
+        chx_rb_link_node(&node->RBFIELD, parent, link);                        \
+        chx_rb_insert_color_cached(&node->RBFIELD, root, leftmost);            \
+        __chx_rb_find_return(root, visited, NULL);                             \
+        return NULL;                                                           \
+    }                                                                          \
+                                                                               \
+    static inline RBSTRUCT* RBNAME##_lower_bound(                              \
+        RBKEYTYPE key, const struct chx_rb_root* root) {                       \
+        struct chx_rb_node *node = root->rb_node, *match = NULL;               \
+        unsigned visited = 0;                                                  \
+                                                                               \
+        chx_rb_stat_inc(descents);                                             \
+        chx_rb_trace1(find_entry, root);                                       \
+        while (node) {                                                         \
+            chx_rb_stat_inc(descent_steps);                                    \
+            visited++;                                                         \
+            if (RBNAME##_cmp(key, node) <= 0) {                                \
+                match = node;                                                  \
+                node = node->rb_left;                                          \
+            } else {                                                           \
+                node = node->rb_right;                                         \
+            }                                                                  \
+        }                                                                      \
+        return chx_rb_entry_safe(__chx_rb_find_return(root, visited, match),   \
+                                 RBSTRUCT, RBFIELD);                           \
+    }                                                                          \
+                                                                               \
+    static inline void RBNAME##_erase(RBSTRUCT* node,                          \
+                                      struct chx_rb_root* root) {              \
+        chx_rb_erase(&node->RBFIELD, root);                                    \
+    }                                                                          \
+                                                                               \
+    static inline void RBNAME##_erase_cached(                                  \
+        RBSTRUCT* node, struct chx_rb_root_cached* root) {                     \
+        chx_rb_erase_cached(&node->RBFIELD, root);                             \
+    }
@@ -66,8 +66,10 @@ static inline struct chx_rb_node* chx_rb_add_augmented_cached(
     struct chx_rb_node* parent = NULL;
     bool leftmost = true;
 
+    chx_rb_stat_inc(descents);
     while (*link) {
         parent = *link;
+        chx_rb_stat_inc(descent_steps);
         if (less(node, parent)) {
             link = &parent->rb_left;
         } else {
@@ -83,6 +85,66 @@ static inline struct chx_rb_node* chx_rb_add_augmented_cached(
     return leftmost ? node : NULL;
 }
 
+static inline void chx_rb_insert_augmented_cached2(
+    struct chx_rb_node* node, struct chx_rb_root_cached2* root, bool newleft,
+    bool newright, const struct chx_rb_augment_callbacks* augment) {
+    if (newleft)
+        root->rb_leftmost = node;
+    if (newright)
+        root->rb_rightmost = node;
+    chx_rb_insert_augmented(node, &root->rb_root, augment);
+}
+
+static inline struct chx_rb_node* chx_rb_add_augmented_cached2(
+    struct chx_rb_node* node, struct chx_rb_root_cached2* tree,
+    bool (*less)(struct chx_rb_node*, const struct chx_rb_node*),
+    const struct chx_rb_augment_callbacks* augment) {
+    struct chx_rb_node** link = &tree->rb_root.rb_node;
+    struct chx_rb_node* parent = NULL;
+    bool leftmost = true, rightmost = true;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        if (less(node, parent)) {
+            link = &parent->rb_left;
+            rightmost = false;
+        } else {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+
+    chx_rb_link_node(node, parent, link);
+    augment->propagate(parent, NULL); /* suboptimal */
+    chx_rb_insert_augmented_cached2(node, tree, leftmost, rightmost, augment);
+
+    return leftmost || rightmost ? node : NULL;
+}
+
+#define CHX_RB_RED 0
+#define CHX_RB_BLACK 1
+
+#define __chx_rb_parent(pc) ((struct chx_rb_node*)((pc) & ~3))
+
+#define __chx_rb_color(pc) ((pc) & 1)
+#define __chx_rb_is_black(pc) __chx_rb_color(pc)
+#define __chx_rb_is_red(pc) (!__chx_rb_color(pc))
+#define chx_rb_color(rb) __chx_rb_color((rb)->__rb_parent_color)
+#define chx_rb_is_red(rb) __chx_rb_is_red((rb)->__rb_parent_color)
+#define chx_rb_is_black(rb) __chx_rb_is_black((rb)->__rb_parent_color)
+
+static inline void chx_rb_set_parent(struct chx_rb_node* rb,
+                                     struct chx_rb_node* p) {
+    rb->__rb_parent_color = chx_rb_color(rb) + (unsigned long)p;
+}
+
+static inline void chx_rb_set_parent_color(struct chx_rb_node* rb,
+                                           struct chx_rb_node* p, int color) {
+    rb->__rb_parent_color = (unsigned long)p + color;
+}
+
 /*
  * Template for declaring augmented rbtree callbacks (generic case)
  *
@@ -100,6 +162,7 @@ static inline struct chx_rb_node* chx_rb_add_augmented_cached(
                                           struct chx_rb_node* stop) {          \
         while (rb != stop) {                                                   \
             RBSTRUCT* node = chx_rb_entry(rb, RBSTRUCT, RBFIELD);              \
+            chx_rb_stat_inc(propagate_steps);                                  \
             if (RBCOMPUTE(node, true))                                         \
                 break;                                                         \
             rb = chx_rb_parent(&node->RBFIELD);                                \
@@ -168,6 +231,34 @@ extern struct chx_rb_node*
 __chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
                          const struct chx_rb_augment_callbacks* augment);
 
+/*
+ * Join building blocks, see chx_rb_join(). __chx_rb_join() takes bare
+ * subtrees with their black heights, which may have a red root and a stale
+ * parent pointer, and returns a black root with no parent.
+ */
+extern unsigned __chx_rb_black_height(const struct chx_rb_node* node);
+extern struct chx_rb_node* __chx_rb_join(struct chx_rb_node* left, unsigned lh,
+                                         struct chx_rb_node* pivot,
+                                         struct chx_rb_node* right, unsigned rh,
+                                         unsigned* h);
+
+/*
+ * chx_rb_parallel_for_each() and chx_rb_parallel_reduce() for trees that
+ * keep subtree sizes: @size(node) gives the number of nodes under node, and
+ * pieces are cut by size rather than by depth, so they come out even.
+ */
+extern void
+__chx_rb_parallel_for_each(const struct chx_rb_root* root,
+                           void (*fn)(struct chx_rb_node* node, void* ctx),
+                           void* ctx, size_t (*size)(const struct chx_rb_node*),
+                           unsigned nthreads);
+extern void __chx_rb_parallel_reduce(
+    const struct chx_rb_root* root,
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx),
+    void (*combine)(void* acc, const void* right, void* ctx), void* acc,
+    size_t acc_size, void* ctx, size_t (*size)(const struct chx_rb_node*),
+    unsigned nthreads);
+
 static inline void
 chx_rb_erase_augmented(struct chx_rb_node* node, struct chx_rb_root* root,
                        const struct chx_rb_augment_callbacks* augment) {
@@ -185,3 +276,14 @@ chx_rb_erase_augmented_cached(struct chx_rb_node* node,
         root->rb_leftmost = chx_rb_next(node);
     chx_rb_erase_augmented(node, &root->rb_root, augment);
 }
+
+static inline void
+chx_rb_erase_augmented_cached2(struct chx_rb_node* node,
+                               struct chx_rb_root_cached2* root,
+                               const struct chx_rb_augment_callbacks* augment) {
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = chx_rb_next(node);
+    if (root->rb_rightmost == node)
+        root->rb_rightmost = chx_rb_prev(node);
+    chx_rb_erase_augmented(node, &root->rb_root, augment);
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Linear time construction of an rbtree from nodes already in order.
+ *
+ * Splitting at the middle element at every level gives a tree in which the
+ * two subtrees of every node differ in size by at most one, so all NULL
+ * leaves sit at depth h or h + 1 where h = floor(log2(n)). Colouring the
+ * nodes at depth h red and every other node black makes every root-to-leaf
+ * path cross exactly h black nodes, and red nodes (all on the deepest level)
+ * never have children. No comparator is called and no rotation happens.
+ */
+
+#include "rbtree_augmented.h"
+#include <pthread.h>
+
+/* No red level: a single node tree is just a black root */
+#define CHX_RB_NO_RED_DEPTH (~0u)
+
+static unsigned chx_rb_build_red_depth(size_t n) {
+    unsigned depth = 0;
+
+    if (n < 2)
+        return CHX_RB_NO_RED_DEPTH;
+    while (n >>= 1)
+        depth++;
+    return depth;
+}
+
+static struct chx_rb_node* chx_rb_build_subtree(struct chx_rb_node** nodes,
+                                                size_t n,
+                                                struct chx_rb_node* parent,
+                                                unsigned depth,
+                                                unsigned red_depth) {
+    struct chx_rb_node* node;
+    size_t mid;
+
+    if (!n)
+        return NULL;
+
+    mid = n / 2;
+    node = nodes[mid];
+    chx_rb_set_parent_color(node, parent,
+                            depth == red_depth ? CHX_RB_RED : CHX_RB_BLACK);
+    node->rb_left =
+        chx_rb_build_subtree(nodes, mid, node, depth + 1, red_depth);
+    node->rb_right = chx_rb_build_subtree(nodes + mid + 1, n - mid - 1, node,
+                                          depth + 1, red_depth);
+    return node;
+}
+
+void chx_rb_build_sorted(struct chx_rb_node** nodes, size_t n,
+                         struct chx_rb_root* root) {
+    root->rb_node =
+        chx_rb_build_subtree(nodes, n, NULL, 0, chx_rb_build_red_depth(n));
+}
+
+/*
+ * Parallel build: the top levels of the recursion hand their right half to a
+ * new thread, until there is one subtree per thread or the halves become too
+ * small to be worth a thread. The shape is identical to the serial build.
+ */
+
+#define CHX_RB_BUILD_PARALLEL_MIN 65536
+
+struct chx_rb_build_task {
+    struct chx_rb_node** nodes;
+    size_t n;
+    struct chx_rb_node* parent;
+    unsigned depth, red_depth;
+    unsigned nthreads;
+    struct chx_rb_node* result;
+};
+
+static void* chx_rb_build_task_run(void* arg) {
+    struct chx_rb_build_task* t = arg;
+    struct chx_rb_build_task right;
+    struct chx_rb_node* node;
+    pthread_t tid;
+    size_t mid;
+
+    if (t->nthreads < 2 || t->n < CHX_RB_BUILD_PARALLEL_MIN) {
+        t->result = chx_rb_build_subtree(t->nodes, t->n, t->parent, t->depth,
+                                         t->red_depth);
+        return NULL;
+    }
+
+    mid = t->n / 2;
+    node = t->nodes[mid];
+    chx_rb_set_parent_color(node, t->parent,
+                            t->depth == t->red_depth ? CHX_RB_RED
+                                                     : CHX_RB_BLACK);
+
+    right = (struct chx_rb_build_task){
+        .nodes = t->nodes + mid + 1,
+        .n = t->n - mid - 1,
+        .parent = node,
+        .depth = t->depth + 1,
+        .red_depth = t->red_depth,
+        .nthreads = t->nthreads / 2,
+    };
+    t->n = mid;
+    t->parent = node;
+    t->depth++;
+    t->nthreads -= right.nthreads;
+
+    if (pthread_create(&tid, NULL, chx_rb_build_task_run, &right)) {
+        /* No thread to be had, build both halves here */
+        chx_rb_build_task_run(&right);
+        chx_rb_build_task_run(t);
+    } else {
+        chx_rb_build_task_run(t);
+        pthread_join(tid, NULL);
+    }
+
+    node->rb_left = t->result;
+    node->rb_right = right.result;
+    t->result = node;
+    return NULL;
+}
+
+void chx_rb_build_sorted_parallel(struct chx_rb_node** nodes, size_t n,
+                                  struct chx_rb_root* root,
+                                  unsigned nthreads) {
+    struct chx_rb_build_task t = {
+        .nodes = nodes,
+        .n = n,
+        .parent = NULL,
+        .depth = 0,
+        .red_depth = chx_rb_build_red_depth(n),
+        .nthreads = nthreads,
+    };
+
+    chx_rb_build_task_run(&t);
+    root->rb_node = t.result;
+}
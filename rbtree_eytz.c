@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Eytzinger exports: construction and batch search with runtime dispatch.
+ *
+ * The AVX2 search walks four keys per register down the tree together for
+ * exactly height levels. A lane whose index has left the array stops moving, so
+ * every lane ends one step below its last node, as the scalar loop does.
+ */
+
+#include "rbtree_eytz.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHX_RB_EYTZ_AVX2 1
+#endif
+
+#define CHX_RB_EYTZ_ALIGN 64
+
+/*
+ * Fill the subtree at index @i in order, starting with @*node and moving
+ * @iter along.
+ */
+static void chx_rb_eytz_fill(struct chx_rb_eytz* eytz, size_t i,
+                             struct chx_rb_node** node,
+                             struct chx_rb_iter* iter,
+                             uint64_t (*key)(const struct chx_rb_node* node)) {
+    if (i > eytz->n)
+        return;
+    chx_rb_eytz_fill(eytz, 2 * i, node, iter, key);
+    eytz->nodes[i] = *node;
+    eytz->keys[i] = key(*node);
+    *node = chx_rb_iter_next(iter);
+    chx_rb_eytz_fill(eytz, 2 * i + 1, node, iter, key);
+}
+
+bool chx_rb_eytz_build(struct chx_rb_eytz* eytz,
+                       const struct chx_rb_root* root,
+                       uint64_t (*key)(const struct chx_rb_node* node)) {
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+    size_t n = 0, size;
+
+    memset(eytz, 0, sizeof(*eytz));
+    chx_rb_iter_for_each(node, &iter, root)
+        n++;
+    eytz->n = n;
+    while (((size_t)1 << eytz->height) - 1 < n)
+        eytz->height++;
+
+    size = ((n + 1) * sizeof(uint64_t) + CHX_RB_EYTZ_ALIGN - 1) /
+           CHX_RB_EYTZ_ALIGN * CHX_RB_EYTZ_ALIGN;
+    eytz->keys = aligned_alloc(CHX_RB_EYTZ_ALIGN, size);
+    eytz->nodes = malloc((n + 1) * sizeof(*eytz->nodes));
+    if (!eytz->keys || !eytz->nodes) {
+        chx_rb_eytz_destroy(eytz);
+        return false;
+    }
+
+    eytz->keys[0] = 0;
+    eytz->nodes[0] = NULL;
+    node = chx_rb_iter_first(&iter, root);
+    chx_rb_eytz_fill(eytz, 1, &node, &iter, key);
+    return true;
+}
+
+void chx_rb_eytz_destroy(struct chx_rb_eytz* eytz) {
+    free(eytz->keys);
+    free(eytz->nodes);
+    memset(eytz, 0, sizeof(*eytz));
+}
+
+static inline struct chx_rb_node*
+chx_rb_eytz_answer(const struct chx_rb_eytz* eytz, size_t i, uint64_t key,
+                   bool exact) {
+    if (exact && (!i || eytz->keys[i] != key))
+        return NULL;
+    return eytz->nodes[i];
+}
+
+#ifdef CHX_RB_EYTZ_AVX2
+/* The CPU does not change under a running process: ask once, at load time */
+static bool chx_rb_eytz_have_avx2;
+
+__attribute__((constructor)) static void chx_rb_eytz_detect(void) {
+    __builtin_cpu_init();
+    chx_rb_eytz_have_avx2 = __builtin_cpu_supports("avx2");
+}
+
+/* unsigned order through the signed compare */
+#define CHX_RB_EYTZ_SIGN _mm256_set1_epi64x(INT64_MIN)
+
+/* One level for four lanes; lanes past the array read as UINT64_MAX */
+__attribute__((target("avx2"))) static inline __m256i
+chx_rb_eytz_step_avx2(const struct chx_rb_eytz* eytz, __m256i i, __m256i x) {
+    const __m256i end = _mm256_set1_epi64x((long long)eytz->n + 1);
+    const long long* base = (const long long*)eytz->keys;
+    __m256i in = _mm256_cmpgt_epi64(end, i);
+    __m256i k = _mm256_mask_i64gather_epi64(_mm256_set1_epi64x(-1), base, i,
+                                            in, 8);
+    __m256i less =
+        _mm256_cmpgt_epi64(x, _mm256_xor_si256(k, CHX_RB_EYTZ_SIGN));
+    __m256i next = _mm256_sub_epi64(_mm256_slli_epi64(i, 1), less);
+    uint64_t idx[4];
+
+    i = _mm256_blendv_epi8(i, next, in);
+    _mm256_storeu_si256((__m256i*)idx, i);
+    for (int lane = 0; lane < 4; lane++)
+        __builtin_prefetch(eytz->keys + 16 * idx[lane]);
+    return i;
+}
+
+__attribute__((target("avx2"))) static inline void
+chx_rb_eytz_finish_avx2(const struct chx_rb_eytz* eytz, __m256i i,
+                        const uint64_t* keys, struct chx_rb_node** out,
+                        bool exact) {
+    uint64_t idx[4];
+
+    _mm256_storeu_si256((__m256i*)idx, i);
+    for (int lane = 0; lane < 4; lane++) {
+        size_t j = idx[lane] >> __builtin_ffsll(~idx[lane]);
+
+        out[lane] = chx_rb_eytz_answer(eytz, j, keys[lane], exact);
+    }
+}
+
+/* Eight searches per pass, in two registers, so more misses overlap */
+__attribute__((target("avx2"))) static size_t
+chx_rb_eytz_batch_avx2(const struct chx_rb_eytz* eytz, const uint64_t* keys,
+                       size_t n, struct chx_rb_node** out, bool exact) {
+    size_t done = 0;
+
+    for (; done + 8 <= n; done += 8) {
+        const __m256i* k = (const __m256i*)(keys + done);
+        __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256(k), CHX_RB_EYTZ_SIGN);
+        __m256i x1 =
+            _mm256_xor_si256(_mm256_loadu_si256(k + 1), CHX_RB_EYTZ_SIGN);
+        __m256i i0 = _mm256_set1_epi64x(1), i1 = i0;
+
+        for (unsigned level = 0; level < eytz->height; level++) {
+            i0 = chx_rb_eytz_step_avx2(eytz, i0, x0);
+            i1 = chx_rb_eytz_step_avx2(eytz, i1, x1);
+        }
+        chx_rb_eytz_finish_avx2(eytz, i0, keys + done, out + done, exact);
+        chx_rb_eytz_finish_avx2(eytz, i1, keys + done + 4, out + done + 4,
+                                exact);
+    }
+    return done;
+}
+#endif
+
+void __chx_rb_eytz_batch(const struct chx_rb_eytz* eytz, const uint64_t* keys,
+                         size_t n, struct chx_rb_node** out, bool exact,
+                         bool simd) {
+    size_t done = 0;
+
+#ifdef CHX_RB_EYTZ_AVX2
+    if (simd && chx_rb_eytz_have_avx2)
+        done = chx_rb_eytz_batch_avx2(eytz, keys, n, out, exact);
+#else
+    (void)simd;
+#endif
+    for (; done < n; done++)
+        out[done] = chx_rb_eytz_answer(
+            eytz, __chx_rb_eytz_search(eytz, keys[done]), keys[done], exact);
+}
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Eytzinger exports of an rbtree with integer keys.
+ *
+ * chx_rb_eytz_build() copies the uint64_t key of every node into an array in
+ * breadth first (Eytzinger) order: the root at index 1, the children of i at
+ * 2i and 2i + 1. The node pointers go into a parallel array, so queries
+ * return the original struct chx_rb_node. Signed keys can be stored with
+ * their sign bit flipped, which keeps the order.
+ *
+ * The search is branchless: each level only computes the next index from a
+ * comparison, and the nodes four levels down, the 16 descendants of the
+ * current one, are contiguous and prefetched. The final index, with its
+ * trailing right turns stripped, is the lower bound.
+ *
+ * The batch queries run eight searches at once in two AVX2 registers, with
+ * a gather per level, when the CPU has AVX2 and otherwise fall back to the
+ * scalar search. The export does not follow later changes to the tree, and
+ * its nodes must stay alive for as long as it is used.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+#include <stdint.h>
+
+struct chx_rb_eytz {
+    uint64_t* keys;             /* keys[1..n], breadth first */
+    struct chx_rb_node** nodes; /* nodes[0] is NULL */
+    size_t n;
+    unsigned height;
+};
+
+/*
+ * Export @root into @eytz, with @key(node) giving the key of each node.
+ * Returns false, leaving @eytz empty, if memory runs out.
+ */
+extern bool chx_rb_eytz_build(struct chx_rb_eytz* eytz,
+                              const struct chx_rb_root* root,
+                              uint64_t (*key)(const struct chx_rb_node* node));
+extern void chx_rb_eytz_destroy(struct chx_rb_eytz* eytz);
+
+/* Index of the lower bound of @key, 0 if there is none */
+static inline size_t __chx_rb_eytz_search(const struct chx_rb_eytz* eytz,
+                                          uint64_t key) {
+    const uint64_t* keys = eytz->keys;
+    size_t i = 1;
+
+    while (i <= eytz->n) {
+        /* two cache lines, keys is 64 byte aligned */
+        __builtin_prefetch(keys + 16 * i);
+        __builtin_prefetch(keys + 16 * i + 8);
+        i = 2 * i + (keys[i] < key);
+    }
+    return i >> __builtin_ffsll(~(unsigned long long)i);
+}
+
+/* The first node whose key is not below @key, or NULL */
+static inline struct chx_rb_node*
+chx_rb_eytz_lower_bound(const struct chx_rb_eytz* eytz, uint64_t key) {
+    return eytz->nodes[__chx_rb_eytz_search(eytz, key)];
+}
+
+/* A node with key @key, or NULL */
+static inline struct chx_rb_node*
+chx_rb_eytz_find(const struct chx_rb_eytz* eytz, uint64_t key) {
+    size_t i = __chx_rb_eytz_search(eytz, key);
+
+    return i && eytz->keys[i] == key ? eytz->nodes[i] : NULL;
+}
+
+/*
+ * Batch queries, out[i] is the answer for keys[i]. __chx_rb_eytz_batch()
+ * takes @simd false to force the scalar search.
+ */
+extern void __chx_rb_eytz_batch(const struct chx_rb_eytz* eytz,
+                                const uint64_t* keys, size_t n,
+                                struct chx_rb_node** out, bool exact,
+                                bool simd);
+
+static inline void chx_rb_eytz_find_batch(const struct chx_rb_eytz* eytz,
+                                          const uint64_t* keys, size_t n,
+                                          struct chx_rb_node** out) {
+    __chx_rb_eytz_batch(eytz, keys, n, out, true, true);
+}
+
+static inline void
+chx_rb_eytz_lower_bound_batch(const struct chx_rb_eytz* eytz,
+                              const uint64_t* keys, size_t n,
+                              struct chx_rb_node** out) {
+    __chx_rb_eytz_batch(eytz, keys, n, out, false, true);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Frozen snapshots in van Emde Boas order.
+ *
+ * The keys go into the implicit complete binary tree over breadth first
+ * indices 1..n, whose in-order sequence is the sorted order. Slots are
+ * assigned as for the perfect tree of the same height, so a tree that is not
+ * perfect leaves some slots unused, at most as many as there are keys.
+ *
+ * A tree of height h is split into a top tree of height h / 2 and bottom
+ * trees of height h - h / 2, stored top tree first, then the bottom trees
+ * left to right, each recursively. Every depth d > 0 starts bottom trees in
+ * exactly one of these splits, and that split fixes top_depth, top_size and
+ * bottom_size for d. A node's slot follows from the slot of the top tree root
+ * above it and which bottom tree it starts, which the low bits of its index
+ * give; see __chx_rb_frozen_pos().
+ */
+
+#include "rbtree_frozen.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHX_RB_FROZEN_ALIGN 64
+
+static void chx_rb_frozen_split(struct chx_rb_frozen* f, unsigned height,
+                                unsigned depth) {
+    unsigned top = height / 2;
+
+    if (height < 2)
+        return;
+    f->top_depth[depth + top] = depth;
+    f->top_size[depth + top] = ((size_t)1 << top) - 1;
+    f->bottom_size[depth + top] = ((size_t)1 << (height - top)) - 1;
+    chx_rb_frozen_split(f, top, depth);
+    chx_rb_frozen_split(f, height - top, depth + top);
+}
+
+/* Fill the subtree at index @i in order, @rank counts the keys placed */
+static void chx_rb_frozen_fill(struct chx_rb_frozen* f, size_t* pos, size_t i,
+                               unsigned depth, size_t* rank,
+                               void (*key)(void* dst,
+                                           const struct chx_rb_node* node)) {
+    char* slot;
+
+    if (i > f->n)
+        return;
+    pos[depth] = __chx_rb_frozen_pos(f, pos, i, depth);
+    chx_rb_frozen_fill(f, pos, 2 * i, depth + 1, rank, key);
+    slot = f->slots + pos[depth] * f->stride;
+    *(size_t*)slot = *rank;
+    key(slot + CHX_RB_FROZEN_KEY_OFFSET, f->nodes[*rank]);
+    (*rank)++;
+    chx_rb_frozen_fill(f, pos, 2 * i + 1, depth + 1, rank, key);
+}
+
+bool chx_rb_freeze(struct chx_rb_frozen* frozen,
+                   const struct chx_rb_root* root, size_t key_size,
+                   void (*key)(void* dst, const struct chx_rb_node* node)) {
+    size_t pos[CHX_RB_FROZEN_MAX_HEIGHT];
+    size_t n = 0, rank = 0, size;
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+
+    memset(frozen, 0, sizeof(*frozen));
+    chx_rb_iter_for_each(node, &iter, root)
+        n++;
+    if (!n)
+        return true;
+
+    while (frozen->height < CHX_RB_FROZEN_MAX_HEIGHT &&
+           ((size_t)1 << frozen->height) - 1 < n)
+        frozen->height++;
+    frozen->n = n;
+    frozen->stride = (CHX_RB_FROZEN_KEY_OFFSET + key_size + sizeof(size_t) -
+                      1) / sizeof(size_t) * sizeof(size_t);
+    size = ((((size_t)1 << frozen->height) - 1) * frozen->stride +
+            CHX_RB_FROZEN_ALIGN - 1) /
+           CHX_RB_FROZEN_ALIGN * CHX_RB_FROZEN_ALIGN;
+    frozen->slots = aligned_alloc(CHX_RB_FROZEN_ALIGN, size);
+    frozen->nodes = malloc(n * sizeof(*frozen->nodes));
+    if (!frozen->slots || !frozen->nodes) {
+        chx_rb_frozen_destroy(frozen);
+        return false;
+    }
+
+    chx_rb_iter_for_each(node, &iter, root)
+        frozen->nodes[rank++] = node;
+    chx_rb_frozen_split(frozen, frozen->height, 0);
+    rank = 0;
+    chx_rb_frozen_fill(frozen, pos, 1, 0, &rank, key);
+    return true;
+}
+
+void chx_rb_frozen_destroy(struct chx_rb_frozen* frozen) {
+    free(frozen->slots);
+    free(frozen->nodes);
+    memset(frozen, 0, sizeof(*frozen));
+}
@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Frozen read-only snapshots of an rbtree.
+ *
+ * chx_rb_freeze() copies the keys of a tree into one array in van Emde Boas
+ * order: the implicit complete search tree over the keys is split at half
+ * its height into a top tree and the bottom trees under it, each laid out
+ * contiguously and split again recursively. Whatever the cache line size B,
+ * a lookup then crosses O(log_B n) lines instead of touching O(log n)
+ * scattered nodes.
+ *
+ * Each slot holds the in-order rank of its key, followed by the key itself,
+ * copied by a caller supplied function and aligned only to size_t. The node
+ * pointers are kept in a separate in-order array, which also serves
+ * iteration. The snapshot does not follow later changes to the tree, and
+ * its nodes must stay alive for as long as it is used.
+ *
+ * Comparators get the key looked up and a pointer to a frozen key, and
+ * return <0, 0 or >0 like memcmp().
+ */
+
+#pragma once
+
+#include "rbtree.h"
+
+#define CHX_RB_FROZEN_MAX_HEIGHT (8 * sizeof(size_t))
+/* Offset of the key within a slot */
+#define CHX_RB_FROZEN_KEY_OFFSET sizeof(size_t)
+
+struct chx_rb_frozen {
+    char* slots;                /* vEB ordered {rank, key} */
+    struct chx_rb_node** nodes; /* in order */
+    size_t n;
+    size_t stride;
+    unsigned height;
+    /*
+     * For a node at depth d > 0: the depth of the root of the top tree it
+     * hangs under, and the sizes of that top tree and of the bottom trees
+     * below it.
+     */
+    unsigned char top_depth[CHX_RB_FROZEN_MAX_HEIGHT];
+    size_t top_size[CHX_RB_FROZEN_MAX_HEIGHT];
+    size_t bottom_size[CHX_RB_FROZEN_MAX_HEIGHT];
+};
+
+/*
+ * Snapshot @root into @frozen, with keys of @key_size bytes written by
+ * @key(dst, node). Returns false, leaving @frozen empty, if memory runs out.
+ */
+extern bool chx_rb_freeze(struct chx_rb_frozen* frozen,
+                          const struct chx_rb_root* root, size_t key_size,
+                          void (*key)(void* dst,
+                                      const struct chx_rb_node* node));
+extern void chx_rb_frozen_destroy(struct chx_rb_frozen* frozen);
+
+/*
+ * Slot of the node at @depth with breadth first index @i (the root is 1),
+ * given the slots of its ancestors in @pos.
+ */
+static inline size_t __chx_rb_frozen_pos(const struct chx_rb_frozen* frozen,
+                                         const size_t* pos, size_t i,
+                                         unsigned depth) {
+    size_t top = frozen->top_size[depth];
+
+    if (!depth)
+        return 0;
+    return pos[frozen->top_depth[depth]] + top +
+           (i & top) * frozen->bottom_size[depth];
+}
+
+/* The number of nodes in @frozen */
+static inline size_t chx_rb_frozen_count(const struct chx_rb_frozen* frozen) {
+    return frozen->n;
+}
+
+/* The node of in-order rank @rank, NULL past the end */
+static inline struct chx_rb_node*
+chx_rb_frozen_node(const struct chx_rb_frozen* frozen, size_t rank) {
+    return rank < frozen->n ? frozen->nodes[rank] : NULL;
+}
+
+/**
+ * chx_rb_frozen_lower_bound() - rank of the first key not ordered before @key
+ * @frozen: snapshot to search
+ * @key: key to search for
+ * @cmp: key comparator, see above
+ *
+ * Returns the count of @frozen if every key orders before @key.
+ */
+static inline size_t
+chx_rb_frozen_lower_bound(const struct chx_rb_frozen* frozen, const void* key,
+                          int (*cmp)(const void* key, const void* fkey)) {
+    size_t pos[CHX_RB_FROZEN_MAX_HEIGHT];
+    size_t i = 1, rank = frozen->n;
+
+    for (unsigned depth = 0; i <= frozen->n; depth++) {
+        const char* slot;
+
+        pos[depth] = __chx_rb_frozen_pos(frozen, pos, i, depth);
+        slot = frozen->slots + pos[depth] * frozen->stride;
+        if (cmp(key, slot + CHX_RB_FROZEN_KEY_OFFSET) <= 0) {
+            rank = *(const size_t*)slot;
+            i = 2 * i;
+        } else {
+            i = 2 * i + 1;
+        }
+    }
+    return rank;
+}
+
+/**
+ * chx_rb_frozen_find() - find a node matching @key
+ * @frozen: snapshot to search
+ * @key: key to search for
+ * @cmp: key comparator, see above
+ *
+ * Returns the node matching @key or NULL.
+ */
+static inline struct chx_rb_node*
+chx_rb_frozen_find(const struct chx_rb_frozen* frozen, const void* key,
+                   int (*cmp)(const void* key, const void* fkey)) {
+    size_t pos[CHX_RB_FROZEN_MAX_HEIGHT];
+    size_t i = 1;
+
+    for (unsigned depth = 0; i <= frozen->n; depth++) {
+        const char* slot;
+        int c;
+
+        pos[depth] = __chx_rb_frozen_pos(frozen, pos, i, depth);
+        slot = frozen->slots + pos[depth] * frozen->stride;
+        c = cmp(key, slot + CHX_RB_FROZEN_KEY_OFFSET);
+        if (c == 0)
+            return frozen->nodes[*(const size_t*)slot];
+        i = c < 0 ? 2 * i : 2 * i + 1;
+    }
+    return NULL;
+}
+
+/* Iterate over the nodes of @frozen in order, @rank is a size_t cursor */
+#define chx_rb_frozen_for_each(node, rank, frozen)                             \
+    for ((rank) = 0; ((node) = chx_rb_frozen_node(frozen, rank)); (rank)++)
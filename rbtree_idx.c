@@ -0,0 +1,545 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Index linked rbtrees, see rbtree_idx.h.
+ *
+ * This is rbtree.c with node pointers replaced by arena indices; the case
+ * diagrams and comments there apply here unchanged. Both the index and the
+ * node pointer of the nodes being worked on are kept at hand, so that each
+ * node is only located in the arena once per step.
+ */
+
+#include "rbtree_idx_augmented.h"
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+/* Node at index @i of the arena in scope */
+#define N(i) chx_rb_idx_node(arena, (i))
+
+static inline void __chx_rb_idx_change_child(
+    uint32_t old, uint32_t new_node, uint32_t parent,
+    struct chx_rb_idx_root* root, const struct chx_rb_idx_arena* arena) {
+    if (parent) {
+        struct chx_rb_idx_node* p = N(parent);
+
+        if (p->rb_left == old)
+            p->rb_left = new_node;
+        else
+            p->rb_right = new_node;
+    } else
+        root->rb_node = new_node;
+}
+
+static inline void chx_rb_idx_set_black(struct chx_rb_idx_node* rb) {
+    rb->__rb_parent_color |= CHX_RB_BLACK;
+}
+
+/*
+ * Helper function for rotations:
+ * - old's parent and color get assigned to new
+ * - old gets assigned new as a parent and 'color' as a color.
+ */
+static inline void
+__chx_rb_idx_rotate_set_parents(uint32_t old, uint32_t new,
+                                struct chx_rb_idx_root* root, int color,
+                                const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node *o = N(old), *n = N(new);
+    uint32_t parent = chx_rb_idx_parent(o);
+
+    n->__rb_parent_color = o->__rb_parent_color;
+    chx_rb_idx_set_parent_color(o, new, color);
+    __chx_rb_idx_change_child(old, new, parent, root, arena);
+}
+
+static inline void __chx_rb_idx_insert(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node)) {
+    uint32_t parent = chx_rb_idx_parent(N(node)), gparent, tmp;
+    struct chx_rb_idx_node *n, *p, *g;
+
+    while (true) {
+        /* Loop invariant: node is red. */
+        if (unlikely(!parent)) {
+            chx_rb_idx_set_parent_color(N(node), CHX_RB_IDX_NIL, CHX_RB_BLACK);
+            break;
+        }
+
+        p = N(parent);
+        if (chx_rb_idx_is_black(p))
+            break;
+
+        gparent = chx_rb_idx_parent(p);
+        g = N(gparent);
+
+        tmp = g->rb_right;
+        if (parent != tmp) { /* parent == gparent->rb_left */
+            if (tmp && chx_rb_idx_is_red(N(tmp))) {
+                /* Case 1 - color flips */
+                chx_rb_idx_set_parent_color(N(tmp), gparent, CHX_RB_BLACK);
+                chx_rb_idx_set_parent_color(p, gparent, CHX_RB_BLACK);
+                node = gparent;
+                parent = chx_rb_idx_parent(g);
+                chx_rb_idx_set_parent_color(g, parent, CHX_RB_RED);
+                continue;
+            }
+
+            n = N(node);
+            tmp = p->rb_right;
+            if (node == tmp) {
+                /* Case 2 - left rotate at parent */
+                tmp = n->rb_left;
+                p->rb_right = tmp;
+                n->rb_left = parent;
+                if (tmp)
+                    chx_rb_idx_set_parent_color(N(tmp), parent, CHX_RB_BLACK);
+                chx_rb_idx_set_parent_color(p, node, CHX_RB_RED);
+                augment_rotate(arena, parent, node);
+                parent = node;
+                p = n;
+                tmp = n->rb_right;
+            }
+
+            /* Case 3 - right rotate at gparent */
+            g->rb_left = tmp; /* == parent->rb_right */
+            p->rb_right = gparent;
+            if (tmp)
+                chx_rb_idx_set_parent_color(N(tmp), gparent, CHX_RB_BLACK);
+            __chx_rb_idx_rotate_set_parents(gparent, parent, root, CHX_RB_RED,
+                                            arena);
+            augment_rotate(arena, gparent, parent);
+            break;
+        } else {
+            tmp = g->rb_left;
+            if (tmp && chx_rb_idx_is_red(N(tmp))) {
+                /* Case 1 - color flips */
+                chx_rb_idx_set_parent_color(N(tmp), gparent, CHX_RB_BLACK);
+                chx_rb_idx_set_parent_color(p, gparent, CHX_RB_BLACK);
+                node = gparent;
+                parent = chx_rb_idx_parent(g);
+                chx_rb_idx_set_parent_color(g, parent, CHX_RB_RED);
+                continue;
+            }
+
+            n = N(node);
+            tmp = p->rb_left;
+            if (node == tmp) {
+                /* Case 2 - right rotate at parent */
+                tmp = n->rb_right;
+                p->rb_left = tmp;
+                n->rb_right = parent;
+                if (tmp)
+                    chx_rb_idx_set_parent_color(N(tmp), parent, CHX_RB_BLACK);
+                chx_rb_idx_set_parent_color(p, node, CHX_RB_RED);
+                augment_rotate(arena, parent, node);
+                parent = node;
+                p = n;
+                tmp = n->rb_left;
+            }
+
+            /* Case 3 - left rotate at gparent */
+            g->rb_right = tmp; /* == parent->rb_left */
+            p->rb_left = gparent;
+            if (tmp)
+                chx_rb_idx_set_parent_color(N(tmp), gparent, CHX_RB_BLACK);
+            __chx_rb_idx_rotate_set_parents(gparent, parent, root, CHX_RB_RED,
+                                            arena);
+            augment_rotate(arena, gparent, parent);
+            break;
+        }
+    }
+}
+
+static inline void ____chx_rb_idx_erase_color(
+    uint32_t parent, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node)) {
+    uint32_t node = CHX_RB_IDX_NIL, sibling, tmp1, tmp2;
+    struct chx_rb_idx_node *p, *s, *t2;
+
+    while (true) {
+        /*
+         * Loop invariants:
+         * - node is black (or NIL on first iteration)
+         * - node is not the root (parent is not NIL)
+         * - All leaf paths going through parent and node have a
+         *   black node count that is 1 lower than other leaf paths.
+         */
+        p = N(parent);
+        sibling = p->rb_right;
+        if (node != sibling) { /* node == parent->rb_left */
+            s = N(sibling);
+            if (chx_rb_idx_is_red(s)) {
+                /* Case 1 - left rotate at parent */
+                tmp1 = s->rb_left;
+                p->rb_right = tmp1;
+                s->rb_left = parent;
+                chx_rb_idx_set_parent_color(N(tmp1), parent, CHX_RB_BLACK);
+                __chx_rb_idx_rotate_set_parents(parent, sibling, root,
+                                                CHX_RB_RED, arena);
+                augment_rotate(arena, parent, sibling);
+                sibling = tmp1;
+                s = N(sibling);
+            }
+            tmp1 = s->rb_right;
+            if (!tmp1 || chx_rb_idx_is_black(N(tmp1))) {
+                tmp2 = s->rb_left;
+                if (!tmp2 || chx_rb_idx_is_black(N(tmp2))) {
+                    /* Case 2 - sibling color flip */
+                    chx_rb_idx_set_parent_color(s, parent, CHX_RB_RED);
+                    if (chx_rb_idx_is_red(p))
+                        chx_rb_idx_set_black(p);
+                    else {
+                        node = parent;
+                        parent = chx_rb_idx_parent(p);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                /* Case 3 - right rotate at sibling */
+                t2 = N(tmp2);
+                tmp1 = t2->rb_right;
+                s->rb_left = tmp1;
+                t2->rb_right = sibling;
+                p->rb_right = tmp2;
+                if (tmp1)
+                    chx_rb_idx_set_parent_color(N(tmp1), sibling, CHX_RB_BLACK);
+                augment_rotate(arena, sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+                s = t2;
+            }
+            /* Case 4 - left rotate at parent + color flips */
+            tmp2 = s->rb_left;
+            p->rb_right = tmp2;
+            s->rb_left = parent;
+            chx_rb_idx_set_parent_color(N(tmp1), sibling, CHX_RB_BLACK);
+            if (tmp2)
+                chx_rb_idx_set_parent(N(tmp2), parent);
+            __chx_rb_idx_rotate_set_parents(parent, sibling, root, CHX_RB_BLACK,
+                                            arena);
+            augment_rotate(arena, parent, sibling);
+            break;
+        } else {
+            sibling = p->rb_left;
+            s = N(sibling);
+            if (chx_rb_idx_is_red(s)) {
+                /* Case 1 - right rotate at parent */
+                tmp1 = s->rb_right;
+                p->rb_left = tmp1;
+                s->rb_right = parent;
+                chx_rb_idx_set_parent_color(N(tmp1), parent, CHX_RB_BLACK);
+                __chx_rb_idx_rotate_set_parents(parent, sibling, root,
+                                                CHX_RB_RED, arena);
+                augment_rotate(arena, parent, sibling);
+                sibling = tmp1;
+                s = N(sibling);
+            }
+            tmp1 = s->rb_left;
+            if (!tmp1 || chx_rb_idx_is_black(N(tmp1))) {
+                tmp2 = s->rb_right;
+                if (!tmp2 || chx_rb_idx_is_black(N(tmp2))) {
+                    /* Case 2 - sibling color flip */
+                    chx_rb_idx_set_parent_color(s, parent, CHX_RB_RED);
+                    if (chx_rb_idx_is_red(p))
+                        chx_rb_idx_set_black(p);
+                    else {
+                        node = parent;
+                        parent = chx_rb_idx_parent(p);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                /* Case 3 - left rotate at sibling */
+                t2 = N(tmp2);
+                tmp1 = t2->rb_left;
+                s->rb_right = tmp1;
+                t2->rb_left = sibling;
+                p->rb_left = tmp2;
+                if (tmp1)
+                    chx_rb_idx_set_parent_color(N(tmp1), sibling, CHX_RB_BLACK);
+                augment_rotate(arena, sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+                s = t2;
+            }
+            /* Case 4 - right rotate at parent + color flips */
+            tmp2 = s->rb_right;
+            p->rb_left = tmp2;
+            s->rb_right = parent;
+            chx_rb_idx_set_parent_color(N(tmp1), sibling, CHX_RB_BLACK);
+            if (tmp2)
+                chx_rb_idx_set_parent(N(tmp2), parent);
+            __chx_rb_idx_rotate_set_parents(parent, sibling, root, CHX_RB_BLACK,
+                                            arena);
+            augment_rotate(arena, parent, sibling);
+            break;
+        }
+    }
+}
+
+/* Non-inline version for chx_rb_idx_erase_augmented() use */
+void __chx_rb_idx_erase_color(
+    uint32_t parent, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node)) {
+    ____chx_rb_idx_erase_color(parent, root, arena, augment_rotate);
+}
+
+/*
+ * Non-augmented manipulation functions, with dummy callbacks optimized out
+ * as in rbtree.c.
+ */
+
+static inline void dummy_propagate(const struct chx_rb_idx_arena* arena
+                                   __attribute__((unused)),
+                                   uint32_t node __attribute__((unused)),
+                                   uint32_t stop __attribute__((unused))) {}
+static inline void dummy_copy(const struct chx_rb_idx_arena* arena
+                              __attribute__((unused)),
+                              uint32_t old __attribute__((unused)),
+                              uint32_t new_node __attribute__((unused))) {}
+static inline void dummy_rotate(const struct chx_rb_idx_arena* arena
+                                __attribute__((unused)),
+                                uint32_t old __attribute__((unused)),
+                                uint32_t new_node __attribute__((unused))) {}
+
+static const struct chx_rb_idx_augment_callbacks dummy_callbacks = {
+    .propagate = dummy_propagate, .copy = dummy_copy, .rotate = dummy_rotate};
+
+void chx_rb_idx_insert_color(uint32_t node, struct chx_rb_idx_root* root,
+                             const struct chx_rb_idx_arena* arena) {
+    __chx_rb_idx_insert(node, root, arena, dummy_rotate);
+}
+
+void chx_rb_idx_erase(uint32_t node, struct chx_rb_idx_root* root,
+                      const struct chx_rb_idx_arena* arena) {
+    uint32_t rebalance;
+
+    rebalance =
+        __chx_rb_idx_erase_augmented(node, root, arena, &dummy_callbacks);
+    if (rebalance)
+        ____chx_rb_idx_erase_color(rebalance, root, arena, dummy_rotate);
+}
+
+void __chx_rb_idx_insert_augmented(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node)) {
+    __chx_rb_idx_insert(node, root, arena, augment_rotate);
+}
+
+uint32_t chx_rb_idx_first(const struct chx_rb_idx_root* root,
+                          const struct chx_rb_idx_arena* arena) {
+    uint32_t n = root->rb_node;
+
+    if (!n)
+        return CHX_RB_IDX_NIL;
+    while (N(n)->rb_left)
+        n = N(n)->rb_left;
+    return n;
+}
+
+uint32_t chx_rb_idx_last(const struct chx_rb_idx_root* root,
+                         const struct chx_rb_idx_arena* arena) {
+    uint32_t n = root->rb_node;
+
+    if (!n)
+        return CHX_RB_IDX_NIL;
+    while (N(n)->rb_right)
+        n = N(n)->rb_right;
+    return n;
+}
+
+uint32_t chx_rb_idx_next(uint32_t node, const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node* n = N(node);
+    uint32_t parent;
+
+    if (CHX_RB_IDX_EMPTY_NODE(n))
+        return CHX_RB_IDX_NIL;
+
+    /* Down and then left as far as we can */
+    if (n->rb_right) {
+        node = n->rb_right;
+        while (N(node)->rb_left)
+            node = N(node)->rb_left;
+        return node;
+    }
+
+    /* Up until we come from a left-hand child */
+    while ((parent = chx_rb_idx_parent(n)) && node == N(parent)->rb_right) {
+        node = parent;
+        n = N(node);
+    }
+
+    return parent;
+}
+
+uint32_t chx_rb_idx_prev(uint32_t node, const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node* n = N(node);
+    uint32_t parent;
+
+    if (CHX_RB_IDX_EMPTY_NODE(n))
+        return CHX_RB_IDX_NIL;
+
+    /* Down and then right as far as we can */
+    if (n->rb_left) {
+        node = n->rb_left;
+        while (N(node)->rb_right)
+            node = N(node)->rb_right;
+        return node;
+    }
+
+    /* Up until we come from a right-hand child */
+    while ((parent = chx_rb_idx_parent(n)) && node == N(parent)->rb_left) {
+        node = parent;
+        n = N(node);
+    }
+
+    return parent;
+}
+
+void chx_rb_idx_replace_node(uint32_t victim, uint32_t new_node,
+                             struct chx_rb_idx_root* root,
+                             const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node *v = N(victim), *n = N(new_node);
+    uint32_t parent = chx_rb_idx_parent(v);
+
+    /* Copy the links/colour from the victim to the replacement */
+    *n = *v;
+
+    /* Set the surrounding nodes to point to the replacement */
+    if (v->rb_left)
+        chx_rb_idx_set_parent(N(v->rb_left), new_node);
+    if (v->rb_right)
+        chx_rb_idx_set_parent(N(v->rb_right), new_node);
+    __chx_rb_idx_change_child(victim, new_node, parent, root, arena);
+}
+
+static uint32_t
+chx_rb_idx_left_deepest_node(uint32_t node,
+                             const struct chx_rb_idx_arena* arena) {
+    for (;;) {
+        struct chx_rb_idx_node* n = N(node);
+
+        if (n->rb_left)
+            node = n->rb_left;
+        else if (n->rb_right)
+            node = n->rb_right;
+        else
+            return node;
+    }
+}
+
+uint32_t chx_rb_idx_next_postorder(uint32_t node,
+                                   const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node* p;
+    uint32_t parent;
+
+    if (!node)
+        return CHX_RB_IDX_NIL;
+    parent = chx_rb_idx_parent(N(node));
+    if (!parent)
+        return CHX_RB_IDX_NIL;
+
+    /* If we're sitting on node, we've already seen our children */
+    p = N(parent);
+    if (node == p->rb_left && p->rb_right)
+        return chx_rb_idx_left_deepest_node(p->rb_right, arena);
+    return parent;
+}
+
+uint32_t chx_rb_idx_first_postorder(const struct chx_rb_idx_root* root,
+                                    const struct chx_rb_idx_arena* arena) {
+    if (!root->rb_node)
+        return CHX_RB_IDX_NIL;
+
+    return chx_rb_idx_left_deepest_node(root->rb_node, arena);
+}
+
+uint32_t __chx_rb_idx_erase_augmented(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    const struct chx_rb_idx_augment_callbacks* augment) {
+    struct chx_rb_idx_node* n = N(node);
+    uint32_t child = n->rb_right, tmp = n->rb_left;
+    uint32_t parent, rebalance, pc;
+
+    if (!tmp) {
+        /* Case 1: node to erase has no more than 1 child (easy!) */
+        pc = n->__rb_parent_color;
+        parent = __chx_rb_idx_parent(pc);
+        __chx_rb_idx_change_child(node, child, parent, root, arena);
+        if (child) {
+            N(child)->__rb_parent_color = pc;
+            rebalance = CHX_RB_IDX_NIL;
+        } else
+            rebalance = __chx_rb_idx_is_black(pc) ? parent : CHX_RB_IDX_NIL;
+        tmp = parent;
+    } else if (!child) {
+        /* Still case 1, but this time the child is node->rb_left */
+        N(tmp)->__rb_parent_color = pc = n->__rb_parent_color;
+        parent = __chx_rb_idx_parent(pc);
+        __chx_rb_idx_change_child(node, tmp, parent, root, arena);
+        rebalance = CHX_RB_IDX_NIL;
+        tmp = parent;
+    } else {
+        uint32_t successor = child, child2;
+        struct chx_rb_idx_node* s;
+
+        tmp = N(child)->rb_left;
+        if (!tmp) {
+            /* Case 2: node's successor is its right child */
+            parent = successor;
+            child2 = N(successor)->rb_right;
+
+            augment->copy(arena, node, successor);
+        } else {
+            /*
+             * Case 3: node's successor is leftmost under
+             * node's right child subtree
+             */
+            do {
+                parent = successor;
+                successor = tmp;
+                tmp = N(tmp)->rb_left;
+            } while (tmp);
+            s = N(successor);
+            child2 = s->rb_right;
+            N(parent)->rb_left = child2;
+            s->rb_right = child;
+            chx_rb_idx_set_parent(N(child), successor);
+
+            augment->copy(arena, node, successor);
+            augment->propagate(arena, parent, successor);
+        }
+
+        s = N(successor);
+        tmp = n->rb_left;
+        s->rb_left = tmp;
+        chx_rb_idx_set_parent(N(tmp), successor);
+
+        pc = n->__rb_parent_color;
+        tmp = __chx_rb_idx_parent(pc);
+        __chx_rb_idx_change_child(node, successor, tmp, root, arena);
+
+        if (child2) {
+            chx_rb_idx_set_parent_color(N(child2), parent, CHX_RB_BLACK);
+            rebalance = CHX_RB_IDX_NIL;
+        } else {
+            rebalance = chx_rb_idx_is_black(s) ? parent : CHX_RB_IDX_NIL;
+        }
+        s->__rb_parent_color = pc;
+        tmp = successor;
+    }
+
+    augment->propagate(arena, tmp, CHX_RB_IDX_NIL);
+    return rebalance;
+}
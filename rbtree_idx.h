@@ -0,0 +1,281 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Index linked rbtrees for nodes that live in one arena.
+ *
+ * struct chx_rb_idx_node links nodes by 32 bit arena indices instead of
+ * pointers, 12 bytes instead of 24 on LP64, with the color packed in the low
+ * bit of the parent index. Element i of the arena lives at base + i * stride
+ * and holds its chx_rb_idx_node at offset within it.
+ *
+ * Index 0 is CHX_RB_IDX_NIL, the NULL of this API, so element 0 of the arena
+ * is never part of a tree. The packed parent leaves 31 bits and the all ones
+ * pattern marks empty nodes, so indices go up to CHX_RB_IDX_MAX.
+ *
+ * The API mirrors rbtree.h: nodes are named by index and every call also
+ * takes the arena. Comparators still get node pointers, from which
+ * chx_rb_entry() recovers the element.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+#include <stdint.h>
+
+#define CHX_RB_IDX_NIL 0u
+#define CHX_RB_IDX_MAX 0x7ffffffeu
+
+struct chx_rb_idx_node {
+    uint32_t __rb_parent_color;
+    uint32_t rb_right;
+    uint32_t rb_left;
+};
+
+struct chx_rb_idx_root {
+    uint32_t rb_node;
+};
+
+struct chx_rb_idx_root_cached {
+    struct chx_rb_idx_root rb_root;
+    uint32_t rb_leftmost;
+};
+
+struct chx_rb_idx_arena {
+    char* base;
+    size_t stride;
+    size_t offset;
+};
+
+#define CHX_RB_IDX_ROOT                                                        \
+    (struct chx_rb_idx_root) { CHX_RB_IDX_NIL }
+#define CHX_RB_IDX_ROOT_CACHED                                                 \
+    (struct chx_rb_idx_root_cached) { {CHX_RB_IDX_NIL}, CHX_RB_IDX_NIL }
+
+/* Arena over an array of @type whose chx_rb_idx_node is @member */
+#define CHX_RB_IDX_ARENA(base, type, member)                                   \
+    (struct chx_rb_idx_arena) {                                                \
+        (char*)(base), sizeof(type), offsetof(type, member)                    \
+    }
+
+static inline struct chx_rb_idx_node*
+chx_rb_idx_node(const struct chx_rb_idx_arena* arena, uint32_t idx) {
+    return (struct chx_rb_idx_node*)(arena->base + (size_t)idx * arena->stride +
+                                     arena->offset);
+}
+
+/* The arena element of type @type at index @idx */
+#define chx_rb_idx_entry(arena, idx, type)                                     \
+    ((type*)((arena)->base + (size_t)(idx) * (arena)->stride))
+
+#define chx_rb_idx_parent(r) ((uint32_t)((r)->__rb_parent_color >> 1))
+
+#define CHX_RB_IDX_EMPTY_ROOT(root) ((root)->rb_node == CHX_RB_IDX_NIL)
+
+/* 'empty' nodes are nodes that are known not to be inserted in an rbtree */
+#define CHX_RB_IDX_EMPTY_NODE(node) ((node)->__rb_parent_color == UINT32_MAX)
+#define CHX_RB_IDX_CLEAR_NODE(node) ((node)->__rb_parent_color = UINT32_MAX)
+
+extern void chx_rb_idx_insert_color(uint32_t node, struct chx_rb_idx_root* root,
+                                    const struct chx_rb_idx_arena* arena);
+extern void chx_rb_idx_erase(uint32_t node, struct chx_rb_idx_root* root,
+                             const struct chx_rb_idx_arena* arena);
+
+/* Find logical next and previous nodes in a tree */
+extern uint32_t chx_rb_idx_next(uint32_t node,
+                                const struct chx_rb_idx_arena* arena);
+extern uint32_t chx_rb_idx_prev(uint32_t node,
+                                const struct chx_rb_idx_arena* arena);
+extern uint32_t chx_rb_idx_first(const struct chx_rb_idx_root* root,
+                                 const struct chx_rb_idx_arena* arena);
+extern uint32_t chx_rb_idx_last(const struct chx_rb_idx_root* root,
+                                const struct chx_rb_idx_arena* arena);
+
+/* Postorder iteration - always visit the parent after its children */
+extern uint32_t
+chx_rb_idx_first_postorder(const struct chx_rb_idx_root* root,
+                           const struct chx_rb_idx_arena* arena);
+extern uint32_t chx_rb_idx_next_postorder(uint32_t node,
+                                          const struct chx_rb_idx_arena* arena);
+
+/* Fast replacement of a single node without remove/rebalance/add/rebalance */
+extern void chx_rb_idx_replace_node(uint32_t victim, uint32_t new_node,
+                                    struct chx_rb_idx_root* root,
+                                    const struct chx_rb_idx_arena* arena);
+
+static inline void chx_rb_idx_link_node(uint32_t node, uint32_t parent,
+                                        uint32_t* rb_link,
+                                        const struct chx_rb_idx_arena* arena) {
+    struct chx_rb_idx_node* n = chx_rb_idx_node(arena, node);
+
+    n->__rb_parent_color = parent << 1;
+    n->rb_left = n->rb_right = CHX_RB_IDX_NIL;
+
+    *rb_link = node;
+}
+
+/* Same as chx_rb_idx_first(), but O(1) */
+#define chx_rb_idx_first_cached(root) (root)->rb_leftmost
+
+static inline void
+chx_rb_idx_insert_color_cached(uint32_t node,
+                               struct chx_rb_idx_root_cached* root,
+                               const struct chx_rb_idx_arena* arena,
+                               bool leftmost) {
+    if (leftmost)
+        root->rb_leftmost = node;
+    chx_rb_idx_insert_color(node, &root->rb_root, arena);
+}
+
+static inline uint32_t
+chx_rb_idx_erase_cached(uint32_t node, struct chx_rb_idx_root_cached* root,
+                        const struct chx_rb_idx_arena* arena) {
+    uint32_t leftmost = CHX_RB_IDX_NIL;
+
+    if (root->rb_leftmost == node)
+        leftmost = root->rb_leftmost = chx_rb_idx_next(node, arena);
+
+    chx_rb_idx_erase(node, &root->rb_root, arena);
+
+    return leftmost;
+}
+
+static inline void
+chx_rb_idx_replace_node_cached(uint32_t victim, uint32_t new_node,
+                               struct chx_rb_idx_root_cached* root,
+                               const struct chx_rb_idx_arena* arena) {
+    if (root->rb_leftmost == victim)
+        root->rb_leftmost = new_node;
+    chx_rb_idx_replace_node(victim, new_node, &root->rb_root, arena);
+}
+
+/**
+ * chx_rb_idx_add() - insert @node into @tree
+ * @node: index of the node to insert
+ * @tree: tree to insert @node into
+ * @arena: arena holding the nodes of @tree
+ * @less: operator defining the (partial) node order
+ */
+static inline void chx_rb_idx_add(uint32_t node, struct chx_rb_idx_root* tree,
+                                  const struct chx_rb_idx_arena* arena,
+                                  bool (*less)(struct chx_rb_idx_node*,
+                                               const struct chx_rb_idx_node*)) {
+    struct chx_rb_idx_node *n = chx_rb_idx_node(arena, node), *p;
+    uint32_t* link = &tree->rb_node;
+    uint32_t parent = CHX_RB_IDX_NIL;
+
+    while (*link) {
+        parent = *link;
+        p = chx_rb_idx_node(arena, parent);
+        if (less(n, p))
+            link = &p->rb_left;
+        else
+            link = &p->rb_right;
+    }
+
+    chx_rb_idx_link_node(node, parent, link, arena);
+    chx_rb_idx_insert_color(node, tree, arena);
+}
+
+/**
+ * chx_rb_idx_add_cached() - insert @node into the leftmost cached tree @tree
+ * @node: index of the node to insert
+ * @tree: leftmost cached tree to insert @node into
+ * @arena: arena holding the nodes of @tree
+ * @less: operator defining the (partial) node order
+ *
+ * Returns @node when it is the new leftmost, or CHX_RB_IDX_NIL.
+ */
+static inline uint32_t chx_rb_idx_add_cached(
+    uint32_t node, struct chx_rb_idx_root_cached* tree,
+    const struct chx_rb_idx_arena* arena,
+    bool (*less)(struct chx_rb_idx_node*, const struct chx_rb_idx_node*)) {
+    struct chx_rb_idx_node *n = chx_rb_idx_node(arena, node), *p;
+    uint32_t* link = &tree->rb_root.rb_node;
+    uint32_t parent = CHX_RB_IDX_NIL;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        p = chx_rb_idx_node(arena, parent);
+        if (less(n, p)) {
+            link = &p->rb_left;
+        } else {
+            link = &p->rb_right;
+            leftmost = false;
+        }
+    }
+
+    chx_rb_idx_link_node(node, parent, link, arena);
+    chx_rb_idx_insert_color_cached(node, tree, arena, leftmost);
+
+    return leftmost ? node : CHX_RB_IDX_NIL;
+}
+
+/**
+ * chx_rb_idx_find_add() - find equivalent @node in @tree, or add @node
+ * @node: index of the node to look-for / insert
+ * @tree: tree to search / modify
+ * @arena: arena holding the nodes of @tree
+ * @cmp: operator defining the node order
+ *
+ * Returns the index of the node matching @node, or CHX_RB_IDX_NIL when no
+ * match is found and @node is inserted.
+ */
+static inline uint32_t
+chx_rb_idx_find_add(uint32_t node, struct chx_rb_idx_root* tree,
+                    const struct chx_rb_idx_arena* arena,
+                    int (*cmp)(struct chx_rb_idx_node*,
+                               const struct chx_rb_idx_node*)) {
+    struct chx_rb_idx_node *n = chx_rb_idx_node(arena, node), *p;
+    uint32_t* link = &tree->rb_node;
+    uint32_t parent = CHX_RB_IDX_NIL;
+    int c;
+
+    while (*link) {
+        parent = *link;
+        p = chx_rb_idx_node(arena, parent);
+        c = cmp(n, p);
+
+        if (c < 0)
+            link = &p->rb_left;
+        else if (c > 0)
+            link = &p->rb_right;
+        else
+            return parent;
+    }
+
+    chx_rb_idx_link_node(node, parent, link, arena);
+    chx_rb_idx_insert_color(node, tree, arena);
+    return CHX_RB_IDX_NIL;
+}
+
+/**
+ * chx_rb_idx_find() - find @key in tree @tree
+ * @key: key to match
+ * @tree: tree to search
+ * @arena: arena holding the nodes of @tree
+ * @cmp: operator defining the node order
+ *
+ * Returns the index of the node matching @key, or CHX_RB_IDX_NIL.
+ */
+static inline uint32_t
+chx_rb_idx_find(const void* key, const struct chx_rb_idx_root* tree,
+                const struct chx_rb_idx_arena* arena,
+                int (*cmp)(const void* key, const struct chx_rb_idx_node*)) {
+    uint32_t node = tree->rb_node;
+    struct chx_rb_idx_node* n;
+    int c;
+
+    while (node) {
+        n = chx_rb_idx_node(arena, node);
+        c = cmp(key, n);
+
+        if (c < 0)
+            node = n->rb_left;
+        else if (c > 0)
+            node = n->rb_right;
+        else
+            return node;
+    }
+
+    return CHX_RB_IDX_NIL;
+}
@@ -0,0 +1,201 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Augmented index linked rbtrees, the rbtree_augmented.h counterpart of
+ * rbtree_idx.h. Callbacks get the arena and node indices.
+ */
+
+#pragma once
+
+#include "rbtree_augmented.h"
+#include "rbtree_idx.h"
+
+struct chx_rb_idx_augment_callbacks {
+    void (*propagate)(const struct chx_rb_idx_arena* arena, uint32_t node,
+                      uint32_t stop);
+    void (*copy)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                 uint32_t new_node);
+    void (*rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                   uint32_t new_node);
+};
+
+extern void __chx_rb_idx_insert_augmented(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node));
+
+/*
+ * Same contract as chx_rb_insert_augmented(): update the augmented data on
+ * the path to the new node, link it, then call this instead of
+ * chx_rb_idx_insert_color().
+ */
+static inline void chx_rb_idx_insert_augmented(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    const struct chx_rb_idx_augment_callbacks* augment) {
+    __chx_rb_idx_insert_augmented(node, root, arena, augment->rotate);
+}
+
+static inline void chx_rb_idx_insert_augmented_cached(
+    uint32_t node, struct chx_rb_idx_root_cached* root,
+    const struct chx_rb_idx_arena* arena, bool newleft,
+    const struct chx_rb_idx_augment_callbacks* augment) {
+    if (newleft)
+        root->rb_leftmost = node;
+    chx_rb_idx_insert_augmented(node, &root->rb_root, arena, augment);
+}
+
+static inline uint32_t chx_rb_idx_add_augmented_cached(
+    uint32_t node, struct chx_rb_idx_root_cached* tree,
+    const struct chx_rb_idx_arena* arena,
+    bool (*less)(struct chx_rb_idx_node*, const struct chx_rb_idx_node*),
+    const struct chx_rb_idx_augment_callbacks* augment) {
+    struct chx_rb_idx_node *n = chx_rb_idx_node(arena, node), *p;
+    uint32_t* link = &tree->rb_root.rb_node;
+    uint32_t parent = CHX_RB_IDX_NIL;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        p = chx_rb_idx_node(arena, parent);
+        if (less(n, p)) {
+            link = &p->rb_left;
+        } else {
+            link = &p->rb_right;
+            leftmost = false;
+        }
+    }
+
+    chx_rb_idx_link_node(node, parent, link, arena);
+    augment->propagate(arena, parent, CHX_RB_IDX_NIL); /* suboptimal */
+    chx_rb_idx_insert_augmented_cached(node, tree, arena, leftmost, augment);
+
+    return leftmost ? node : CHX_RB_IDX_NIL;
+}
+
+#define __chx_rb_idx_parent(pc) ((uint32_t)((pc) >> 1))
+
+#define __chx_rb_idx_color(pc) ((pc) & 1)
+#define __chx_rb_idx_is_black(pc) __chx_rb_idx_color(pc)
+#define __chx_rb_idx_is_red(pc) (!__chx_rb_idx_color(pc))
+#define chx_rb_idx_color(rb) __chx_rb_idx_color((rb)->__rb_parent_color)
+#define chx_rb_idx_is_red(rb) __chx_rb_idx_is_red((rb)->__rb_parent_color)
+#define chx_rb_idx_is_black(rb) __chx_rb_idx_is_black((rb)->__rb_parent_color)
+
+static inline void chx_rb_idx_set_parent(struct chx_rb_idx_node* rb,
+                                         uint32_t p) {
+    rb->__rb_parent_color = chx_rb_idx_color(rb) | p << 1;
+}
+
+static inline void chx_rb_idx_set_parent_color(struct chx_rb_idx_node* rb,
+                                               uint32_t p, int color) {
+    rb->__rb_parent_color = p << 1 | color;
+}
+
+/*
+ * Template for declaring augmented index rbtree callbacks (generic case)
+ *
+ * RBSTATIC:    'static' or empty
+ * RBNAME:      name of the chx_rb_idx_augment_callbacks structure
+ * RBSTRUCT:    struct type of the arena elements
+ * RBFIELD:     name of struct chx_rb_idx_node field within RBSTRUCT
+ * RBAUGMENTED: name of field within RBSTRUCT holding data for subtree
+ * RBCOMPUTE:   name of function that recomputes the RBAUGMENTED data, called
+ *              as RBCOMPUTE(arena, node, exit)
+ */
+
+#define CHX_RB_IDX_DECLARE_CALLBACKS(RBSTATIC, RBNAME, RBSTRUCT, RBFIELD,      \
+                                     RBAUGMENTED, RBCOMPUTE)                   \
+    static inline void RBNAME##_propagate(                                     \
+        const struct chx_rb_idx_arena* arena, uint32_t rb, uint32_t stop) {    \
+        while (rb != stop) {                                                   \
+            RBSTRUCT* node = chx_rb_idx_entry(arena, rb, RBSTRUCT);            \
+            if (RBCOMPUTE(arena, node, true))                                  \
+                break;                                                         \
+            rb = chx_rb_idx_parent(&node->RBFIELD);                            \
+        }                                                                      \
+    }                                                                          \
+    static inline void RBNAME##_copy(const struct chx_rb_idx_arena* arena,     \
+                                     uint32_t rb_old, uint32_t rb_new) {       \
+        RBSTRUCT* old = chx_rb_idx_entry(arena, rb_old, RBSTRUCT);             \
+        RBSTRUCT* new = chx_rb_idx_entry(arena, rb_new, RBSTRUCT);             \
+        new->RBAUGMENTED = old->RBAUGMENTED;                                   \
+    }                                                                          \
+    static void RBNAME##_rotate(const struct chx_rb_idx_arena* arena,          \
+                                uint32_t rb_old, uint32_t rb_new) {            \
+        RBSTRUCT* old = chx_rb_idx_entry(arena, rb_old, RBSTRUCT);             \
+        RBSTRUCT* new = chx_rb_idx_entry(arena, rb_new, RBSTRUCT);             \
+        new->RBAUGMENTED = old->RBAUGMENTED;                                   \
+        RBCOMPUTE(arena, old, false);                                          \
+    }                                                                          \
+    RBSTATIC const struct chx_rb_idx_augment_callbacks RBNAME = {              \
+        .propagate = RBNAME##_propagate,                                       \
+        .copy = RBNAME##_copy,                                                 \
+        .rotate = RBNAME##_rotate};
+
+/*
+ * Template for declaring augmented index rbtree callbacks,
+ * computing RBAUGMENTED scalar as max(RBCOMPUTE(node)) for all subtree nodes.
+ *
+ * RBSTATIC:    'static' or empty
+ * RBNAME:      name of the chx_rb_idx_augment_callbacks structure
+ * RBSTRUCT:    struct type of the arena elements
+ * RBFIELD:     name of struct chx_rb_idx_node field within RBSTRUCT
+ * RBTYPE:      type of the RBAUGMENTED field
+ * RBAUGMENTED: name of RBTYPE field within RBSTRUCT holding data for subtree
+ * RBCOMPUTE:   name of function that returns the per-node RBTYPE scalar
+ */
+
+#define CHX_RB_IDX_DECLARE_CALLBACKS_MAX(RBSTATIC, RBNAME, RBSTRUCT, RBFIELD,  \
+                                         RBTYPE, RBAUGMENTED, RBCOMPUTE)       \
+    static inline bool RBNAME##_compute_max(                                   \
+        const struct chx_rb_idx_arena* arena, RBSTRUCT* node, bool exit) {     \
+        RBSTRUCT* child;                                                       \
+        RBTYPE max = RBCOMPUTE(node);                                          \
+        if (node->RBFIELD.rb_left) {                                           \
+            child = chx_rb_idx_entry(arena, node->RBFIELD.rb_left, RBSTRUCT);  \
+            if (child->RBAUGMENTED > max)                                      \
+                max = child->RBAUGMENTED;                                      \
+        }                                                                      \
+        if (node->RBFIELD.rb_right) {                                          \
+            child = chx_rb_idx_entry(arena, node->RBFIELD.rb_right, RBSTRUCT); \
+            if (child->RBAUGMENTED > max)                                      \
+                max = child->RBAUGMENTED;                                      \
+        }                                                                      \
+        if (exit && node->RBAUGMENTED == max)                                  \
+            return true;                                                       \
+        node->RBAUGMENTED = max;                                               \
+        return false;                                                          \
+    }                                                                          \
+    CHX_RB_IDX_DECLARE_CALLBACKS(RBSTATIC, RBNAME, RBSTRUCT, RBFIELD,          \
+                                 RBAUGMENTED, RBNAME##_compute_max)
+
+extern void __chx_rb_idx_erase_color(
+    uint32_t parent, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    void (*augment_rotate)(const struct chx_rb_idx_arena* arena, uint32_t old,
+                           uint32_t new_node));
+
+extern uint32_t __chx_rb_idx_erase_augmented(
+    uint32_t node, struct chx_rb_idx_root* root,
+    const struct chx_rb_idx_arena* arena,
+    const struct chx_rb_idx_augment_callbacks* augment);
+
+static inline void
+chx_rb_idx_erase_augmented(uint32_t node, struct chx_rb_idx_root* root,
+                           const struct chx_rb_idx_arena* arena,
+                           const struct chx_rb_idx_augment_callbacks* augment) {
+    uint32_t rebalance =
+        __chx_rb_idx_erase_augmented(node, root, arena, augment);
+    if (rebalance)
+        __chx_rb_idx_erase_color(rebalance, root, arena, augment->rotate);
+}
+
+static inline void chx_rb_idx_erase_augmented_cached(
+    uint32_t node, struct chx_rb_idx_root_cached* root,
+    const struct chx_rb_idx_arena* arena,
+    const struct chx_rb_idx_augment_callbacks* augment) {
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = chx_rb_idx_next(node, arena);
+    chx_rb_idx_erase_augmented(node, &root->rb_root, arena, augment);
+}
@@ -0,0 +1,230 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Latched RB-trees
+ *
+ * Copyright (C) 2015 Intel Corp., Peter Zijlstra <peterz@infradead.org>
+ *
+ * linux/include/linux/rbtree_latch.h
+ *
+ * Since RB-trees have non-atomic modifications they're not immediately suited
+ * for RCU/lockless queries. Even though we made chx_rb_erase() and
+ * chx_rb_insert_color() safe against concurrent lookups (they only ever see
+ * valid elements and never loop), a lookup can still miss entire subtrees
+ * while a rotation is in flight.
+ *
+ * The latch technique (a sequence counter plus two copies of the data
+ * structure) makes those lookups exact: writers modify one copy while
+ * readers are directed at the other, and readers retry whenever the
+ * sequence moved underneath them. Lookups therefore never block and never
+ * return a false negative.
+ *
+ * The costs are that every element carries two chx_rb_node's and that
+ * writers are twice as expensive. It is intended for read-mostly trees.
+ *
+ * Writers must serialize among themselves (a lock, or a single writer
+ * thread). Readers need no lock, but an erased element may still be visited
+ * by a reader that has not yet noticed the sequence change, so its memory
+ * must not be reused until all readers that could observe it are gone
+ * (RCU style deferred free).
+ */
+
+#pragma once
+
+#include "rbtree.h"
+
+struct chx_latch_tree_node {
+    struct chx_rb_node node[2];
+};
+
+struct chx_latch_tree_root {
+    unsigned int seq;
+    struct chx_rb_root tree[2];
+};
+
+#define CHX_LATCH_TREE_ROOT                                                    \
+    (struct chx_latch_tree_root) {                                             \
+        0, { CHX_RB_ROOT, CHX_RB_ROOT }                                        \
+    }
+
+/**
+ * struct chx_latch_tree_ops - operators to define the tree order
+ * @less: used for insertion; provides the (partial) order between two
+ *        elements.
+ * @comp: used for lookups; provides the order between the search key and an
+ *        element.
+ *
+ * The operators are related like:
+ *
+ *	comp(a->key,b) < 0  := less(a,b)
+ *	comp(a->key,b) > 0  := less(b,a)
+ *	comp(a->key,b) == 0 := !less(a,b) && !less(b,a)
+ *
+ * If these operators define a partial order on the elements we make no
+ * guarantee on which of the elements matching the key is found. See
+ * chx_latch_tree_find().
+ */
+struct chx_latch_tree_ops {
+    bool (*less)(struct chx_latch_tree_node* a, struct chx_latch_tree_node* b);
+    int (*comp)(const void* key, struct chx_latch_tree_node* b);
+};
+
+/*
+ * Sequence counter latch: bumping the sequence flips the readers over to
+ * the other copy. The fences order the bump against the tree stores on
+ * either side of it, like the kernel's raw_write_seqcount_latch().
+ */
+static inline void __chx_lt_write_latch(struct chx_latch_tree_root* root) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&root->seq, root->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline unsigned int
+__chx_lt_read_latch(const struct chx_latch_tree_root* root) {
+    return __atomic_load_n(&root->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline bool __chx_lt_read_retry(const struct chx_latch_tree_root* root,
+                                       unsigned int seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&root->seq, __ATOMIC_RELAXED) != seq;
+}
+
+static inline struct chx_latch_tree_node*
+__chx_lt_from_rb(struct chx_rb_node* node, int idx) {
+    return container_of(node, struct chx_latch_tree_node, node[idx]);
+}
+
+static inline void
+__chx_lt_insert(struct chx_latch_tree_node* ltn,
+                struct chx_latch_tree_root* ltr, int idx,
+                bool (*less)(struct chx_latch_tree_node* a,
+                             struct chx_latch_tree_node* b)) {
+    struct chx_rb_root* root = &ltr->tree[idx];
+    struct chx_rb_node** link = &root->rb_node;
+    struct chx_rb_node* node = &ltn->node[idx];
+    struct chx_rb_node* parent = NULL;
+    struct chx_latch_tree_node* ltp;
+
+    while (*link) {
+        parent = *link;
+        ltp = __chx_lt_from_rb(parent, idx);
+
+        if (less(ltn, ltp))
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    chx_rb_link_node_rcu(node, parent, link);
+    chx_rb_insert_color(node, root);
+}
+
+static inline void __chx_lt_erase(struct chx_latch_tree_node* ltn,
+                                  struct chx_latch_tree_root* ltr, int idx) {
+    chx_rb_erase(&ltn->node[idx], &ltr->tree[idx]);
+}
+
+static inline struct chx_latch_tree_node*
+__chx_lt_find(const void* key, struct chx_latch_tree_root* ltr, int idx,
+              int (*comp)(const void* key, struct chx_latch_tree_node* node)) {
+    struct chx_rb_node* node =
+        chx_rcu_dereference(ltr->tree[idx].rb_node);
+    struct chx_latch_tree_node* ltn;
+    int c;
+
+    while (node) {
+        ltn = __chx_lt_from_rb(node, idx);
+        c = comp(key, ltn);
+
+        if (c < 0)
+            node = chx_rcu_dereference(node->rb_left);
+        else if (c > 0)
+            node = chx_rcu_dereference(node->rb_right);
+        else
+            return ltn;
+    }
+
+    return NULL;
+}
+
+/**
+ * chx_latch_tree_insert() - insert @node into the trees @root
+ * @node: nodes to insert
+ * @root: trees to insert @node into
+ * @ops: operators defining the node order
+ *
+ * It inserts @node into @root in an ordered fashion such that we can always
+ * observe one complete tree. See the comment for raw_write_seqcount_latch()
+ * in the kernel.
+ *
+ * The inserts use chx_rb_link_node_rcu() so that concurrent lookups see
+ * fully initialized elements.
+ *
+ * All modifications (chx_latch_tree_insert, chx_latch_tree_erase) are
+ * assumed to be serialized.
+ */
+static inline void
+chx_latch_tree_insert(struct chx_latch_tree_node* node,
+                      struct chx_latch_tree_root* root,
+                      const struct chx_latch_tree_ops* ops) {
+    __chx_lt_write_latch(root);
+    __chx_lt_insert(node, root, 0, ops->less);
+    __chx_lt_write_latch(root);
+    __chx_lt_insert(node, root, 1, ops->less);
+}
+
+/**
+ * chx_latch_tree_erase() - removes @node from the trees @root
+ * @node: nodes to remove
+ * @root: trees to remove @node from
+ * @ops: operators defining the node order
+ *
+ * Removes @node from the trees @root in an ordered fashion such that we can
+ * always observe one complete tree.
+ *
+ * It is assumed that @node will observe one RCU-style quiescent state before
+ * being reused or freed.
+ *
+ * All modifications (chx_latch_tree_insert, chx_latch_tree_erase) are
+ * assumed to be serialized.
+ */
+static inline void
+chx_latch_tree_erase(struct chx_latch_tree_node* node,
+                     struct chx_latch_tree_root* root,
+                     const struct chx_latch_tree_ops* ops
+                     __attribute__((unused))) {
+    __chx_lt_write_latch(root);
+    __chx_lt_erase(node, root, 0);
+    __chx_lt_write_latch(root);
+    __chx_lt_erase(node, root, 1);
+}
+
+/**
+ * chx_latch_tree_find() - find the node matching @key in the trees @root
+ * @key: search key
+ * @root: trees to search for @key
+ * @ops: operators defining the node order
+ *
+ * Does a lockless lookup in the trees @root for the node matching @key.
+ *
+ * Unlike chx_rb_find_rcu() the result is exact: a descent that raced with a
+ * modification of the tree it walked is simply retried on the other copy, so
+ * a NULL return really means @key was not present at some point during the
+ * call. The lookup never waits for a writer.
+ *
+ * Returns: a pointer to the node matching @key or NULL.
+ */
+static inline struct chx_latch_tree_node*
+chx_latch_tree_find(const void* key, struct chx_latch_tree_root* root,
+                    const struct chx_latch_tree_ops* ops) {
+    struct chx_latch_tree_node* node;
+    unsigned int seq;
+
+    do {
+        seq = __chx_lt_read_latch(root);
+        node = __chx_lt_find(key, root, seq & 1, ops->comp);
+    } while (__chx_lt_read_retry(root, seq));
+
+    return node;
+}
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Writing and mapping tree files.
+ *
+ * The writer sizes a temporary file, maps it and fills the records in place
+ * with one in-order walk: a node's rank is its record index, and each call
+ * returns the rank of the subtree root so the parent can link it both ways.
+ */
+
+#include "rbtree_mmap.h"
+#include "rbtree_augmented.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct chx_rb_map_writer {
+    char* records;
+    size_t stride;
+    size_t next; /* rank of the next node */
+    void (*data)(void* dst, const struct chx_rb_node* node);
+};
+
+static struct chx_rb_map_node* chx_rb_map_record(struct chx_rb_map_writer* w,
+                                                 size_t rank) {
+    return (struct chx_rb_map_node*)(w->records + rank * w->stride);
+}
+
+/* Offset from record @from to record @to */
+static int64_t chx_rb_map_offset(struct chx_rb_map_writer* w, size_t from,
+                                 size_t to) {
+    return ((int64_t)to - (int64_t)from) * (int64_t)w->stride;
+}
+
+/* Store the subtree at @node, returning the rank of its root */
+static size_t chx_rb_map_store(struct chx_rb_map_writer* w,
+                               const struct chx_rb_node* node) {
+    struct chx_rb_map_node* rec;
+    size_t left = 0, right = 0, rank;
+
+    if (node->rb_left)
+        left = chx_rb_map_store(w, node->rb_left);
+    rank = w->next++;
+    rec = chx_rb_map_record(w, rank);
+    rec->__rb_parent_color = chx_rb_color(node);
+    rec->rb_left = 0;
+    rec->rb_right = 0;
+    w->data(rec + 1, node);
+    if (node->rb_left) {
+        rec->rb_left = chx_rb_map_offset(w, rank, left);
+        chx_rb_map_record(w, left)->__rb_parent_color |=
+            chx_rb_map_offset(w, left, rank);
+    }
+    if (node->rb_right) {
+        right = chx_rb_map_store(w, node->rb_right);
+        rec->rb_right = chx_rb_map_offset(w, rank, right);
+        chx_rb_map_record(w, right)->__rb_parent_color |=
+            chx_rb_map_offset(w, right, rank);
+    }
+    return rank;
+}
+
+/* Make a rename into the directory of @path durable */
+static bool chx_rb_map_sync_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* dir;
+    int fd, err;
+    bool ok;
+
+    if (!slash)
+        dir = strdup(".");
+    else if (slash == path)
+        dir = strdup("/");
+    else
+        dir = strndup(path, slash - path);
+    if (!dir)
+        return false;
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    err = errno;
+    free(dir);
+    if (fd < 0) {
+        errno = err;
+        return false;
+    }
+    ok = !fsync(fd);
+    err = errno;
+    close(fd);
+    errno = err;
+    return ok;
+}
+
+bool chx_rb_map_write(const struct chx_rb_root* root, const char* path,
+                      size_t data_size,
+                      void (*data)(void* dst, const struct chx_rb_node* node)) {
+    struct chx_rb_map_writer w = {.data = data};
+    struct chx_rb_map_header* hdr;
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+    size_t count = 0, size;
+    char* tmp;
+    void* base;
+    int fd, err;
+    bool ok;
+
+    chx_rb_iter_for_each(node, &iter, root)
+        count++;
+    w.stride = (sizeof(struct chx_rb_map_node) + data_size + 7) / 8 * 8;
+    size = CHX_RB_MAP_RECORDS + count * w.stride;
+
+    tmp = malloc(strlen(path) + sizeof(".XXXXXX"));
+    if (!tmp)
+        return false;
+    sprintf(tmp, "%s.XXXXXX", path);
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+    if (fchmod(fd, 0644) || ftruncate(fd, size) ||
+        (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) ==
+            MAP_FAILED)
+        goto fail;
+
+    hdr = base;
+    memcpy(hdr->magic, CHX_RB_MAP_MAGIC, sizeof(hdr->magic));
+    hdr->version = CHX_RB_MAP_VERSION;
+    hdr->byte_order = CHX_RB_MAP_BYTE_ORDER;
+    hdr->data_size = data_size;
+    hdr->stride = w.stride;
+    hdr->count = count;
+    hdr->root = 0;
+    w.records = (char*)base + CHX_RB_MAP_RECORDS;
+    if (root->rb_node)
+        hdr->root = CHX_RB_MAP_RECORDS +
+                    chx_rb_map_store(&w, root->rb_node) * w.stride;
+
+    /* The records must be on disk before the name points at them */
+    ok = !msync(base, size, MS_SYNC);
+    ok = !munmap(base, size) && ok;
+    ok = !close(fd) && ok;
+    fd = -1;
+    if (!ok || rename(tmp, path) || !chx_rb_map_sync_dir(path))
+        goto fail;
+    free(tmp);
+    return true;
+
+fail:
+    err = errno;
+    if (fd >= 0)
+        close(fd);
+    unlink(tmp);
+    free(tmp);
+    errno = err;
+    return false;
+}
+
+bool chx_rb_map_open(struct chx_rb_map* map, const char* path) {
+    const struct chx_rb_map_header* hdr;
+    struct stat st;
+    void* base;
+    int fd, err;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st)) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return false;
+    }
+    if ((size_t)st.st_size < CHX_RB_MAP_RECORDS) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        errno = err;
+        return false;
+    }
+
+    hdr = base;
+    if (memcmp(hdr->magic, CHX_RB_MAP_MAGIC, sizeof(hdr->magic)) ||
+        hdr->version != CHX_RB_MAP_VERSION ||
+        hdr->byte_order != CHX_RB_MAP_BYTE_ORDER ||
+        hdr->stride < sizeof(struct chx_rb_map_node) + hdr->data_size ||
+        hdr->stride % 8 ||
+        hdr->count > (st.st_size - CHX_RB_MAP_RECORDS) / hdr->stride ||
+        (hdr->root && (hdr->root < CHX_RB_MAP_RECORDS ||
+                       hdr->root >= CHX_RB_MAP_RECORDS +
+                                        hdr->count * hdr->stride ||
+                       (hdr->root - CHX_RB_MAP_RECORDS) % hdr->stride))) {
+        munmap(base, st.st_size);
+        errno = EINVAL;
+        return false;
+    }
+    map->base = base;
+    map->size = st.st_size;
+    return true;
+}
+
+void chx_rb_map_close(struct chx_rb_map* map) {
+    munmap((void*)map->base, map->size);
+    map->base = NULL;
+    map->size = 0;
+}
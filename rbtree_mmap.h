@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Memory mappable tree files.
+ *
+ * chx_rb_map_write() stores a tree as a header followed by one fixed size
+ * record per node, in order. A record starts with a struct chx_rb_map_node,
+ * laid out like struct chx_rb_node but holding byte offsets relative to the
+ * record itself instead of pointers (0 for none, the color in the low bit
+ * of the parent word), followed by the node's data as written by a caller
+ * supplied function, aligned to 8 bytes.
+ *
+ * chx_rb_map_open() maps such a file read-only and the lookups below walk
+ * the mapping directly, so loading costs one mmap() and the page cache
+ * rather than a rebuild, and processes mapping the same file share its
+ * pages. Being offsets, the links do not depend on where the file lands.
+ * Files use the byte order of the writer, which chx_rb_map_open() checks
+ * along with the header; the links inside records are trusted.
+ *
+ * Functions returning bool report failure with false and errno set.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+#include <stdint.h>
+
+#define CHX_RB_MAP_MAGIC "CHXRBMAP"
+#define CHX_RB_MAP_VERSION 1
+#define CHX_RB_MAP_BYTE_ORDER 0x01020304u
+/* Offset of the first record */
+#define CHX_RB_MAP_RECORDS 64
+
+struct chx_rb_map_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t data_size;
+    uint64_t stride; /* bytes per record */
+    uint64_t count;
+    uint64_t root; /* file offset of the root record, 0 if empty */
+};
+
+struct chx_rb_map_node {
+    int64_t __rb_parent_color;
+    int64_t rb_right;
+    int64_t rb_left;
+};
+
+struct chx_rb_map {
+    const char* base;
+    size_t size;
+};
+
+/*
+ * Write @root to @path, with @data_size bytes per node written by
+ * @data(dst, node). The file, mode 0644, is built next to @path, synced,
+ * and renamed over it, so existing mappings of an older file stay valid and
+ * after a crash @path holds either the old file or the complete new one.
+ */
+extern bool chx_rb_map_write(const struct chx_rb_root* root, const char* path,
+                             size_t data_size,
+                             void (*data)(void* dst,
+                                          const struct chx_rb_node* node));
+extern bool chx_rb_map_open(struct chx_rb_map* map, const char* path);
+extern void chx_rb_map_close(struct chx_rb_map* map);
+
+static inline const struct chx_rb_map_header*
+chx_rb_map_header(const struct chx_rb_map* map) {
+    return (const struct chx_rb_map_header*)map->base;
+}
+
+/* The record @off bytes from @node, NULL for offset 0 */
+static inline const struct chx_rb_map_node*
+__chx_rb_map_link(const struct chx_rb_map_node* node, int64_t off) {
+    return off ? (const struct chx_rb_map_node*)((const char*)node + off)
+               : NULL;
+}
+
+#define chx_rb_map_left(node) __chx_rb_map_link(node, (node)->rb_left)
+#define chx_rb_map_right(node) __chx_rb_map_link(node, (node)->rb_right)
+#define chx_rb_map_parent(node)                                                \
+    __chx_rb_map_link(node, (node)->__rb_parent_color & ~(int64_t)1)
+
+/* The data stored with @node */
+static inline const void* chx_rb_map_data(const struct chx_rb_map_node* node) {
+    return node + 1;
+}
+
+static inline size_t chx_rb_map_count(const struct chx_rb_map* map) {
+    return chx_rb_map_header(map)->count;
+}
+
+static inline const struct chx_rb_map_node*
+chx_rb_map_root(const struct chx_rb_map* map) {
+    uint64_t root = chx_rb_map_header(map)->root;
+
+    return root ? (const struct chx_rb_map_node*)(map->base + root) : NULL;
+}
+
+/* Records are in order, so iteration is a linear scan */
+static inline const struct chx_rb_map_node*
+chx_rb_map_first(const struct chx_rb_map* map) {
+    return chx_rb_map_count(map)
+               ? (const struct chx_rb_map_node*)(map->base + CHX_RB_MAP_RECORDS)
+               : NULL;
+}
+
+static inline const struct chx_rb_map_node*
+chx_rb_map_next(const struct chx_rb_map* map,
+                const struct chx_rb_map_node* node) {
+    const struct chx_rb_map_header* hdr = chx_rb_map_header(map);
+    const char* next = (const char*)node + hdr->stride;
+
+    return next < map->base + CHX_RB_MAP_RECORDS + hdr->count * hdr->stride
+               ? (const struct chx_rb_map_node*)next
+               : NULL;
+}
+
+#define chx_rb_map_for_each(node, map)                                         \
+    for ((node) = chx_rb_map_first(map); (node);                               \
+         (node) = chx_rb_map_next(map, node))
+
+/**
+ * chx_rb_map_find() - find a record matching @key
+ * @map: mapped tree
+ * @key: key to search for
+ * @cmp: comparator of @key against the data of a record, <0, 0 or >0
+ *
+ * Returns the record matching @key or NULL.
+ */
+static inline const struct chx_rb_map_node*
+chx_rb_map_find(const struct chx_rb_map* map, const void* key,
+                int (*cmp)(const void* key, const void* data)) {
+    const struct chx_rb_map_node* node = chx_rb_map_root(map);
+
+    while (node) {
+        int c = cmp(key, chx_rb_map_data(node));
+
+        if (c == 0)
+            return node;
+        node = c < 0 ? chx_rb_map_left(node) : chx_rb_map_right(node);
+    }
+    return NULL;
+}
+
+/* The first record not ordered before @key, or NULL */
+static inline const struct chx_rb_map_node*
+chx_rb_map_lower_bound(const struct chx_rb_map* map, const void* key,
+                       int (*cmp)(const void* key, const void* data)) {
+    const struct chx_rb_map_node *node = chx_rb_map_root(map), *match = NULL;
+
+    while (node) {
+        if (cmp(key, chx_rb_map_data(node)) <= 0) {
+            match = node;
+            node = chx_rb_map_left(node);
+        } else {
+            node = chx_rb_map_right(node);
+        }
+    }
+    return match;
+}
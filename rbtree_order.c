@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Order statistic rbtrees, see rbtree_order.h
+ */
+
+#include "rbtree_order.h"
+
+static inline bool chx_rb_os_compute(struct chx_rb_os_node* node, bool exit) {
+    size_t size = 1 + chx_rb_os_size(node->rb.rb_left) +
+                  chx_rb_os_size(node->rb.rb_right);
+
+    if (exit && node->size == size)
+        return true;
+    node->size = size;
+    return false;
+}
+
+CHX_RB_DECLARE_CALLBACKS(, chx_rb_os_callbacks, struct chx_rb_os_node, rb,
+                         size, chx_rb_os_compute)
+
+struct chx_rb_os_node* chx_rb_os_select(const struct chx_rb_root* root,
+                                        size_t k) {
+    struct chx_rb_node* rb = root->rb_node;
+
+    while (rb) {
+        size_t left = chx_rb_os_size(rb->rb_left);
+
+        if (k < left) {
+            rb = rb->rb_left;
+        } else if (k > left) {
+            k -= left + 1;
+            rb = rb->rb_right;
+        } else {
+            return chx_rb_os_entry(rb);
+        }
+    }
+
+    return NULL;
+}
+
+size_t chx_rb_os_rank(const struct chx_rb_os_node* node) {
+    const struct chx_rb_node* rb = &node->rb;
+    const struct chx_rb_node* parent;
+    size_t rank = chx_rb_os_size(rb->rb_left);
+
+    /* Every time we come up from a right child, the parent and its left
+     * subtree are ordered before us */
+    while ((parent = chx_rb_parent(rb))) {
+        if (rb == parent->rb_right)
+            rank += chx_rb_os_size(parent->rb_left) + 1;
+        rb = parent;
+    }
+
+    return rank;
+}
+
+size_t
+chx_rb_os_count_less(const void* key, const struct chx_rb_root* root,
+                     int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    struct chx_rb_node* rb = root->rb_node;
+    size_t count = 0;
+
+    while (rb) {
+        if (cmp(key, rb) > 0) {
+            count += chx_rb_os_size(rb->rb_left) + 1;
+            rb = rb->rb_right;
+        } else {
+            rb = rb->rb_left;
+        }
+    }
+
+    return count;
+}
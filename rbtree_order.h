@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Order statistic rbtrees
+ *
+ * An augmented rbtree where every node records the size of its subtree,
+ * which turns positional queries into O(log n) descents:
+ *
+ *  chx_rb_os_select(root, k)          - the k-th smallest node (0-based)
+ *  chx_rb_os_rank(node)               - number of nodes before @node
+ *  chx_rb_os_count_range(root, lo, hi) - number of nodes in [lo, hi)
+ *
+ * Embed a struct chx_rb_os_node in the element and use the chx_rb_os_*
+ * insert and erase helpers instead of chx_rb_add()/chx_rb_erase(), so the
+ * subtree sizes are kept up to date. The comparators are handed the
+ * embedded struct chx_rb_node, exactly as for chx_rb_add()/chx_rb_find().
+ */
+
+#pragma once
+
+#include "rbtree_augmented.h"
+
+struct chx_rb_os_node {
+    struct chx_rb_node rb;
+    size_t size; /* number of nodes in the subtree rooted here */
+};
+
+#define chx_rb_os_entry(ptr) chx_rb_entry(ptr, struct chx_rb_os_node, rb)
+
+extern const struct chx_rb_augment_callbacks chx_rb_os_callbacks;
+
+/* Subtree size of @rb, 0 for an empty subtree */
+static inline size_t chx_rb_os_size(const struct chx_rb_node* rb) {
+    return rb ? chx_rb_entry(rb, struct chx_rb_os_node, rb)->size : 0;
+}
+
+/* Number of nodes in the tree, O(1) */
+static inline size_t chx_rb_os_count(const struct chx_rb_root* root) {
+    return chx_rb_os_size(root->rb_node);
+}
+
+/**
+ * chx_rb_os_add() - insert @node into @tree
+ * @node: node to insert
+ * @tree: tree to insert @node into
+ * @less: operator defining the (partial) node order
+ */
+static inline void
+chx_rb_os_add(struct chx_rb_os_node* node, struct chx_rb_root* tree,
+              bool (*less)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node** link = &tree->rb_node;
+    struct chx_rb_node* parent = NULL;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        chx_rb_os_entry(parent)->size++;
+        if (less(&node->rb, parent))
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    node->size = 1;
+    chx_rb_link_node(&node->rb, parent, link);
+    chx_rb_insert_augmented(&node->rb, tree, &chx_rb_os_callbacks);
+}
+
+/**
+ * chx_rb_os_find_add() - find equivalent @node in @tree, or add @node
+ * @node: node to look-for / insert
+ * @tree: tree to search / modify
+ * @cmp: operator defining the node order
+ *
+ * Returns the chx_rb_node matching @node, or NULL when no match is found and
+ * @node is inserted.
+ */
+static inline struct chx_rb_node*
+chx_rb_os_find_add(struct chx_rb_os_node* node, struct chx_rb_root* tree,
+                   int (*cmp)(struct chx_rb_node*, const struct chx_rb_node*)) {
+    struct chx_rb_node** link = &tree->rb_node;
+    struct chx_rb_node *parent = NULL, *rb;
+    int c;
+
+    chx_rb_stat_inc(descents);
+    while (*link) {
+        parent = *link;
+        chx_rb_stat_inc(descent_steps);
+        c = cmp(&node->rb, parent);
+
+        if (c < 0)
+            link = &parent->rb_left;
+        else if (c > 0)
+            link = &parent->rb_right;
+        else
+            return parent;
+    }
+
+    /* Only account for @node once we know it is going in */
+    for (rb = parent; rb; rb = chx_rb_parent(rb))
+        chx_rb_os_entry(rb)->size++;
+
+    node->size = 1;
+    chx_rb_link_node(&node->rb, parent, link);
+    chx_rb_insert_augmented(&node->rb, tree, &chx_rb_os_callbacks);
+    return NULL;
+}
+
+static inline void chx_rb_os_erase(struct chx_rb_os_node* node,
+                                   struct chx_rb_root* tree) {
+    chx_rb_erase_augmented(&node->rb, tree, &chx_rb_os_callbacks);
+}
+
+extern struct chx_rb_os_node* chx_rb_os_select(const struct chx_rb_root* root,
+                                               size_t k);
+extern size_t chx_rb_os_rank(const struct chx_rb_os_node* node);
+
+/*
+ * Number of nodes ordered before @key, i.e. for which cmp(key, node) > 0.
+ * With chx_rb_os_select() this gives lower_bound by position.
+ */
+extern size_t
+chx_rb_os_count_less(const void* key, const struct chx_rb_root* root,
+                     int (*cmp)(const void* key, const struct chx_rb_node*));
+
+/* Number of nodes in [lo, hi) */
+static inline size_t
+chx_rb_os_count_range(const void* lo, const void* hi,
+                      const struct chx_rb_root* root,
+                      int (*cmp)(const void* key, const struct chx_rb_node*)) {
+    size_t a = chx_rb_os_count_less(lo, root, cmp);
+    size_t b = chx_rb_os_count_less(hi, root, cmp);
+
+    return b > a ? b - a : 0;
+}
+
+/* Parallel visits, see chx_rb_parallel_for_each(), split evenly by size */
+static inline void
+chx_rb_os_parallel_for_each(const struct chx_rb_root* root,
+                            void (*fn)(struct chx_rb_node* node, void* ctx),
+                            void* ctx, unsigned nthreads) {
+    __chx_rb_parallel_for_each(root, fn, ctx, chx_rb_os_size, nthreads);
+}
+
+static inline void chx_rb_os_parallel_reduce(
+    const struct chx_rb_root* root,
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx),
+    void (*combine)(void* acc, const void* right, void* ctx), void* acc,
+    size_t acc_size, void* ctx, unsigned nthreads) {
+    __chx_rb_parallel_reduce(root, fold, combine, acc, acc_size, ctx,
+                             chx_rb_os_size, nthreads);
+}
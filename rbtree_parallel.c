@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Parallel traversal and reduction.
+ *
+ * The top of the tree is cut into pieces in in-order sequence: whole
+ * subtrees, and the single nodes above them that separate those subtrees.
+ * Without sizes every subtree hanging CHX_RB_PARALLEL_CHUNKS * nthreads
+ * rounded up to a power of two levels down is a piece; with subtree sizes
+ * (order statistic trees) a subtree is cut further until it holds at most
+ * 1 / (CHX_RB_PARALLEL_CHUNKS * nthreads) of the nodes.
+ *
+ * The calling thread and nthreads - 1 helpers then claim pieces through a
+ * shared atomic counter, so a thread that drew small subtrees simply takes
+ * more of them. Each piece is walked in order with a struct chx_rb_iter.
+ *
+ * Pieces being in-order, the per piece accumulators of a reduction combine
+ * left to right into the in-order result, so the combine step needs to be
+ * associative but not commutative.
+ */
+
+#include "rbtree_augmented.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Pieces per thread, so uneven subtrees even out */
+#define CHX_RB_PARALLEL_CHUNKS 8
+/* Below this black height, a few thousand nodes, stay on one thread */
+#define CHX_RB_PARALLEL_MIN_BH 10
+/* More threads than this are not started, whatever the caller asks for */
+#define CHX_RB_PARALLEL_MAX_THREADS 256
+
+struct chx_rb_piece {
+    struct chx_rb_node* node;
+    bool whole; /* the subtree rooted at node, or just node */
+};
+
+struct chx_rb_parallel {
+    struct chx_rb_piece* pieces;
+    size_t npieces, cap;
+    size_t next;
+    void (*fn)(struct chx_rb_node* node, void* ctx);
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx);
+    char* accs;
+    size_t acc_size;
+    void* ctx;
+};
+
+static bool chx_rb_parallel_push(struct chx_rb_parallel* p,
+                                 struct chx_rb_node* node, bool whole) {
+    if (p->npieces == p->cap) {
+        size_t cap = p->cap ? p->cap * 2 : 64;
+        struct chx_rb_piece* pieces =
+            realloc(p->pieces, cap * sizeof(*pieces));
+
+        if (!pieces)
+            return false;
+        p->pieces = pieces;
+        p->cap = cap;
+    }
+    p->pieces[p->npieces++] = (struct chx_rb_piece){node, whole};
+    return true;
+}
+
+/* Cut @node into pieces, in order. Depth counts down to 0. */
+static bool chx_rb_parallel_cut(struct chx_rb_parallel* p,
+                                struct chx_rb_node* node, unsigned depth,
+                                size_t (*size)(const struct chx_rb_node*),
+                                size_t target) {
+    if (!node)
+        return true;
+    if (size ? size(node) <= target : !depth)
+        return chx_rb_parallel_push(p, node, true);
+    return chx_rb_parallel_cut(p, node->rb_left, depth - 1, size, target) &&
+           chx_rb_parallel_push(p, node, false) &&
+           chx_rb_parallel_cut(p, node->rb_right, depth - 1, size, target);
+}
+
+static void chx_rb_parallel_visit(struct chx_rb_parallel* p,
+                                  struct chx_rb_node* node, void* acc) {
+    if (p->fold)
+        p->fold(acc, node, p->ctx);
+    else
+        p->fn(node, p->ctx);
+}
+
+static void chx_rb_parallel_piece(struct chx_rb_parallel* p, size_t i) {
+    struct chx_rb_piece* piece = &p->pieces[i];
+    void* acc = p->accs ? p->accs + i * p->acc_size : NULL;
+    struct chx_rb_root sub = {piece->node};
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+
+    if (!piece->whole) {
+        chx_rb_parallel_visit(p, piece->node, acc);
+        return;
+    }
+    chx_rb_iter_for_each(node, &iter, &sub)
+        chx_rb_parallel_visit(p, node, acc);
+}
+
+static void* chx_rb_parallel_run(void* arg) {
+    struct chx_rb_parallel* p = arg;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) <
+           p->npieces)
+        chx_rb_parallel_piece(p, i);
+    return NULL;
+}
+
+/*
+ * Cut the tree and run the pieces on up to @nthreads threads, at most
+ * CHX_RB_PARALLEL_MAX_THREADS. Returns false, having done nothing, when the
+ * tree is too small or memory runs out; the caller then walks the tree
+ * itself.
+ */
+static bool chx_rb_parallel(struct chx_rb_parallel* p,
+                            const struct chx_rb_root* root,
+                            size_t (*size)(const struct chx_rb_node*),
+                            unsigned nthreads, const void* identity) {
+    pthread_t tids[CHX_RB_PARALLEL_MAX_THREADS - 1];
+    unsigned depth = 0, started = 0;
+    size_t chunks, target = 0;
+
+    if (nthreads > CHX_RB_PARALLEL_MAX_THREADS)
+        nthreads = CHX_RB_PARALLEL_MAX_THREADS;
+    chunks = (size_t)nthreads * CHX_RB_PARALLEL_CHUNKS;
+    if (nthreads < 2 ||
+        __chx_rb_black_height(root->rb_node) < CHX_RB_PARALLEL_MIN_BH)
+        return false;
+    while (((size_t)1 << depth) < chunks)
+        depth++;
+    if (size)
+        target = size(root->rb_node) / chunks;
+    if (!chx_rb_parallel_cut(p, root->rb_node, depth, size, target))
+        goto fail;
+    if (p->fold) {
+        p->accs = malloc(p->npieces * p->acc_size);
+        if (!p->accs)
+            goto fail;
+        for (size_t i = 0; i < p->npieces; i++)
+            memcpy(p->accs + i * p->acc_size, identity, p->acc_size);
+    }
+
+    for (; started < nthreads - 1; started++)
+        if (pthread_create(&tids[started], NULL, chx_rb_parallel_run, p))
+            break;
+    chx_rb_parallel_run(p);
+    for (unsigned t = 0; t < started; t++)
+        pthread_join(tids[t], NULL);
+    return true;
+
+fail:
+    free(p->pieces);
+    return false;
+}
+
+void __chx_rb_parallel_for_each(const struct chx_rb_root* root,
+                                void (*fn)(struct chx_rb_node* node, void* ctx),
+                                void* ctx,
+                                size_t (*size)(const struct chx_rb_node*),
+                                unsigned nthreads) {
+    struct chx_rb_parallel p = {.fn = fn, .ctx = ctx};
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+
+    if (chx_rb_parallel(&p, root, size, nthreads, NULL)) {
+        free(p.pieces);
+        return;
+    }
+    chx_rb_iter_for_each(node, &iter, root)
+        fn(node, ctx);
+}
+
+void __chx_rb_parallel_reduce(
+    const struct chx_rb_root* root,
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx),
+    void (*combine)(void* acc, const void* right, void* ctx), void* acc,
+    size_t acc_size, void* ctx, size_t (*size)(const struct chx_rb_node*),
+    unsigned nthreads) {
+    struct chx_rb_parallel p = {.fold = fold, .acc_size = acc_size,
+                                .ctx = ctx};
+    struct chx_rb_node* node;
+    struct chx_rb_iter iter;
+
+    if (chx_rb_parallel(&p, root, size, nthreads, acc)) {
+        for (size_t i = 0; i < p.npieces; i++)
+            combine(acc, p.accs + i * acc_size, ctx);
+        free(p.accs);
+        free(p.pieces);
+        return;
+    }
+    chx_rb_iter_for_each(node, &iter, root)
+        fold(acc, node, ctx);
+}
+
+void chx_rb_parallel_for_each(const struct chx_rb_root* root,
+                              void (*fn)(struct chx_rb_node* node, void* ctx),
+                              void* ctx, unsigned nthreads) {
+    __chx_rb_parallel_for_each(root, fn, ctx, NULL, nthreads);
+}
+
+void chx_rb_parallel_reduce(
+    const struct chx_rb_root* root,
+    void (*fold)(void* acc, struct chx_rb_node* node, void* ctx),
+    void (*combine)(void* acc, const void* right, void* ctx), void* acc,
+    size_t acc_size, void* ctx, unsigned nthreads) {
+    __chx_rb_parallel_reduce(root, fold, combine, acc, acc_size, ctx, NULL,
+                             nthreads);
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Slab pool for tree nodes.
+ *
+ * Slabs are CHX_RB_POOL_SLAB_SIZE bytes and belong to one size class. A new
+ * slab is only carved as far as a refill needs, so a class that hands out a
+ * handful of objects touches a handful of cache lines. Slabs are chained
+ * through a header at their start and only ever freed all together.
+ */
+
+#include "rbtree_pool.h"
+#include <stdlib.h>
+
+struct chx_rb_pool_slab {
+    struct chx_rb_pool_slab* next;
+} __attribute__((aligned(CHX_RB_POOL_ALIGN)));
+
+void chx_rb_pool_init(struct chx_rb_pool* pool) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->slabs = NULL;
+    for (unsigned c = 0; c < CHX_RB_POOL_CLASSES; c++) {
+        pool->free[c] = (struct chx_rb_pool_list){NULL, 0};
+        pool->cursor[c] = pool->end[c] = NULL;
+    }
+}
+
+void chx_rb_pool_destroy(struct chx_rb_pool* pool) {
+    struct chx_rb_pool_slab *slab, *next;
+
+    for (slab = pool->slabs; slab; slab = next) {
+        next = slab->next;
+        free(slab);
+    }
+    pthread_mutex_destroy(&pool->lock);
+}
+
+void chx_rb_pool_register(struct chx_rb_pool* pool,
+                          struct chx_rb_pool_mag* mag) {
+    mag->pool = pool;
+    for (unsigned c = 0; c < CHX_RB_POOL_CLASSES; c++)
+        mag->free[c] = (struct chx_rb_pool_list){NULL, 0};
+}
+
+/* Prepend the first @n objects of @from to @to. Called with the lock held. */
+static void chx_rb_pool_move(struct chx_rb_pool_list* from,
+                             struct chx_rb_pool_list* to, size_t n) {
+    struct chx_rb_pool_free *first = from->head, *last = first;
+
+    for (size_t i = 1; i < n; i++)
+        last = last->next;
+    from->head = last->next;
+    from->count -= n;
+    last->next = to->head;
+    to->head = first;
+    to->count += n;
+}
+
+void chx_rb_pool_unregister(struct chx_rb_pool_mag* mag) {
+    struct chx_rb_pool* pool = mag->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (unsigned c = 0; c < CHX_RB_POOL_CLASSES; c++)
+        if (mag->free[c].count)
+            chx_rb_pool_move(&mag->free[c], &pool->free[c],
+                             mag->free[c].count);
+    pthread_mutex_unlock(&pool->lock);
+    mag->pool = NULL;
+}
+
+/*
+ * Carve up to @n objects of class @cls off the newest slab, starting a new
+ * one if it is used up. Called with the lock held.
+ */
+static size_t chx_rb_pool_carve(struct chx_rb_pool* pool, unsigned cls,
+                                struct chx_rb_pool_list* to, size_t n) {
+    size_t size = (size_t)(cls + 1) * CHX_RB_POOL_ALIGN;
+    struct chx_rb_pool_slab* slab;
+    size_t i;
+
+    if (pool->cursor[cls] == pool->end[cls]) {
+        slab = aligned_alloc(CHX_RB_POOL_ALIGN, CHX_RB_POOL_SLAB_SIZE);
+        if (!slab)
+            return 0;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->cursor[cls] = (char*)(slab + 1);
+        pool->end[cls] = pool->cursor[cls] +
+                         (CHX_RB_POOL_SLAB_SIZE - sizeof(*slab)) / size * size;
+    }
+
+    for (i = 0; i < n && pool->cursor[cls] != pool->end[cls]; i++) {
+        struct chx_rb_pool_free* obj = (void*)pool->cursor[cls];
+
+        obj->next = to->head;
+        to->head = obj;
+        pool->cursor[cls] += size;
+    }
+    to->count += i;
+    return i;
+}
+
+void* __chx_rb_pool_refill(struct chx_rb_pool_mag* mag, unsigned cls) {
+    struct chx_rb_pool* pool = mag->pool;
+    struct chx_rb_pool_list* list = &mag->free[cls];
+    struct chx_rb_pool_free* obj;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free[cls].count) {
+        size_t n = pool->free[cls].count;
+
+        chx_rb_pool_move(&pool->free[cls], list,
+                         n < CHX_RB_POOL_BATCH ? n : CHX_RB_POOL_BATCH);
+    } else {
+        chx_rb_pool_carve(pool, cls, list, CHX_RB_POOL_BATCH);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    obj = list->head;
+    if (!obj)
+        return NULL;
+    list->head = obj->next;
+    list->count--;
+    return obj;
+}
+
+/* Keep the most recently freed, likely cached, half and give back the rest */
+void __chx_rb_pool_drain(struct chx_rb_pool_mag* mag, unsigned cls) {
+    struct chx_rb_pool* pool = mag->pool;
+    struct chx_rb_pool_list* list = &mag->free[cls];
+    struct chx_rb_pool_free* last = list->head;
+    struct chx_rb_pool_list tail;
+
+    for (size_t i = 1; i < CHX_RB_POOL_BATCH; i++)
+        last = last->next;
+    tail = (struct chx_rb_pool_list){last->next,
+                                     list->count - CHX_RB_POOL_BATCH};
+    last->next = NULL;
+    list->count = CHX_RB_POOL_BATCH;
+
+    pthread_mutex_lock(&pool->lock);
+    chx_rb_pool_move(&tail, &pool->free[cls], tail.count);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Slab pool for tree nodes.
+ *
+ * A pool hands out small fixed size objects, typically user structs that
+ * embed a struct chx_rb_node, carved from large slabs. Sizes are rounded up
+ * to a multiple of CHX_RB_POOL_ALIGN and each size class has its own free
+ * list, so one pool can serve several node types.
+ *
+ * Each thread allocates and frees through its own registered magazine, a
+ * per size class free list that needs no locking. Only refilling an empty
+ * magazine or draining a full one takes the pool lock, CHX_RB_POOL_BATCH
+ * objects at a time. Objects may be freed through a different magazine than
+ * the one they were allocated from.
+ *
+ * chx_rb_pool_destroy() releases every slab at once, so a tree whose nodes
+ * all came from the pool is dropped without erasing or freeing its nodes one
+ * by one. Trees with nodes from elsewhere can use chx_rb_destroy() instead.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define CHX_RB_POOL_ALIGN 16
+#define CHX_RB_POOL_CLASSES 16
+/* Largest object a pool hands out */
+#define CHX_RB_POOL_MAX_SIZE (CHX_RB_POOL_ALIGN * CHX_RB_POOL_CLASSES)
+#define CHX_RB_POOL_SLAB_SIZE (64 * 1024)
+/* Objects moved between a magazine and its pool at a time */
+#define CHX_RB_POOL_BATCH 32
+/* Magazine size at which half of it goes back to the pool */
+#define CHX_RB_POOL_MAG_SIZE (2 * CHX_RB_POOL_BATCH)
+
+#define CHX_RB_POOL_CACHELINE 64
+
+struct chx_rb_pool_slab;
+
+/* Free objects are linked through their first word */
+struct chx_rb_pool_free {
+    struct chx_rb_pool_free* next;
+};
+
+struct chx_rb_pool_list {
+    struct chx_rb_pool_free* head;
+    size_t count;
+};
+
+struct chx_rb_pool {
+    pthread_mutex_t lock;
+    struct chx_rb_pool_slab* slabs;
+    struct chx_rb_pool_list free[CHX_RB_POOL_CLASSES];
+    /* unused tail of the newest slab of each class */
+    char* cursor[CHX_RB_POOL_CLASSES];
+    char* end[CHX_RB_POOL_CLASSES];
+};
+
+struct chx_rb_pool_mag {
+    struct chx_rb_pool* pool;
+    struct chx_rb_pool_list free[CHX_RB_POOL_CLASSES];
+} __attribute__((aligned(CHX_RB_POOL_CACHELINE)));
+
+extern void chx_rb_pool_init(struct chx_rb_pool* pool);
+/*
+ * Free every slab of @pool, and with them every object ever allocated from
+ * it and the contents of all registered magazines. Magazines need not be
+ * unregistered first, but must not be used again until registered anew.
+ */
+extern void chx_rb_pool_destroy(struct chx_rb_pool* pool);
+
+/* Each thread allocates and frees through its own magazine */
+extern void chx_rb_pool_register(struct chx_rb_pool* pool,
+                                 struct chx_rb_pool_mag* mag);
+/* Give the objects cached in @mag back to its pool */
+extern void chx_rb_pool_unregister(struct chx_rb_pool_mag* mag);
+
+extern void* __chx_rb_pool_refill(struct chx_rb_pool_mag* mag, unsigned cls);
+extern void __chx_rb_pool_drain(struct chx_rb_pool_mag* mag, unsigned cls);
+
+static inline unsigned chx_rb_pool_class(size_t size) {
+    return (unsigned)((size - 1) / CHX_RB_POOL_ALIGN);
+}
+
+/**
+ * chx_rb_pool_alloc() - allocate an object from a pool
+ * @mag: the calling thread's registered magazine
+ * @size: object size, 1 to CHX_RB_POOL_MAX_SIZE bytes
+ *
+ * Returns an object aligned to CHX_RB_POOL_ALIGN, or NULL when out of memory
+ * or @size is out of range.
+ */
+static inline void* chx_rb_pool_alloc(struct chx_rb_pool_mag* mag,
+                                      size_t size) {
+    unsigned cls = chx_rb_pool_class(size);
+    struct chx_rb_pool_list* list;
+    struct chx_rb_pool_free* obj;
+
+    if (!size || size > CHX_RB_POOL_MAX_SIZE)
+        return NULL;
+    list = &mag->free[cls];
+    obj = list->head;
+    if (!obj)
+        return __chx_rb_pool_refill(mag, cls);
+    list->head = obj->next;
+    list->count--;
+    return obj;
+}
+
+/**
+ * chx_rb_pool_free() - give an object back to a pool
+ * @mag: the calling thread's registered magazine, on the same pool
+ * @ptr: object to free
+ * @size: the size @ptr was allocated with
+ */
+static inline void chx_rb_pool_free(struct chx_rb_pool_mag* mag, void* ptr,
+                                    size_t size) {
+    unsigned cls = chx_rb_pool_class(size);
+    struct chx_rb_pool_list* list = &mag->free[cls];
+    struct chx_rb_pool_free* obj = ptr;
+
+    obj->next = list->head;
+    list->head = obj;
+    if (++list->count >= CHX_RB_POOL_MAG_SIZE)
+        __chx_rb_pool_drain(mag, cls);
+}
+
+#define chx_rb_pool_new(mag, type) ((type*)chx_rb_pool_alloc(mag, sizeof(type)))
+#define chx_rb_pool_delete(mag, ptr) chx_rb_pool_free(mag, ptr, sizeof(*(ptr)))
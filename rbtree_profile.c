@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Tree shape profiling.
+ *
+ * One depth first walk gathers everything: the depth and black count of
+ * each node come down from its parent, the black height is taken at the
+ * first leaf and compared at the others, and the address range and page
+ * crossings are collected along the way.
+ */
+
+#include "rbtree_profile.h"
+#include "rbtree_augmented.h"
+#include <stdint.h>
+#include <string.h>
+
+struct chx_rb_profile_walk {
+    struct chx_rb_profile* report;
+    uintptr_t lo, hi;
+    size_t depth_sum;
+    bool leaf_seen;
+    bool rcu;
+};
+
+static inline struct chx_rb_node*
+chx_rb_profile_child(const struct chx_rb_profile_walk* w,
+                     struct chx_rb_node* const* link) {
+    if (w->rcu)
+        return chx_rcu_dereference(*link);
+    return *link;
+}
+
+/* Page of the node at @addr */
+static inline uintptr_t chx_rb_profile_page(uintptr_t addr) {
+    return addr / CHX_RB_PROFILE_PAGE;
+}
+
+static void chx_rb_profile_node(struct chx_rb_profile_walk* w,
+                                const struct chx_rb_node* node,
+                                unsigned depth, unsigned black,
+                                bool parent_red) {
+    struct chx_rb_profile* r = w->report;
+    struct chx_rb_node *left, *right;
+    uintptr_t addr = (uintptr_t)node;
+    bool red;
+
+    if (!node) {
+        if (!w->leaf_seen) {
+            r->black_height = black;
+            w->leaf_seen = true;
+        } else if (black != r->black_height) {
+            r->valid = false;
+        }
+        return;
+    }
+    /* Only a tree changing under an RCU walk gets this deep */
+    if (depth >= CHX_RB_PROFILE_DEPTHS) {
+        r->valid = false;
+        return;
+    }
+
+    red = !(__atomic_load_n(&node->__rb_parent_color, __ATOMIC_RELAXED) &
+            CHX_RB_BLACK);
+    r->count++;
+    r->depth[depth]++;
+    w->depth_sum += depth;
+    if (depth > r->max_depth)
+        r->max_depth = depth;
+    if (red) {
+        r->red++;
+        if (parent_red)
+            r->valid = false;
+    } else {
+        black++;
+    }
+    if (addr < w->lo)
+        w->lo = addr;
+    if (addr + sizeof(*node) - 1 > w->hi)
+        w->hi = addr + sizeof(*node) - 1;
+
+    left = chx_rb_profile_child(w, &node->rb_left);
+    right = chx_rb_profile_child(w, &node->rb_right);
+    if (left && chx_rb_profile_page((uintptr_t)left) !=
+                    chx_rb_profile_page(addr))
+        r->far_links++;
+    if (right && chx_rb_profile_page((uintptr_t)right) !=
+                     chx_rb_profile_page(addr))
+        r->far_links++;
+    chx_rb_profile_node(w, left, depth + 1, black, red);
+    chx_rb_profile_node(w, right, depth + 1, black, red);
+}
+
+static void __chx_rb_profile(const struct chx_rb_root* root,
+                             struct chx_rb_profile* report, bool rcu) {
+    struct chx_rb_profile_walk w = {
+        .report = report, .lo = UINTPTR_MAX, .hi = 0, .rcu = rcu};
+    struct chx_rb_node* top;
+
+    memset(report, 0, sizeof(*report));
+    report->valid = true;
+    top = chx_rb_profile_child(&w, &root->rb_node);
+    if (!top)
+        return;
+
+    chx_rb_profile_node(&w, top, 1, 0, false);
+    report->avg_depth = (double)w.depth_sum / report->count;
+    report->red_ratio = (double)report->red / report->count;
+    report->span_lines =
+        w.hi / CHX_RB_PROFILE_LINE - w.lo / CHX_RB_PROFILE_LINE + 1;
+}
+
+void chx_rb_profile(const struct chx_rb_root* root,
+                    struct chx_rb_profile* report) {
+    __chx_rb_profile(root, report, false);
+}
+
+void chx_rb_profile_rcu(const struct chx_rb_root* root,
+                        struct chx_rb_profile* report) {
+    __chx_rb_profile(root, report, true);
+}
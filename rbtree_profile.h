@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Tree shape profiling.
+ *
+ * chx_rb_profile() walks a tree once and reports its shape: how deep the
+ * nodes sit, how far it is from perfect balance, and how widely the nodes
+ * are scattered in memory. Deep trees call for fewer nodes or a flatter
+ * layout (see rbtree_frozen.h, rbtree_eytz.h). A tree of normal depth that
+ * spans many more cache lines than it has nodes, or whose links mostly
+ * cross pages, is paying for allocator scatter instead and is worth
+ * rebuilding from compactly allocated nodes (see rbtree_pool.h).
+ *
+ * chx_rb_profile_rcu() reads the tree with chx_rcu_dereference() and may
+ * run inside a read side section on any registered reader thread, e.g. a
+ * background monitor, while the writer keeps updating the tree. Its report
+ * is then an estimate: a node moved by a concurrent rotation may be counted
+ * twice or missed, and valid may turn false.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+
+#define CHX_RB_PROFILE_LINE 64
+#define CHX_RB_PROFILE_PAGE 4096
+/* Depths go from 1 for the root to CHX_RB_ITER_DEPTH */
+#define CHX_RB_PROFILE_DEPTHS (CHX_RB_ITER_DEPTH + 1)
+
+struct chx_rb_profile {
+    size_t count;
+    size_t depth[CHX_RB_PROFILE_DEPTHS]; /* nodes at each depth */
+    unsigned max_depth;
+    double avg_depth;
+    /* Black nodes on the path from the root to a leaf, the root included */
+    unsigned black_height;
+    size_t red;
+    double red_ratio;
+    /* No red node has a red child and every path has black_height */
+    bool valid;
+    /* Cache lines from the lowest to the highest node address */
+    size_t span_lines;
+    /* Links from a node to a child on another page */
+    size_t far_links;
+};
+
+extern void chx_rb_profile(const struct chx_rb_root* root,
+                           struct chx_rb_profile* report);
+extern void chx_rb_profile_rcu(const struct chx_rb_root* root,
+                               struct chx_rb_profile* report);
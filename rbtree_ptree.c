@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Persistent rbtree updates.
+ *
+ * The rebalancing cases are those of __chx_rb_insert() and
+ * ____chx_rb_erase_color(), written once for both sides with @dir naming
+ * the side, and with parents taken from the path recorded on the way down
+ * instead of from the nodes. Every node on that path is private by the time
+ * it is changed, as is any sibling or nephew before it is recolored or
+ * rotated; subtrees that are only moved from one private parent to another
+ * keep their reference.
+ */
+
+#include "rbtree_ptree.h"
+#include "rbtree_augmented.h"
+
+/* A path may grow by one in erase case 1 */
+#define CHX_RB_PTREE_PATH (CHX_RB_ITER_DEPTH + 1)
+
+static inline struct chx_rb_node** chx_rb_ptree_child(struct chx_rb_node* node,
+                                                      int dir) {
+    return dir ? &node->rb_right : &node->rb_left;
+}
+
+/* Shared nodes keep their color, only the count changes under us */
+static inline unsigned long chx_rb_ptree_color(const struct chx_rb_node* node) {
+    return __atomic_load_n(&node->__rb_parent_color, __ATOMIC_RELAXED) & 1;
+}
+
+static inline bool chx_rb_ptree_red(const struct chx_rb_node* node) {
+    return node && !chx_rb_ptree_color(node);
+}
+
+/* Only for private nodes */
+static inline void chx_rb_ptree_set_color(struct chx_rb_node* node,
+                                          unsigned long color) {
+    node->__rb_parent_color = (node->__rb_parent_color & ~1ul) | color;
+}
+
+#define chx_rb_ptree_set_black(node) chx_rb_ptree_set_color(node, CHX_RB_BLACK)
+#define chx_rb_ptree_set_red(node) chx_rb_ptree_set_color(node, CHX_RB_RED)
+
+static inline void chx_rb_ptree_get(struct chx_rb_node* node) {
+    if (node)
+        __atomic_fetch_add(&node->__rb_parent_color, CHX_RB_PTREE_REF,
+                           __ATOMIC_RELAXED);
+}
+
+static void chx_rb_ptree_put(struct chx_rb_node* node,
+                             const struct chx_rb_ptree_ops* ops) {
+    if (!node || __atomic_sub_fetch(&node->__rb_parent_color, CHX_RB_PTREE_REF,
+                                    __ATOMIC_ACQ_REL) >= CHX_RB_PTREE_REF)
+        return;
+    chx_rb_ptree_put(node->rb_left, ops);
+    chx_rb_ptree_put(node->rb_right, ops);
+    ops->release(node, ops->ctx);
+}
+
+/*
+ * @node, reached through private parents only, if it has no other
+ * reference, otherwise a private copy. The caller links the result in.
+ */
+static struct chx_rb_node*
+chx_rb_ptree_own(struct chx_rb_node* node, const struct chx_rb_ptree_ops* ops) {
+    struct chx_rb_node* copy;
+
+    if (CHX_RB_PTREE_REFS(node) == 1)
+        return node;
+    copy = ops->copy(node, ops->ctx);
+    copy->__rb_parent_color = CHX_RB_PTREE_REF | chx_rb_ptree_color(node);
+    copy->rb_left = node->rb_left;
+    copy->rb_right = node->rb_right;
+    chx_rb_ptree_get(copy->rb_left);
+    chx_rb_ptree_get(copy->rb_right);
+    chx_rb_ptree_put(node, ops);
+    return copy;
+}
+
+/* Make the child of @parent on side @dir private */
+static struct chx_rb_node*
+chx_rb_ptree_own_child(struct chx_rb_node* parent, int dir,
+                       const struct chx_rb_ptree_ops* ops) {
+    struct chx_rb_node** link = chx_rb_ptree_child(parent, dir);
+
+    return *link = chx_rb_ptree_own(*link, ops);
+}
+
+/* Point the link to @old, the node at path[@depth], at @new */
+static void chx_rb_ptree_replace(struct chx_rb_root* tree,
+                                 struct chx_rb_node** path, int depth,
+                                 struct chx_rb_node* old,
+                                 struct chx_rb_node* new) {
+    struct chx_rb_node* parent = depth > 0 ? path[depth - 1] : NULL;
+
+    if (!parent)
+        tree->rb_node = new;
+    else if (parent->rb_left == old)
+        parent->rb_left = new;
+    else
+        parent->rb_right = new;
+}
+
+static void chx_rb_ptree_insert_color(struct chx_rb_root* tree,
+                                      struct chx_rb_node** path, int depth,
+                                      const struct chx_rb_ptree_ops* ops) {
+    for (;;) {
+        struct chx_rb_node *node = path[depth], *parent, *gparent, *uncle;
+        int dir;
+
+        if (!depth) {
+            chx_rb_ptree_set_black(node);
+            return;
+        }
+        parent = path[depth - 1];
+        if (!chx_rb_ptree_red(parent))
+            return;
+        gparent = path[depth - 2];
+        dir = parent == gparent->rb_right;
+        uncle = *chx_rb_ptree_child(gparent, !dir);
+        if (chx_rb_ptree_red(uncle)) {
+            /* Case 1 - node's uncle is red (color flips) */
+            uncle = chx_rb_ptree_own_child(gparent, !dir, ops);
+            chx_rb_ptree_set_black(uncle);
+            chx_rb_ptree_set_black(parent);
+            chx_rb_ptree_set_red(gparent);
+            depth -= 2;
+            continue;
+        }
+        if (node == *chx_rb_ptree_child(parent, !dir)) {
+            /* Case 2 - node's uncle is black and node is the inner child */
+            *chx_rb_ptree_child(parent, !dir) = *chx_rb_ptree_child(node, dir);
+            *chx_rb_ptree_child(node, dir) = parent;
+            *chx_rb_ptree_child(gparent, dir) = node;
+            parent = node;
+        }
+        /* Case 3 - node's uncle is black and node is the outer child */
+        *chx_rb_ptree_child(gparent, dir) = *chx_rb_ptree_child(parent, !dir);
+        *chx_rb_ptree_child(parent, !dir) = gparent;
+        chx_rb_ptree_set_black(parent);
+        chx_rb_ptree_set_red(gparent);
+        chx_rb_ptree_replace(tree, path, depth - 2, gparent, parent);
+        return;
+    }
+}
+
+/* Restore the black height above @node, NULL or black, below path[@depth] */
+static void chx_rb_ptree_erase_color(struct chx_rb_root* tree,
+                                     struct chx_rb_node** path, int depth,
+                                     struct chx_rb_node* node,
+                                     const struct chx_rb_ptree_ops* ops) {
+    struct chx_rb_node* parent = path[depth];
+
+    for (;;) {
+        struct chx_rb_node *sibling, *near, *far;
+        int dir = node == parent->rb_right;
+
+        sibling = chx_rb_ptree_own_child(parent, !dir, ops);
+        if (chx_rb_ptree_red(sibling)) {
+            /* Case 1 - rotate at parent, the sibling becomes black */
+            *chx_rb_ptree_child(parent, !dir) =
+                *chx_rb_ptree_child(sibling, dir);
+            *chx_rb_ptree_child(sibling, dir) = parent;
+            chx_rb_ptree_set_black(sibling);
+            chx_rb_ptree_set_red(parent);
+            chx_rb_ptree_replace(tree, path, depth, parent, sibling);
+            path[depth++] = sibling;
+            path[depth] = parent;
+            sibling = chx_rb_ptree_own_child(parent, !dir, ops);
+        }
+        far = *chx_rb_ptree_child(sibling, !dir);
+        if (!chx_rb_ptree_red(far)) {
+            near = *chx_rb_ptree_child(sibling, dir);
+            if (!chx_rb_ptree_red(near)) {
+                /* Case 2 - sibling color flip, maybe continue upwards */
+                chx_rb_ptree_set_red(sibling);
+                if (chx_rb_ptree_red(parent)) {
+                    chx_rb_ptree_set_black(parent);
+                } else if (depth > 0) {
+                    node = parent;
+                    parent = path[--depth];
+                    continue;
+                }
+                return;
+            }
+            /* Case 3 - rotate at sibling, the near nephew moves up */
+            near = chx_rb_ptree_own_child(sibling, dir, ops);
+            *chx_rb_ptree_child(sibling, dir) = *chx_rb_ptree_child(near, !dir);
+            *chx_rb_ptree_child(near, !dir) = sibling;
+            *chx_rb_ptree_child(parent, !dir) = near;
+            far = sibling;
+            sibling = near;
+        } else {
+            far = chx_rb_ptree_own_child(sibling, !dir, ops);
+        }
+        /* Case 4 - rotate at parent + color flips */
+        *chx_rb_ptree_child(parent, !dir) = *chx_rb_ptree_child(sibling, dir);
+        *chx_rb_ptree_child(sibling, dir) = parent;
+        chx_rb_ptree_set_color(sibling, chx_rb_ptree_color(parent));
+        chx_rb_ptree_set_black(parent);
+        chx_rb_ptree_set_black(far);
+        chx_rb_ptree_replace(tree, path, depth, parent, sibling);
+        return;
+    }
+}
+
+void chx_rb_ptree_add(struct chx_rb_node* node, struct chx_rb_root* tree,
+                      bool (*less)(struct chx_rb_node*,
+                                   const struct chx_rb_node*),
+                      const struct chx_rb_ptree_ops* ops) {
+    struct chx_rb_node* path[CHX_RB_PTREE_PATH];
+    struct chx_rb_node** link = &tree->rb_node;
+    int depth = 0;
+
+    while (*link) {
+        struct chx_rb_node* cur = chx_rb_ptree_own(*link, ops);
+
+        *link = cur;
+        path[depth++] = cur;
+        link = less(node, cur) ? &cur->rb_left : &cur->rb_right;
+    }
+    node->__rb_parent_color = CHX_RB_PTREE_REF | CHX_RB_RED;
+    node->rb_left = node->rb_right = NULL;
+    *link = node;
+    path[depth] = node;
+    chx_rb_ptree_insert_color(tree, path, depth, ops);
+}
+
+bool chx_rb_ptree_erase(const void* key, struct chx_rb_root* tree,
+                        int (*cmp)(const void* key, const struct chx_rb_node*),
+                        const struct chx_rb_ptree_ops* ops) {
+    struct chx_rb_node *path[CHX_RB_PTREE_PATH], *node, *child, *succ;
+    struct chx_rb_node** link = &tree->rb_node;
+    unsigned long color;
+    int depth = 0, top;
+
+    /* Look first, so a miss copies nothing */
+    if (!chx_rb_find(key, tree, cmp))
+        return false;
+    for (;;) {
+        int c;
+
+        node = *link = chx_rb_ptree_own(*link, ops);
+        path[depth] = node;
+        c = cmp(key, node);
+        if (!c)
+            break;
+        link = c < 0 ? &node->rb_left : &node->rb_right;
+        depth++;
+    }
+
+    if (!node->rb_left || !node->rb_right) {
+        child = node->rb_left ? node->rb_left : node->rb_right;
+        color = chx_rb_ptree_color(node);
+        chx_rb_ptree_replace(tree, path, depth, node, child);
+        top = depth - 1;
+    } else {
+        /* Splice out the successor and put it in place of node */
+        top = depth + 1;
+        succ = path[top] = chx_rb_ptree_own_child(node, 1, ops);
+        while (succ->rb_left) {
+            succ = chx_rb_ptree_own_child(succ, 0, ops);
+            path[++top] = succ;
+        }
+        child = succ->rb_right;
+        if (top > depth + 1) {
+            path[top - 1]->rb_left = child;
+            succ->rb_right = node->rb_right;
+        }
+        succ->rb_left = node->rb_left;
+        color = chx_rb_ptree_color(succ);
+        chx_rb_ptree_set_color(succ, chx_rb_ptree_color(node));
+        chx_rb_ptree_replace(tree, path, depth, node, succ);
+        path[depth] = succ;
+        top--;
+    }
+    /* node is private, so its reference was the only one */
+    ops->release(node, ops->ctx);
+
+    if (color == CHX_RB_RED)
+        return true;
+    if (chx_rb_ptree_red(child)) {
+        struct chx_rb_node* own = chx_rb_ptree_own(child, ops);
+
+        chx_rb_ptree_replace(tree, path, top + 1, child, own);
+        chx_rb_ptree_set_black(own);
+    } else if (top >= 0) {
+        chx_rb_ptree_erase_color(tree, path, top, child, ops);
+    }
+    return true;
+}
+
+void chx_rb_ptree_release(struct chx_rb_root* tree,
+                          const struct chx_rb_ptree_ops* ops) {
+    chx_rb_ptree_put(tree->rb_node, ops);
+    tree->rb_node = NULL;
+}
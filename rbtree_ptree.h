@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Persistent (path copying) rbtrees.
+ *
+ * Nodes of a persistent tree can be shared between versions, so they have
+ * no parent pointer: the parent word of struct chx_rb_node holds a
+ * reference count instead, with the color in its low bit as usual. Each
+ * reference is one parent node or one struct chx_rb_root pointing at the
+ * node.
+ *
+ * chx_rb_ptree_add() and chx_rb_ptree_erase() update the version in @tree.
+ * Shared nodes on the search path, and the siblings rebalancing recolors or
+ * rotates, are first replaced by private copies made through @ops->copy,
+ * which take a reference on the children. A node whose count drops to zero
+ * drops its children and goes to @ops->release. Without outstanding
+ * snapshots every node is private and updates work in place.
+ *
+ * chx_rb_ptree_snapshot() takes another reference on the root, which is
+ * O(1), and returns a version that later updates leave untouched. Versions
+ * are read with the functions that never follow parent pointers:
+ * chx_rb_find(), the bound lookups and struct chx_rb_iter. They are
+ * dropped with chx_rb_ptree_release(), from any thread. Updates and
+ * snapshots of one tree must be serialized.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+
+/* One reference in the parent word, above the color bit */
+#define CHX_RB_PTREE_REF 2ul
+
+struct chx_rb_ptree_ops {
+    /*
+     * A new node with the contents of @node; the tree sets its links and
+     * color. Must not fail.
+     */
+    struct chx_rb_node* (*copy)(const struct chx_rb_node* node, void* ctx);
+    void (*release)(struct chx_rb_node* node, void* ctx);
+    void* ctx;
+};
+
+#define CHX_RB_PTREE_REFS(node)                                                \
+    (__atomic_load_n(&(node)->__rb_parent_color, __ATOMIC_ACQUIRE) /           \
+     CHX_RB_PTREE_REF)
+
+extern void chx_rb_ptree_add(struct chx_rb_node* node, struct chx_rb_root* tree,
+                             bool (*less)(struct chx_rb_node*,
+                                          const struct chx_rb_node*),
+                             const struct chx_rb_ptree_ops* ops);
+/* Erase a node matching @key, returns false if there is none */
+extern bool chx_rb_ptree_erase(const void* key, struct chx_rb_root* tree,
+                               int (*cmp)(const void* key,
+                                          const struct chx_rb_node*),
+                               const struct chx_rb_ptree_ops* ops);
+extern void chx_rb_ptree_release(struct chx_rb_root* tree,
+                                 const struct chx_rb_ptree_ops* ops);
+
+static inline struct chx_rb_root
+chx_rb_ptree_snapshot(const struct chx_rb_root* tree) {
+    if (tree->rb_node)
+        __atomic_fetch_add(&tree->rb_node->__rb_parent_color,
+                           CHX_RB_PTREE_REF, __ATOMIC_RELAXED);
+    return *tree;
+}
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Epoch based reclamation for RCU readers of chx_rb trees.
+ *
+ * The domain epoch starts at 1 and is only advanced by the writer side
+ * (chx_rb_rcu_poll() / chx_rb_synchronize_rcu()). A reader announces the
+ * epoch it observed on entry, 0 meaning quiescent. A deferred node is tagged
+ * with the epoch current when it was queued, after it had been unlinked; a
+ * reader that announced a later epoch entered after the unlink and cannot
+ * reach it. So a node may be freed once every active reader announces an
+ * epoch greater than the node's.
+ */
+
+#include "rbtree_rcu.h"
+#include <sched.h>
+
+void chx_rb_rcu_init(struct chx_rb_rcu_domain* domain) {
+    domain->epoch = 1;
+    pthread_mutex_init(&domain->lock, NULL);
+    domain->readers = NULL;
+    domain->pending = NULL;
+    domain->pending_tail = &domain->pending;
+}
+
+static void chx_rb_rcu_run(struct chx_rb_rcu_head* head) {
+    struct chx_rb_rcu_head* next;
+
+    for (; head; head = next) {
+        next = head->next;
+        head->func(head);
+    }
+}
+
+/*
+ * Detach the pending callbacks queued before @epoch. The queue is in epoch
+ * order, so they form a prefix of it.
+ */
+static struct chx_rb_rcu_head*
+chx_rb_rcu_detach(struct chx_rb_rcu_domain* domain, unsigned long epoch,
+                  size_t* count) {
+    struct chx_rb_rcu_head *done = domain->pending, **link = &domain->pending;
+    size_t n = 0;
+
+    while (*link && (*link)->epoch < epoch) {
+        link = &(*link)->next;
+        n++;
+    }
+
+    *count = n;
+    if (!n)
+        return NULL;
+
+    domain->pending = *link;
+    if (!domain->pending)
+        domain->pending_tail = &domain->pending;
+    *link = NULL;
+    return done;
+}
+
+/*
+ * Advance the epoch. The full barrier pairs with the one in
+ * chx_rb_rcu_read_lock(): either we see the reader's announcement, or the
+ * reader sees every unlink that preceded the new epoch.
+ */
+static unsigned long chx_rb_rcu_advance(struct chx_rb_rcu_domain* domain) {
+    unsigned long epoch =
+        __atomic_add_fetch(&domain->epoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return epoch;
+}
+
+void chx_rb_rcu_destroy(struct chx_rb_rcu_domain* domain) {
+    size_t n;
+
+    /* No readers are left, everything is reclaimable */
+    chx_rb_rcu_run(chx_rb_rcu_detach(domain, ~0ul, &n));
+    pthread_mutex_destroy(&domain->lock);
+}
+
+void chx_rb_rcu_register(struct chx_rb_rcu_domain* domain,
+                         struct chx_rb_rcu_reader* reader) {
+    reader->epoch = 0;
+    reader->nesting = 0;
+    reader->domain = domain;
+
+    pthread_mutex_lock(&domain->lock);
+    reader->next = domain->readers;
+    domain->readers = reader;
+    pthread_mutex_unlock(&domain->lock);
+}
+
+void chx_rb_rcu_unregister(struct chx_rb_rcu_reader* reader) {
+    struct chx_rb_rcu_domain* domain = reader->domain;
+    struct chx_rb_rcu_reader** link;
+
+    pthread_mutex_lock(&domain->lock);
+    for (link = &domain->readers; *link; link = &(*link)->next) {
+        if (*link == reader) {
+            *link = reader->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&domain->lock);
+}
+
+void chx_rb_defer_free(struct chx_rb_rcu_domain* domain,
+                       struct chx_rb_rcu_head* head,
+                       void (*func)(struct chx_rb_rcu_head* head)) {
+    head->func = func;
+    head->next = NULL;
+
+    pthread_mutex_lock(&domain->lock);
+    head->epoch = __atomic_load_n(&domain->epoch, __ATOMIC_RELAXED);
+    *domain->pending_tail = head;
+    domain->pending_tail = &head->next;
+    pthread_mutex_unlock(&domain->lock);
+}
+
+size_t chx_rb_rcu_poll(struct chx_rb_rcu_domain* domain) {
+    struct chx_rb_rcu_reader* reader;
+    struct chx_rb_rcu_head* done;
+    unsigned long min, epoch;
+    size_t n;
+
+    pthread_mutex_lock(&domain->lock);
+    min = chx_rb_rcu_advance(domain);
+    for (reader = domain->readers; reader; reader = reader->next) {
+        epoch = __atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE);
+        if (epoch && epoch < min)
+            min = epoch;
+    }
+    done = chx_rb_rcu_detach(domain, min, &n);
+    pthread_mutex_unlock(&domain->lock);
+
+    chx_rb_rcu_run(done);
+    return n;
+}
+
+/* Wait for every reader that entered before the new epoch, lock held */
+static unsigned long chx_rb_rcu_wait(struct chx_rb_rcu_domain* domain) {
+    struct chx_rb_rcu_reader* reader;
+    unsigned long epoch, seen;
+
+    epoch = chx_rb_rcu_advance(domain);
+    for (reader = domain->readers; reader; reader = reader->next) {
+        while ((seen = __atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE)) &&
+               seen < epoch)
+            sched_yield();
+    }
+    return epoch;
+}
+
+void chx_rb_synchronize_rcu(struct chx_rb_rcu_domain* domain) {
+    pthread_mutex_lock(&domain->lock);
+    chx_rb_rcu_wait(domain);
+    pthread_mutex_unlock(&domain->lock);
+}
+
+void chx_rb_rcu_barrier(struct chx_rb_rcu_domain* domain) {
+    struct chx_rb_rcu_head* done;
+    size_t n;
+
+    pthread_mutex_lock(&domain->lock);
+    done = chx_rb_rcu_detach(domain, chx_rb_rcu_wait(domain), &n);
+    pthread_mutex_unlock(&domain->lock);
+
+    chx_rb_rcu_run(done);
+}
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Epoch based reclamation for RCU readers of chx_rb trees.
+ *
+ * A single writer (or writers serialized by the caller) mutates the tree with
+ * the _rcu primitives while any number of registered readers walk it with
+ * chx_rb_find_rcu() / chx_rcu_dereference() inside
+ * chx_rb_rcu_read_lock()/chx_rb_rcu_read_unlock().
+ *
+ * Each reader owns a cache line sized chx_rb_rcu_reader in which it
+ * announces the epoch it entered at; entering and leaving a read side
+ * section only writes that private line and reads the shared epoch, so
+ * readers on different cores do not contend.
+ *
+ * The writer hands erased nodes to chx_rb_defer_free(). They are released
+ * by chx_rb_rcu_poll() once no reader can still hold them, or unconditionally
+ * by chx_rb_rcu_barrier(), which waits for a grace period first.
+ */
+
+#pragma once
+
+#include "rbtree.h"
+#include <pthread.h>
+
+#define CHX_RB_RCU_CACHELINE 64
+
+struct chx_rb_rcu_domain;
+
+struct chx_rb_rcu_reader {
+    /* epoch observed on entry, 0 while outside a read side section */
+    unsigned long epoch;
+    unsigned int nesting;
+    struct chx_rb_rcu_domain* domain;
+    struct chx_rb_rcu_reader* next;
+} __attribute__((aligned(CHX_RB_RCU_CACHELINE)));
+
+struct chx_rb_rcu_head {
+    struct chx_rb_rcu_head* next;
+    void (*func)(struct chx_rb_rcu_head* head);
+    unsigned long epoch;
+};
+
+struct chx_rb_rcu_domain {
+    unsigned long epoch __attribute__((aligned(CHX_RB_RCU_CACHELINE)));
+
+    /* writer side, kept off the epoch cache line */
+    pthread_mutex_t lock __attribute__((aligned(CHX_RB_RCU_CACHELINE)));
+    struct chx_rb_rcu_reader* readers;
+    struct chx_rb_rcu_head* pending;
+    struct chx_rb_rcu_head** pending_tail;
+};
+
+extern void chx_rb_rcu_init(struct chx_rb_rcu_domain* domain);
+extern void chx_rb_rcu_destroy(struct chx_rb_rcu_domain* domain);
+
+/* Readers must be registered before their first read side section */
+extern void chx_rb_rcu_register(struct chx_rb_rcu_domain* domain,
+                                struct chx_rb_rcu_reader* reader);
+extern void chx_rb_rcu_unregister(struct chx_rb_rcu_reader* reader);
+
+/**
+ * chx_rb_rcu_read_lock() - enter a read side section
+ * @reader: the calling thread's registered reader
+ *
+ * Sections may nest; only the outermost one announces an epoch.
+ */
+static inline void chx_rb_rcu_read_lock(struct chx_rb_rcu_reader* reader) {
+    if (reader->nesting++)
+        return;
+    __atomic_store_n(&reader->epoch,
+                     __atomic_load_n(&reader->domain->epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELAXED);
+    /* Order the announcement before any load from the tree */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * chx_rb_rcu_read_unlock() - leave a read side section
+ * @reader: the calling thread's registered reader
+ *
+ * Nodes reached inside the section must not be used after this.
+ */
+static inline void chx_rb_rcu_read_unlock(struct chx_rb_rcu_reader* reader) {
+    if (--reader->nesting)
+        return;
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * chx_rb_defer_free() - free a node once no reader can reach it
+ * @domain: domain the tree's readers are registered with
+ * @head: chx_rb_rcu_head embedded in the erased element
+ * @func: called with @head once it is safe to free the element
+ *
+ * Writer side only. The element must already be unlinked from the tree.
+ */
+extern void chx_rb_defer_free(struct chx_rb_rcu_domain* domain,
+                              struct chx_rb_rcu_head* head,
+                              void (*func)(struct chx_rb_rcu_head* head));
+
+/*
+ * chx_rb_rcu_poll() advances the epoch and runs the callbacks that no reader
+ * can block any more, without waiting. Returns the number of callbacks run.
+ *
+ * chx_rb_synchronize_rcu() waits until every reader that was inside a read
+ * side section on entry has left it.
+ *
+ * chx_rb_rcu_barrier() waits for a grace period and runs every pending
+ * callback.
+ */
+extern size_t chx_rb_rcu_poll(struct chx_rb_rcu_domain* domain);
+extern void chx_rb_synchronize_rcu(struct chx_rb_rcu_domain* domain);
+extern void chx_rb_rcu_barrier(struct chx_rb_rcu_domain* domain);
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Union, intersection and difference of two trees, by divide and conquer on
+ * join and split.
+ *
+ * Each step takes the root k of @b, splits @a around k, solves the two halves
+ * independently and joins the results back around k, or concatenates them
+ * when k does not belong to the result. For trees of sizes m <= n this is
+ * O(m log(n/m + 1)) work, and the two halves can run on different threads.
+ *
+ * Nodes are only relinked, never allocated. Nodes that do not end up in the
+ * result are handed to the caller's drop callback.
+ */
+
+#include "rbtree_augmented.h"
+#include <pthread.h>
+
+/* Smallest black height, so 2^h - 1 nodes or more, worth its own thread */
+#define CHX_RB_SETOP_PARALLEL_BH 12
+
+enum chx_rb_setop_kind {
+    CHX_RB_SETOP_UNION,
+    CHX_RB_SETOP_INTERSECT,
+    CHX_RB_SETOP_DIFFERENCE,
+};
+
+struct chx_rb_setop {
+    enum chx_rb_setop_kind kind;
+    int (*cmp)(const struct chx_rb_node* a, const struct chx_rb_node* b);
+    void (*drop)(struct chx_rb_node* node, void* ctx);
+    void* ctx;
+};
+
+struct chx_rb_setop_task {
+    const struct chx_rb_setop* op;
+    struct chx_rb_node *a, *b;
+    unsigned ah, bh;
+    unsigned nthreads;
+    struct chx_rb_node* result;
+    unsigned h;
+};
+
+static void chx_rb_setop_drop_all(const struct chx_rb_setop* op,
+                                  struct chx_rb_node* node) {
+    struct chx_rb_node* right;
+
+    if (!op->drop)
+        return;
+    while (node) {
+        chx_rb_setop_drop_all(op, node->rb_left);
+        right = node->rb_right;
+        op->drop(node, op->ctx);
+        node = right;
+    }
+}
+
+/*
+ * Split the subtree @root, of black height @h, around @key: the nodes before
+ * it go to @lt and the nodes after it to @gt. Returns the node of @root equal
+ * to @key, which is in neither, or NULL.
+ */
+static struct chx_rb_node* chx_rb_setop_split(
+    struct chx_rb_node* root, unsigned h, const struct chx_rb_node* key,
+    int (*cmp)(const struct chx_rb_node* a, const struct chx_rb_node* b),
+    struct chx_rb_node** lt, unsigned* lt_h, struct chx_rb_node** gt,
+    unsigned* gt_h) {
+    struct chx_rb_node *node = root, *last = NULL, *child, *parent, *eq;
+    struct chx_rb_node *lt_root = NULL, *gt_root = NULL;
+    unsigned lth = 0, gth = 0;
+    bool left = false;
+    int c, black;
+
+    /* @h follows the black height of @node */
+    while (node) {
+        c = cmp(key, node);
+        if (!c)
+            break;
+        last = node;
+        left = c < 0;
+        h -= chx_rb_is_black(node);
+        node = left ? node->rb_left : node->rb_right;
+    }
+
+    eq = node;
+    if (node) {
+        lt_root = node->rb_left;
+        gt_root = node->rb_right;
+        lth = gth = h - chx_rb_is_black(node);
+    }
+
+    /* Same walk back up the search path as chx_rb_split() */
+    for (child = node, node = last; node; child = node, node = parent) {
+        parent = node == root ? NULL : chx_rb_parent(node);
+        black = chx_rb_is_black(node);
+        if (child)
+            left = node->rb_left == child;
+
+        if (left)
+            gt_root =
+                __chx_rb_join(gt_root, gth, node, node->rb_right, h, &gth);
+        else
+            lt_root = __chx_rb_join(node->rb_left, h, node, lt_root, lth, &lth);
+        h += black;
+    }
+
+    *lt = lt_root;
+    *lt_h = lth;
+    *gt = gt_root;
+    *gt_h = gth;
+    return eq;
+}
+
+/* Join without a pivot, borrowing the first node of @right */
+static struct chx_rb_node* chx_rb_setop_concat(struct chx_rb_node* left,
+                                               unsigned lh,
+                                               struct chx_rb_node* right,
+                                               unsigned rh, unsigned* h) {
+    struct chx_rb_root root = {right};
+    struct chx_rb_node* pivot;
+
+    if (!right) {
+        *h = lh;
+        return left;
+    }
+    if (!left) {
+        *h = rh;
+        return right;
+    }
+
+    chx_rb_set_parent_color(right, NULL, CHX_RB_BLACK);
+    pivot = chx_rb_first(&root);
+    chx_rb_erase(pivot, &root);
+    return __chx_rb_join(left, lh, pivot, root.rb_node,
+                         __chx_rb_black_height(root.rb_node), h);
+}
+
+static void* chx_rb_setop_run(void* arg) {
+    struct chx_rb_setop_task* t = arg;
+    const struct chx_rb_setop* op = t->op;
+    struct chx_rb_node *pivot = t->b, *eq;
+    struct chx_rb_setop_task right;
+    bool keep, threaded;
+    pthread_t tid;
+    unsigned h;
+
+    if (!t->a || !t->b) {
+        switch (op->kind) {
+        case CHX_RB_SETOP_UNION:
+            t->result = t->a ? t->a : t->b;
+            t->h = t->a ? t->ah : t->bh;
+            break;
+        case CHX_RB_SETOP_INTERSECT:
+            chx_rb_setop_drop_all(op, t->a);
+            chx_rb_setop_drop_all(op, t->b);
+            t->result = NULL;
+            t->h = 0;
+            break;
+        case CHX_RB_SETOP_DIFFERENCE:
+            chx_rb_setop_drop_all(op, t->b);
+            t->result = t->a;
+            t->h = t->ah;
+            break;
+        }
+        return NULL;
+    }
+
+    h = t->bh - chx_rb_is_black(pivot);
+    right = (struct chx_rb_setop_task){
+        .op = op,
+        .b = pivot->rb_right,
+        .bh = h,
+        .nthreads = t->nthreads / 2,
+    };
+    eq = chx_rb_setop_split(t->a, t->ah, pivot, op->cmp, &t->a, &t->ah,
+                            &right.a, &right.ah);
+    t->b = pivot->rb_left;
+    t->bh = h;
+    t->nthreads -= right.nthreads;
+
+    /* On equal keys the node from @b wins */
+    if (eq && op->drop)
+        op->drop(eq, op->ctx);
+    keep = op->kind == CHX_RB_SETOP_UNION ||
+           (op->kind == CHX_RB_SETOP_INTERSECT && eq);
+    if (!keep && op->drop)
+        op->drop(pivot, op->ctx);
+
+    threaded = right.nthreads && h >= CHX_RB_SETOP_PARALLEL_BH &&
+               !pthread_create(&tid, NULL, chx_rb_setop_run, &right);
+    if (!threaded)
+        chx_rb_setop_run(&right);
+    chx_rb_setop_run(t);
+    if (threaded)
+        pthread_join(tid, NULL);
+
+    if (keep)
+        t->result =
+            __chx_rb_join(t->result, t->h, pivot, right.result, right.h, &t->h);
+    else
+        t->result =
+            chx_rb_setop_concat(t->result, t->h, right.result, right.h, &t->h);
+    return NULL;
+}
+
+static void chx_rb_setop(struct chx_rb_root* a, struct chx_rb_root* b,
+                         const struct chx_rb_setop* op, unsigned nthreads) {
+    struct chx_rb_setop_task t = {
+        .op = op,
+        .a = a->rb_node,
+        .ah = __chx_rb_black_height(a->rb_node),
+        .b = b->rb_node,
+        .bh = __chx_rb_black_height(b->rb_node),
+        .nthreads = nthreads,
+    };
+
+    chx_rb_setop_run(&t);
+    if (t.result)
+        chx_rb_set_parent_color(t.result, NULL, CHX_RB_BLACK);
+    a->rb_node = t.result;
+    b->rb_node = NULL;
+}
+
+void chx_rb_union(struct chx_rb_root* a, struct chx_rb_root* b,
+                  int (*cmp)(const struct chx_rb_node* a,
+                             const struct chx_rb_node* b),
+                  void (*drop)(struct chx_rb_node* node, void* ctx), void* ctx,
+                  unsigned nthreads) {
+    struct chx_rb_setop op = {CHX_RB_SETOP_UNION, cmp, drop, ctx};
+
+    chx_rb_setop(a, b, &op, nthreads);
+}
+
+void chx_rb_intersect(struct chx_rb_root* a, struct chx_rb_root* b,
+                      int (*cmp)(const struct chx_rb_node* a,
+                                 const struct chx_rb_node* b),
+                      void (*drop)(struct chx_rb_node* node, void* ctx),
+                      void* ctx, unsigned nthreads) {
+    struct chx_rb_setop op = {CHX_RB_SETOP_INTERSECT, cmp, drop, ctx};
+
+    chx_rb_setop(a, b, &op, nthreads);
+}
+
+void chx_rb_difference(struct chx_rb_root* a, struct chx_rb_root* b,
+                       int (*cmp)(const struct chx_rb_node* a,
+                                  const struct chx_rb_node* b),
+                       void (*drop)(struct chx_rb_node* node, void* ctx),
+                       void* ctx, unsigned nthreads) {
+    struct chx_rb_setop op = {CHX_RB_SETOP_DIFFERENCE, cmp, drop, ctx};
+
+    chx_rb_setop(a, b, &op, nthreads);
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Hot path statistics.
+ *
+ * Building with CHX_RB_STATS defined (configure --enable-stats) makes the
+ * rebalancing code and the find/add helpers count what they do, in counters
+ * private to the calling thread: no atomics, no false sharing, and no
+ * change to the size of struct chx_rb_root. Without it the counting macros
+ * expand to nothing and chx_rb_stats_snapshot() reads all zeros.
+ *
+ * The inline helpers count in the caller's translation unit, so code using
+ * them needs the same CHX_RB_STATS setting as the library.
+ */
+
+#pragma once
+
+struct chx_rb_stats {
+    /* __chx_rb_insert(): case 1 color flips, case 2 and 3 rotations */
+    unsigned long insert_recolors;
+    unsigned long insert_rotations;
+    /* ____chx_rb_erase_color(): case 2 sibling flips, case 1, 3, 4 rotations */
+    unsigned long erase_recolors;
+    unsigned long erase_rotations;
+    /* __chx_rb_erase_augmented(): case 1, 2, 3 taken */
+    unsigned long erase_cases[3];
+    /* Left steps of the case 3 walk down to the successor */
+    unsigned long successor_steps;
+    /* Descents of the find/add helpers and the nodes they visited */
+    unsigned long descents;
+    unsigned long descent_steps;
+    /* Nodes recomputed by the augment propagate callbacks */
+    unsigned long propagate_steps;
+};
+
+extern __thread struct chx_rb_stats __chx_rb_stats;
+
+#ifdef CHX_RB_STATS
+#define chx_rb_stat_add(field, n) (__chx_rb_stats.field += (n))
+#else
+#define chx_rb_stat_add(field, n) ((void)0)
+#endif
+
+#define chx_rb_stat_inc(field) chx_rb_stat_add(field, 1)
+
+/* Copy out or clear the calling thread's counters */
+extern void chx_rb_stats_snapshot(struct chx_rb_stats* stats);
+extern void chx_rb_stats_reset(void);
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Static tracepoints.
+ *
+ * Building with CHX_RB_USDT defined (configure --enable-usdt, which needs
+ * <sys/sdt.h> from systemtap) places USDT probes of provider chx_rbtree in
+ * the rebalancing code and the lookups: the chx_rb_find*() helpers, the
+ * bound helpers and the _find, _find_add and _lower_bound functions of
+ * CHX_RB_DECLARE_TREE(). A probe that nobody traces is a single nop, and
+ * bpftrace or perf can attach to a running binary without rebuilding it;
+ * see tools/rbtree_latency.bt. Without CHX_RB_USDT the probes compile to
+ * nothing.
+ *
+ *  insert_case(root, level, case)       __chx_rb_insert() case 1, 2 or 3,
+ *                                       @level case 1 steps up so far
+ *  erase_color_case(root, level, case)  ____chx_rb_erase_color() case 1-4,
+ *                                       @level case 2 steps up so far
+ *  erase_case(root, steps, case)        __chx_rb_erase_augmented() case
+ *                                       1-3, @steps down to the successor
+ *  find_entry(root)                     a lookup starts
+ *  find_return(root, depth, node)       ...and returns @node, NULL for a
+ *                                       miss or an insert, after visiting
+ *                                       @depth nodes
+ *
+ * As with CHX_RB_STATS, the inline helpers are probed in the caller's
+ * translation unit.
+ */
+
+#pragma once
+
+#include "rbtree_types.h"
+
+#ifdef CHX_RB_USDT
+#include <sys/sdt.h>
+
+#define chx_rb_trace1(name, a) STAP_PROBE1(chx_rbtree, name, a)
+#define chx_rb_trace3(name, a, b, c) STAP_PROBE3(chx_rbtree, name, a, b, c)
+#else
+/* Unevaluated, but keeps the arguments used */
+#define chx_rb_trace1(name, a) ((void)sizeof(a))
+#define chx_rb_trace3(name, a, b, c)                                           \
+    ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#endif
+
+/* Fire find_return on the way out of a lookup */
+static inline struct chx_rb_node*
+__chx_rb_find_return(const void* tree, unsigned depth,
+                     struct chx_rb_node* node) {
+    chx_rb_trace3(find_return, tree, depth, node);
+    return node;
+}
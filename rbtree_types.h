@@ -15,18 +15,36 @@ struct chx_rb_root {
 /*
  * Leftmost-cached rbtrees.
  *
- * We do not cache the rightmost node based on footprint
+ * The rightmost node is not cached here based on footprint
  * size vs number of potential users that could benefit
- * from O(1) rb_last(). Just not worth it, users that want
- * this feature can always implement the logic explicitly.
- * Furthermore, users that want to cache both pointers may
- * find it a bit asymmetric, but that's ok.
+ * from O(1) rb_last(). Users that pop from both ends, such
+ * as deadline queues, can use chx_rb_root_cached2 below,
+ * which caches both pointers.
  */
 struct chx_rb_root_cached {
     struct chx_rb_root rb_root;
     struct chx_rb_node* rb_leftmost;
 };
 
+/* Leftmost and rightmost cached rbtrees */
+struct chx_rb_root_cached2 {
+    struct chx_rb_root rb_root;
+    struct chx_rb_node* rb_leftmost;
+    struct chx_rb_node* rb_rightmost;
+};
+
+/*
+ * In-order cursor keeping the path from the root to the current node, so it
+ * steps without reading parent pointers. A tree of n nodes is at most
+ * 2 * log2(n + 1) deep, so two levels per address bit always suffice.
+ */
+#define CHX_RB_ITER_DEPTH (2 * 8 * sizeof(void*))
+
+struct chx_rb_iter {
+    unsigned depth;
+    struct chx_rb_node* path[CHX_RB_ITER_DEPTH];
+};
+
 #define CHX_RB_ROOT                                                            \
     (struct chx_rb_root) { NULL, }
 #define CHX_RB_ROOT_CACHED                                                     \
@@ -36,3 +54,10 @@ struct chx_rb_root_cached {
         },                                                                     \
             NULL                                                               \
     }
+#define CHX_RB_ROOT_CACHED2                                                    \
+    (struct chx_rb_root_cached2) {                                             \
+        {                                                                      \
+            NULL,                                                              \
+        },                                                                     \
+            NULL, NULL                                                         \
+    }
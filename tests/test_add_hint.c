@@ -0,0 +1,100 @@
+#include "test_helper.h"
+
+#define N 1000
+
+/* 测试18: 带提示的插入 */
+static int test_add_hint(void) {
+    printf("测试18: 带提示的插入...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_root_cached croot = CHX_RB_ROOT_CACHED;
+    struct test_node* prev = NULL;
+
+    /* 单调递增, 提示为上一个插入的节点 */
+    for (int i = 0; i < N; i++) {
+        struct test_node* node = create_node(i);
+        chx_rb_add_hint(&node->rb, prev ? &prev->rb : NULL, &root, less_func);
+        prev = node;
+    }
+    /* 随机插入, 提示多数是错误的, 需要回退到完整下降 */
+    for (int i = 0; i < N; i++) {
+        struct test_node* node = create_node(rand() % N);
+        chx_rb_add_hint(&node->rb, &prev->rb, &root, less_func);
+    }
+    if (verify_order(&root) != 2 * N) {
+        printf("失败 (顺序或数量错误)\n");
+        clear_tree(&root);
+        return 1;
+    }
+    clear_tree(&root);
+
+    /* 单调递减的 cached 版本: 每个节点都是新的 leftmost */
+    prev = NULL;
+    for (int i = N; i > 0; i--) {
+        struct test_node* node = create_node(i);
+        struct chx_rb_node* ret = chx_rb_add_hint_cached(
+            &node->rb, prev ? &prev->rb : NULL, &croot, less_func);
+        if (ret != &node->rb || chx_rb_first_cached(&croot) != &node->rb) {
+            printf("失败 (leftmost 未更新)\n");
+            clear_tree(&croot.rb_root);
+            return 1;
+        }
+        prev = node;
+    }
+    /* 插在中间的节点不应改变 leftmost */
+    struct test_node* mid = create_node(N / 2);
+    if (chx_rb_add_hint_cached(&mid->rb, &prev->rb, &croot, less_func) ||
+        chx_rb_entry(chx_rb_first_cached(&croot), struct test_node, rb)->key !=
+            1) {
+        printf("失败 (leftmost 错误)\n");
+        clear_tree(&croot.rb_root);
+        return 1;
+    }
+    if (verify_order(&croot.rb_root) != N + 1) {
+        printf("失败 (cached 顺序或数量错误)\n");
+        clear_tree(&croot.rb_root);
+        return 1;
+    }
+
+    clear_tree(&croot.rb_root);
+
+    /* 两端缓存: 追加到 rightmost 之后, 插到 leftmost 之前 */
+    struct chx_rb_root_cached2 croot2 = CHX_RB_ROOT_CACHED2;
+    struct test_node *last = NULL, *first;
+    for (int i = N; i < 2 * N; i++) {
+        struct test_node* node = create_node(i);
+        struct chx_rb_node* ret = chx_rb_add_hint_cached2(
+            &node->rb, last ? &last->rb : NULL, &croot2, less_func);
+        if (ret != &node->rb || chx_rb_last_cached2(&croot2) != &node->rb) {
+            printf("失败 (rightmost 未更新)\n");
+            clear_tree(&croot2.rb_root);
+            return 1;
+        }
+        last = node;
+    }
+    first = chx_rb_entry(chx_rb_first_cached2(&croot2), struct test_node, rb);
+    for (int i = N - 1; i >= 0; i--) {
+        struct test_node* node = create_node(i);
+        if (chx_rb_add_hint_cached2(&node->rb, &first->rb, &croot2,
+                                    less_func) != &node->rb ||
+            chx_rb_first_cached2(&croot2) != &node->rb) {
+            printf("失败 (leftmost 未更新)\n");
+            clear_tree(&croot2.rb_root);
+            return 1;
+        }
+        first = node;
+    }
+    mid = create_node(N + N / 2);
+    if (chx_rb_add_hint_cached2(&mid->rb, &last->rb, &croot2, less_func) ||
+        chx_rb_last_cached2(&croot2) != &last->rb ||
+        verify_order(&croot2.rb_root) != 2 * N + 1) {
+        printf("失败 (两端缓存顺序或数量错误)\n");
+        clear_tree(&croot2.rb_root);
+        return 1;
+    }
+
+    clear_tree(&croot2.rb_root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_add_hint(); }
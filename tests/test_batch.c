@@ -0,0 +1,80 @@
+#include "test_helper.h"
+
+#define N 4000
+#define BATCH 100
+
+/* 测试26: 批量查找与批量 find_add */
+static int test_batch(void) {
+    printf("测试26: 批量查找...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_node *nodes[BATCH], *out[BATCH];
+    const void* keys[BATCH];
+    int karr[BATCH];
+
+    srand(26);
+
+    /* 空树和空批次 */
+    karr[0] = 1;
+    keys[0] = &karr[0];
+    out[0] = (struct chx_rb_node*)&root;
+    chx_rb_find_batch(keys, 1, &root, key_cmp_func, out);
+    chx_rb_find_batch(keys, 0, &root, key_cmp_func, NULL);
+    if (out[0]) {
+        printf("失败 (空树查找结果不为NULL)\n");
+        return 1;
+    }
+
+    /*
+     * 批量插入, 批内也有重复键. 后一半的键集中在几个小区间,
+     * 同一窗口内多个节点落在同一个空位
+     */
+    for (int done = 0; done < N; done += BATCH) {
+        for (int i = 0; i < BATCH; i++) {
+            int key = done < N / 2 ? rand() % (N * 2)
+                                   : rand() % 8 * (N / 4) + rand() % 16;
+
+            nodes[i] = &create_node(key)->rb;
+        }
+        chx_rb_find_add_batch(nodes, BATCH, &root, cmp_func, out);
+        for (int i = 0; i < BATCH; i++) {
+            struct test_node* tn = chx_rb_entry(nodes[i], struct test_node, rb);
+            struct chx_rb_node* found =
+                chx_rb_find(&tn->key, &root, key_cmp_func);
+
+            /* 已存在则返回该节点, 否则 nodes[i] 已被插入 */
+            if (found != (out[i] ? out[i] : nodes[i])) {
+                printf("失败 (find_add_batch结果错误)\n");
+                return 1;
+            }
+            if (out[i])
+                free(tn);
+        }
+    }
+    if (verify_order(&root) < 0) {
+        printf("失败 (插入后顺序错误)\n");
+        return 1;
+    }
+
+    /* 与逐个 chx_rb_find 的结果一致, 批次大小不是槽位数的整数倍 */
+    for (int k = 0; k < N * 2; k += BATCH - 3) {
+        int m = k + BATCH - 3 <= N * 2 ? BATCH - 3 : N * 2 - k;
+
+        for (int i = 0; i < m; i++) {
+            karr[i] = k + i;
+            keys[i] = &karr[i];
+        }
+        chx_rb_find_batch(keys, m, &root, key_cmp_func, out);
+        for (int i = 0; i < m; i++) {
+            if (out[i] != chx_rb_find(&karr[i], &root, key_cmp_func)) {
+                printf("失败 (键%d的批量查找结果错误)\n", karr[i]);
+                return 1;
+            }
+        }
+    }
+
+    clear_tree(&root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_batch(); }
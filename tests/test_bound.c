@@ -0,0 +1,104 @@
+#include "test_helper.h"
+
+#define N 1000
+#define MAX_KEY 200
+
+static int node_key(struct chx_rb_node* node) {
+    return chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+/* node 应是满足条件的第一个(或最后一个)节点, 没有时为 NULL */
+static bool bound_ok(struct chx_rb_node* node, int k, bool ge, bool strict,
+                     bool last, int* count) {
+    struct chx_rb_node* other;
+    bool any = false;
+
+    for (int key = 0; key < MAX_KEY; key++)
+        if (count[key] && (ge ? (strict ? key > k : key >= k)
+                              : (strict ? key < k : key <= k)))
+            any = true;
+    if (!node)
+        return !any;
+    if (ge ? (strict ? node_key(node) <= k : node_key(node) < k)
+           : (strict ? node_key(node) >= k : node_key(node) > k))
+        return false;
+    /* 相邻节点不能满足条件 */
+    other = last ? chx_rb_next(node) : chx_rb_prev(node);
+    if (!other)
+        return true;
+    return ge ? (strict ? node_key(other) <= k : node_key(other) < k)
+              : (strict ? node_key(other) >= k : node_key(other) > k);
+}
+
+/* 测试27: 上下界查找与区间遍历 */
+static int test_bound(void) {
+    printf("测试27: 上下界与区间遍历...");
+    struct chx_rb_root_cached root = CHX_RB_ROOT_CACHED;
+    int count[MAX_KEY] = {0};
+
+    srand(27);
+    for (int i = 0; i < N; i++) {
+        int key = rand() % MAX_KEY;
+
+        /* 留出一些空洞 */
+        if (key % 7 == 3)
+            continue;
+        count[key]++;
+        chx_rb_add_cached(&create_node(key)->rb, &root, less_func);
+    }
+
+    for (int k = -1; k <= MAX_KEY; k++) {
+        struct chx_rb_root* r = &root.rb_root;
+        struct chx_rb_node* lb = chx_rb_lower_bound(&k, r, key_cmp_func);
+        struct chx_rb_node* ub = chx_rb_upper_bound(&k, r, key_cmp_func);
+        struct chx_rb_node* fl = chx_rb_floor(&k, r, key_cmp_func);
+
+        if (!bound_ok(lb, k, true, false, false, count) ||
+            !bound_ok(ub, k, true, true, false, count) ||
+            !bound_ok(fl, k, false, false, true, count) ||
+            chx_rb_ceil(&k, r, key_cmp_func) != lb) {
+            printf("失败 (键%d的上下界错误)\n", k);
+            return 1;
+        }
+        if (chx_rb_lower_bound_cached(&k, &root, key_cmp_func) != lb ||
+            chx_rb_upper_bound_cached(&k, &root, key_cmp_func) != ub ||
+            chx_rb_floor_cached(&k, &root, key_cmp_func) != fl ||
+            chx_rb_ceil_cached(&k, &root, key_cmp_func) != lb) {
+            printf("失败 (键%d的cached上下界错误)\n", k);
+            return 1;
+        }
+    }
+
+    /* 区间 [lo, hi) 的节点数与计数一致, 包括 lo >= hi 的空区间 */
+    for (int lo = -1; lo <= MAX_KEY; lo += 3) {
+        for (int hi = -2; hi <= MAX_KEY + 1; hi += 5) {
+            struct chx_rb_node *node, *end;
+            int n = 0, expect = 0, prev = lo;
+
+            for (int key = lo < 0 ? 0 : lo; key < hi && key < MAX_KEY; key++)
+                expect += count[key];
+            chx_rb_for_each_range(node, end, &lo, &hi, &root.rb_root,
+                                  key_cmp_func) {
+                if (node_key(node) < prev || node_key(node) >= hi)
+                    break;
+                prev = node_key(node);
+                n++;
+            }
+            if (n != expect) {
+                printf("失败 (区间[%d, %d)有%d个节点, 期望%d)\n", lo, hi, n,
+                       expect);
+                return 1;
+            }
+            if (end != chx_rb_lower_bound(&hi, &root.rb_root, key_cmp_func)) {
+                printf("失败 (区间[%d, %d)的终点错误)\n", lo, hi);
+                return 1;
+            }
+        }
+    }
+
+    clear_tree(&root.rb_root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_bound(); }
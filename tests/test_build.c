@@ -0,0 +1,52 @@
+#include "test_helper.h"
+
+static struct chx_rb_node** make_sorted(int n) {
+    struct chx_rb_node** v = malloc((n ? n : 1) * sizeof(*v));
+    for (int i = 0; i < n; i++)
+        v[i] = &create_node(i)->rb;
+    return v;
+}
+
+/* 测试17: 从有序数组线性构建红黑树 */
+static int test_build(void) {
+    printf("测试17: 有序批量构建...");
+
+    for (int n = 0; n <= 300; n++) {
+        struct chx_rb_root root = CHX_RB_ROOT;
+        struct chx_rb_node** v = make_sorted(n);
+
+        chx_rb_build_sorted(v, n, &root);
+        if (!valid_tree(&root, n)) {
+            printf("失败 (n=%d 时树不合法)\n", n);
+            return 1;
+        }
+        /* 构建后的树可以继续正常插入删除 */
+        for (int i = 0; i < 20; i++)
+            chx_rb_add(&create_node(rand() % (n + 1))->rb, &root, less_func);
+        if (!valid_tree(&root, n + 20)) {
+            printf("失败 (n=%d 时插入后树不合法)\n", n);
+            return 1;
+        }
+        clear_tree(&root);
+        free(v);
+    }
+
+    /* cached 与并行版本 */
+    const int N = 200000;
+    struct chx_rb_root_cached croot = CHX_RB_ROOT_CACHED;
+    struct chx_rb_node** v = make_sorted(N);
+
+    chx_rb_build_sorted_parallel_cached(v, N, &croot, 4);
+    if (!valid_tree(&croot.rb_root, N) ||
+        chx_rb_first_cached(&croot) != chx_rb_first(&croot.rb_root)) {
+        printf("失败 (并行构建的树不合法)\n");
+        return 1;
+    }
+    clear_tree(&croot.rb_root);
+    free(v);
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_build(); }
@@ -0,0 +1,151 @@
+#include "test_helper.h"
+#include "rbtree_augmented.h"
+
+#define N 2000
+
+struct aug_node {
+    int key;
+    int max;
+    struct chx_rb_node rb;
+};
+
+#define aug_entry(n) chx_rb_entry(n, struct aug_node, rb)
+#define aug_key(n) aug_entry(n)->key
+
+static bool aug_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return aug_key(a) < aug_key(b);
+}
+
+static int aug_get_key(struct aug_node* n) { return n->key; }
+
+CHX_RB_DECLARE_CALLBACKS_MAX(static, aug_callbacks, struct aug_node, rb, int,
+                             max, aug_get_key)
+
+static int node_cmp(const struct chx_rb_node* a, const struct chx_rb_node* b) {
+    int ka = chx_rb_entry(a, struct test_node, rb)->key;
+    int kb = chx_rb_entry(b, struct test_node, rb)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static bool ends_ok(struct chx_rb_root_cached2* root) {
+    return chx_rb_first_cached2(root) == chx_rb_first(&root->rb_root) &&
+           chx_rb_last_cached2(root) == chx_rb_last(&root->rb_root);
+}
+
+/* 测试21: 同时缓存最左与最右节点 */
+static int test_cached2(void) {
+    printf("测试21: 双端cached版本...");
+    struct chx_rb_root_cached2 root = CHX_RB_ROOT_CACHED2;
+    struct test_node* nodes[N];
+    int n = 0;
+
+    srand(21);
+    if (chx_rb_first_cached2(&root) || chx_rb_last_cached2(&root)) {
+        printf("失败 (空树的缓存指针不为NULL)\n");
+        return 1;
+    }
+
+    /* 随机插入与删除, 每一步都与 first/last 比较 */
+    for (int step = 0; step < 20000; step++) {
+        if (n < N && (n == 0 || rand() % 3)) {
+            struct test_node* node = create_node(rand() % 500);
+            struct chx_rb_node* ret;
+
+            if (rand() % 2) {
+                bool end;
+
+                ret = chx_rb_add_cached2(&node->rb, &root, less_func);
+                end = chx_rb_first_cached2(&root) == &node->rb ||
+                      chx_rb_last_cached2(&root) == &node->rb;
+                if ((ret != NULL) != end) {
+                    printf("失败 (add_cached2返回值错误)\n");
+                    return 1;
+                }
+            } else {
+                ret = chx_rb_find_add_cached2(&node->rb, &root, node_cmp);
+                if (ret) {
+                    free(node);
+                    continue;
+                }
+            }
+            nodes[n++] = node;
+        } else {
+            /* 偏向从两端弹出 */
+            int r = rand() % 4, i;
+            struct chx_rb_node* victim;
+
+            if (r == 0)
+                victim = chx_rb_first_cached2(&root);
+            else if (r == 1)
+                victim = chx_rb_last_cached2(&root);
+            else
+                victim = &nodes[rand() % n]->rb;
+            for (i = 0; &nodes[i]->rb != victim; i++)
+                ;
+            chx_rb_erase_cached2(victim, &root);
+            free(nodes[i]);
+            nodes[i] = nodes[--n];
+        }
+        if (!ends_ok(&root) || verify_order(&root.rb_root) != n) {
+            printf("失败 (第%d步后缓存指针错误)\n", step);
+            return 1;
+        }
+    }
+
+    /* 替换两端节点 */
+    if (n > 1) {
+        struct chx_rb_node* ends[2] = {chx_rb_first_cached2(&root),
+                                       chx_rb_last_cached2(&root)};
+
+        for (int e = 0; e < 2; e++) {
+            struct test_node* old = chx_rb_entry(ends[e], struct test_node, rb);
+            struct test_node* new_node = create_node(old->key);
+
+            for (int i = 0; i < n; i++)
+                if (nodes[i] == old)
+                    nodes[i] = new_node;
+            chx_rb_replace_node_cached2(&old->rb, &new_node->rb, &root);
+            free(old);
+        }
+        if (!ends_ok(&root) ||
+            chx_rb_first_cached2(&root) == ends[0] ||
+            chx_rb_last_cached2(&root) == ends[1]) {
+            printf("失败 (替换后缓存指针错误)\n");
+            return 1;
+        }
+    }
+    clear_tree(&root.rb_root);
+
+    /* 增强版本: 子树最大值始终等于最右节点的键 */
+    struct chx_rb_root_cached2 aroot = CHX_RB_ROOT_CACHED2;
+    static struct aug_node anodes[N];
+
+    for (int i = 0; i < N; i++) {
+        anodes[i].key = anodes[i].max = rand() % 10000;
+        chx_rb_add_augmented_cached2(&anodes[i].rb, &aroot, aug_less,
+                                     &aug_callbacks);
+    }
+    /* 交替从两端弹出直到树为空 */
+    for (int i = 0; i < N; i++) {
+        struct chx_rb_node* top = aroot.rb_root.rb_node;
+
+        if (!ends_ok(&aroot) ||
+            aug_entry(top)->max != aug_key(chx_rb_last_cached2(&aroot))) {
+            printf("失败 (增强版本的缓存指针错误)\n");
+            return 1;
+        }
+        chx_rb_erase_augmented_cached2(i % 2 ? chx_rb_last_cached2(&aroot)
+                                             : chx_rb_first_cached2(&aroot),
+                                       &aroot, &aug_callbacks);
+    }
+    if (aroot.rb_root.rb_node || chx_rb_first_cached2(&aroot) ||
+        chx_rb_last_cached2(&aroot)) {
+        printf("失败 (清空后缓存指针不为NULL)\n");
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_cached2(); }
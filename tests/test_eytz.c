@@ -0,0 +1,97 @@
+#include "test_helper.h"
+#include "rbtree_eytz.h"
+#include <string.h>
+
+#define MAX_N 2000
+#define QUERIES 203
+
+struct u64_node {
+    uint64_t key;
+    struct chx_rb_node rb;
+};
+
+static struct u64_node nodes[MAX_N];
+
+#define u64_key(n) chx_rb_entry(n, struct u64_node, rb)->key
+
+static bool u64_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return u64_key(a) < u64_key(b);
+}
+
+static int u64_cmp(const void* key, const struct chx_rb_node* node) {
+    uint64_t k = *(const uint64_t*)key;
+    return k < u64_key(node) ? -1 : k > u64_key(node);
+}
+
+static uint64_t eytz_key(const struct chx_rb_node* node) {
+    return u64_key(node);
+}
+
+/* 高位也随机, 以覆盖无符号比较 */
+static uint64_t rand_key(int n) {
+    uint64_t hi = (uint64_t)(rand() % 4) << 62;
+
+    return hi | (uint64_t)(rand() % (n * 2 + 1));
+}
+
+/* 单个与批量查询, 标量与 SIMD, 都应与原树一致 */
+static bool check(struct chx_rb_root* root, int n) {
+    struct chx_rb_node *lb[QUERIES], *found[QUERIES], *out[QUERIES];
+    struct chx_rb_eytz eytz;
+    uint64_t keys[QUERIES];
+
+    if (!chx_rb_eytz_build(&eytz, root, eytz_key))
+        return false;
+    for (int q = 0; q < QUERIES; q++) {
+        /* 一半查询取树中已有的键 */
+        keys[q] = q % 2 && n ? nodes[rand() % n].key : rand_key(n);
+        if (q == QUERIES - 1)
+            keys[q] = UINT64_MAX;
+        lb[q] = chx_rb_lower_bound(&keys[q], root, u64_cmp);
+        found[q] = chx_rb_find(&keys[q], root, u64_cmp);
+        if (chx_rb_eytz_lower_bound(&eytz, keys[q]) != lb[q])
+            return false;
+        /* 有重复键时可能是另一个等值节点 */
+        if (!chx_rb_eytz_find(&eytz, keys[q]) != !found[q])
+            return false;
+    }
+
+    for (int simd = 0; simd <= 1; simd++) {
+        __chx_rb_eytz_batch(&eytz, keys, QUERIES, out, false, simd);
+        if (memcmp(out, lb, sizeof(out)))
+            return false;
+        __chx_rb_eytz_batch(&eytz, keys, QUERIES, out, true, simd);
+        for (int q = 0; q < QUERIES; q++)
+            if (!out[q] != !found[q] || (out[q] && u64_key(out[q]) != keys[q]))
+                return false;
+    }
+
+    chx_rb_eytz_destroy(&eytz);
+    return true;
+}
+
+/* 测试31: Eytzinger 导出与批量查询 */
+static int test_eytz(void) {
+    printf("测试31: Eytzinger导出...");
+    static const int sizes[] = {0, 1, 2, 3, 4, 7, 8, 100, 1023, MAX_N};
+
+    srand(31);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        struct chx_rb_root root = CHX_RB_ROOT;
+        int n = sizes[s];
+
+        for (int i = 0; i < n; i++) {
+            nodes[i].key = rand_key(n);
+            chx_rb_add(&nodes[i].rb, &root, u64_less);
+        }
+        if (!check(&root, n)) {
+            printf("失败 (%d个节点的导出查询结果错误)\n", n);
+            return 1;
+        }
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_eytz(); }
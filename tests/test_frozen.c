@@ -0,0 +1,73 @@
+#include "test_helper.h"
+#include "rbtree_frozen.h"
+
+#define MAX_N 3000
+
+static void frozen_key(void* dst, const struct chx_rb_node* node) {
+    *(int*)dst = chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+static int frozen_cmp(const void* key, const void* fkey) {
+    int a = *(const int*)key, b = *(const int*)fkey;
+    return a < b ? -1 : a > b;
+}
+
+/* 冻结后的查找, 下界与遍历应与原树一致 */
+static bool check(struct chx_rb_root* root, int max_key) {
+    struct chx_rb_frozen frozen;
+    struct chx_rb_node *node, *expect;
+    size_t rank;
+
+    if (!chx_rb_freeze(&frozen, root, sizeof(int), frozen_key))
+        return false;
+
+    expect = chx_rb_first(root);
+    chx_rb_frozen_for_each(node, rank, &frozen) {
+        if (node != expect)
+            break;
+        expect = chx_rb_next(expect);
+    }
+    if (expect || rank != chx_rb_frozen_count(&frozen))
+        return false;
+
+    for (int k = -1; k <= max_key; k++) {
+        struct chx_rb_node* lb = chx_rb_lower_bound(&k, root, key_cmp_func);
+        struct chx_rb_node* found = chx_rb_frozen_find(&frozen, &k, frozen_cmp);
+
+        rank = chx_rb_frozen_lower_bound(&frozen, &k, frozen_cmp);
+        if (chx_rb_frozen_node(&frozen, rank) != lb)
+            return false;
+        if (!found != !chx_rb_find(&k, root, key_cmp_func) ||
+            (found && chx_rb_entry(found, struct test_node, rb)->key != k))
+            return false;
+    }
+
+    chx_rb_frozen_destroy(&frozen);
+    return true;
+}
+
+/* 测试30: vEB 布局的冻结快照 */
+static int test_frozen(void) {
+    printf("测试30: 冻结快照...");
+    static const int sizes[] = {0, 1, 2, 3, 7, 8, 15, 100, 255, 256, MAX_N};
+    struct chx_rb_root root = CHX_RB_ROOT;
+
+    srand(30);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+
+        /* 键带重复和空洞 */
+        for (int i = 0; i < n; i++)
+            chx_rb_add(&create_node(rand() % (n * 2))->rb, &root, less_func);
+        if (!check(&root, n * 2)) {
+            printf("失败 (%d个节点的快照与原树不一致)\n", n);
+            return 1;
+        }
+        clear_tree(&root);
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_frozen(); }
@@ -1,4 +1,5 @@
 #include "test_helper.h"
+#include "rbtree_augmented.h"
 
 /* 比较函数 */
 bool less_func(struct chx_rb_node* a, const struct chx_rb_node* b) {
@@ -54,6 +55,36 @@ int verify_order(struct chx_rb_root* root) {
     return count;
 }
 
+/*
+ * 辅助函数：检查红黑树性质, 返回黑高, 出错返回 -1.
+ * parents 为 false 时不检查父指针 (持久化树的父字段存的是引用计数)
+ */
+int check_rb(const struct chx_rb_node* node,
+             const struct chx_rb_node* parent, bool parents) {
+    int lh, rh;
+
+    if (!node)
+        return 1;
+    if (parents && chx_rb_parent(node) != parent)
+        return -1;
+    if (chx_rb_is_red(node) &&
+        ((node->rb_left && chx_rb_is_red(node->rb_left)) ||
+         (node->rb_right && chx_rb_is_red(node->rb_right))))
+        return -1;
+    lh = check_rb(node->rb_left, node, parents);
+    rh = check_rb(node->rb_right, node, parents);
+    if (lh < 0 || lh != rh)
+        return -1;
+    return lh + chx_rb_is_black(node);
+}
+
+/* 辅助函数：根为黑, 红黑性质成立, 有序且恰有 n 个节点 */
+bool valid_tree(struct chx_rb_root* root, int n) {
+    if (root->rb_node && chx_rb_is_red(root->rb_node))
+        return false;
+    return check_rb(root->rb_node, NULL, true) > 0 && verify_order(root) == n;
+}
+
 /* 辅助函数：清空树 */
 void clear_tree(struct chx_rb_root* root) {
     struct chx_rb_node *node, *next;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "rbtree.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct test_node {
+    int key;
+    struct chx_rb_node rb;
+};
+
+bool less_func(struct chx_rb_node* a, const struct chx_rb_node* b);
+int cmp_func(struct chx_rb_node* a, const struct chx_rb_node* b);
+int key_cmp_func(const void* key, const struct chx_rb_node* node);
+struct test_node* create_node(int key);
+int verify_order(struct chx_rb_root* root);
+int check_rb(const struct chx_rb_node* node,
+             const struct chx_rb_node* parent, bool parents);
+bool valid_tree(struct chx_rb_root* root, int n);
+void clear_tree(struct chx_rb_root* root);
@@ -0,0 +1,201 @@
+#include "test_helper.h"
+#include "rbtree_idx_augmented.h"
+
+#define N 5000
+
+struct idx_item {
+    int key;
+    int max;
+    struct chx_rb_idx_node rb;
+};
+
+/* 下标 0 不参与建树 */
+static struct idx_item items[N + 1];
+static const struct chx_rb_idx_arena arena =
+    CHX_RB_IDX_ARENA(items, struct idx_item, rb);
+
+#define idx_key(n) chx_rb_entry(n, struct idx_item, rb)->key
+
+static bool idx_less(struct chx_rb_idx_node* a,
+                     const struct chx_rb_idx_node* b) {
+    return idx_key(a) < idx_key(b);
+}
+
+static int idx_cmp(struct chx_rb_idx_node* a, const struct chx_rb_idx_node* b) {
+    return idx_key(a) < idx_key(b) ? -1 : idx_key(a) > idx_key(b);
+}
+
+static int idx_key_cmp(const void* key, const struct chx_rb_idx_node* node) {
+    int k = *(const int*)key;
+    return k < idx_key(node) ? -1 : k > idx_key(node);
+}
+
+static int idx_get_key(struct idx_item* item) { return item->key; }
+
+CHX_RB_IDX_DECLARE_CALLBACKS_MAX(static, idx_max_cb, struct idx_item, rb, int,
+                                 max, idx_get_key)
+
+/* 检查红黑树性质, 返回黑高, 出错返回 -1 */
+static int check_idx(uint32_t node, uint32_t parent, bool augmented) {
+    struct chx_rb_idx_node* n;
+    int lh, rh;
+
+    if (!node)
+        return 1;
+    n = &items[node].rb;
+    if (chx_rb_idx_parent(n) != parent)
+        return -1;
+    if (chx_rb_idx_is_red(n) &&
+        ((n->rb_left && chx_rb_idx_is_red(&items[n->rb_left].rb)) ||
+         (n->rb_right && chx_rb_idx_is_red(&items[n->rb_right].rb))))
+        return -1;
+    if (augmented) {
+        int max = items[node].key;
+
+        if (n->rb_left && items[n->rb_left].max > max)
+            max = items[n->rb_left].max;
+        if (n->rb_right && items[n->rb_right].max > max)
+            max = items[n->rb_right].max;
+        if (items[node].max != max)
+            return -1;
+    }
+    lh = check_idx(n->rb_left, node, augmented);
+    rh = check_idx(n->rb_right, node, augmented);
+    if (lh < 0 || lh != rh)
+        return -1;
+    return lh + chx_rb_idx_is_black(n);
+}
+
+/* 正反两个方向遍历, 返回节点数, 顺序错误返回 -1 */
+static int walk(struct chx_rb_idx_root* root) {
+    int count = 0, back = 0;
+    uint32_t i, prev = CHX_RB_IDX_NIL;
+
+    for (i = chx_rb_idx_first(root, &arena); i;
+         i = chx_rb_idx_next(i, &arena)) {
+        if (prev && items[prev].key > items[i].key)
+            return -1;
+        prev = i;
+        count++;
+    }
+    for (i = chx_rb_idx_last(root, &arena); i; i = chx_rb_idx_prev(i, &arena))
+        back++;
+    return back == count ? count : -1;
+}
+
+/* 测试22: 32位下标节点 */
+static int test_idx(void) {
+    printf("测试22: 下标节点...");
+    struct chx_rb_idx_root_cached root = CHX_RB_IDX_ROOT_CACHED;
+    bool in[N + 1] = {false};
+    int n = 0;
+
+    if (sizeof(struct chx_rb_idx_node) != 12) {
+        printf("失败 (节点大小为%zu字节)\n", sizeof(struct chx_rb_idx_node));
+        return 1;
+    }
+
+    srand(22);
+    for (uint32_t i = 1; i <= N; i++) {
+        items[i].key = rand() % (N * 2);
+        CHX_RB_IDX_CLEAR_NODE(&items[i].rb);
+    }
+
+    /* 随机插入删除, cached 与普通接口混用 */
+    for (int step = 0; step < 4 * N; step++) {
+        uint32_t i = 1 + rand() % N;
+
+        if (!in[i]) {
+            if (rand() % 2) {
+                chx_rb_idx_add_cached(i, &root, &arena, idx_less);
+            } else if (chx_rb_idx_find_add(i, &root.rb_root, &arena,
+                                           idx_cmp)) {
+                continue;
+            } else {
+                root.rb_leftmost = chx_rb_idx_first(&root.rb_root, &arena);
+            }
+            in[i] = true;
+            n++;
+        } else {
+            chx_rb_idx_erase_cached(i, &root, &arena);
+            CHX_RB_IDX_CLEAR_NODE(&items[i].rb);
+            in[i] = false;
+            n--;
+        }
+        if (step % 97 == 0 &&
+            (check_idx(root.rb_root.rb_node, CHX_RB_IDX_NIL, false) < 0 ||
+             walk(&root.rb_root) != n ||
+             chx_rb_idx_first_cached(&root) !=
+                 chx_rb_idx_first(&root.rb_root, &arena))) {
+            printf("失败 (第%d步后树不合法)\n", step);
+            return 1;
+        }
+    }
+
+    /* 查找每个存在的键 */
+    for (uint32_t i = 1; i <= N; i++) {
+        uint32_t f;
+
+        if (!in[i])
+            continue;
+        f = chx_rb_idx_find(&items[i].key, &root.rb_root, &arena, idx_key_cmp);
+        if (!f || items[f].key != items[i].key) {
+            printf("失败 (找不到键%d)\n", items[i].key);
+            return 1;
+        }
+    }
+
+    /* 用空闲槽位替换一个节点 */
+    for (uint32_t i = 1, j = 1; i <= N && j <= N; i++) {
+        if (!in[i])
+            continue;
+        while (j <= N && in[j])
+            j++;
+        if (j > N)
+            break;
+        items[j].key = items[i].key;
+        chx_rb_idx_replace_node_cached(i, j, &root, &arena);
+        CHX_RB_IDX_CLEAR_NODE(&items[i].rb);
+        in[i] = false;
+        in[j] = true;
+        break;
+    }
+    if (check_idx(root.rb_root.rb_node, CHX_RB_IDX_NIL, false) < 0 ||
+        walk(&root.rb_root) != n) {
+        printf("失败 (替换后树不合法)\n");
+        return 1;
+    }
+
+    /* 后序遍历访问每个节点一次 */
+    int post = 0;
+    for (uint32_t i = chx_rb_idx_first_postorder(&root.rb_root, &arena); i;
+         i = chx_rb_idx_next_postorder(i, &arena))
+        post++;
+    if (post != n) {
+        printf("失败 (后序遍历节点数%d, 期望%d)\n", post, n);
+        return 1;
+    }
+
+    /* 增强版本: 维护子树最大键 */
+    struct chx_rb_idx_root_cached aroot = CHX_RB_IDX_ROOT_CACHED;
+
+    for (uint32_t i = 1; i <= N; i++) {
+        items[i].max = items[i].key;
+        chx_rb_idx_add_augmented_cached(i, &aroot, &arena, idx_less,
+                                        &idx_max_cb);
+    }
+    for (uint32_t i = 1; i <= N; i += 2)
+        chx_rb_idx_erase_augmented_cached(i, &aroot, &arena, &idx_max_cb);
+    if (check_idx(aroot.rb_root.rb_node, CHX_RB_IDX_NIL, true) < 0 ||
+        walk(&aroot.rb_root) != N / 2 ||
+        chx_rb_idx_first_cached(&aroot) !=
+            chx_rb_idx_first(&aroot.rb_root, &arena)) {
+        printf("失败 (增强版本树不合法)\n");
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_idx(); }
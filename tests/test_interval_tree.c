@@ -0,0 +1,98 @@
+#include "test_helper.h"
+#include "interval_tree_generic.h"
+
+#define NR_INTERVALS 2000
+#define NR_QUERIES 200
+#define NR_POINTS 300
+#define SPAN 100000
+
+struct itv_node {
+    unsigned long start, last;
+    unsigned long subtree_last;
+    struct chx_rb_node rb;
+};
+
+#define ITV_START(n) ((n)->start)
+#define ITV_LAST(n) ((n)->last)
+
+CHX_INTERVAL_TREE_DEFINE(struct itv_node, rb, unsigned long, subtree_last,
+                         ITV_START, ITV_LAST, static, itv)
+
+static struct itv_node nodes[NR_INTERVALS];
+static unsigned long hits[NR_POINTS];
+static const unsigned long* hits_points;
+
+static void count_hit(struct itv_node* node, size_t idx, void* ctx) {
+    (void)ctx;
+    /* 回调给出的区间必须包含该点 */
+    if (node->start <= hits_points[idx] && hits_points[idx] <= node->last)
+        hits[idx]++;
+}
+
+static int cmp_ul(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* 测试15: 区间树 */
+static int test_interval_tree(void) {
+    printf("测试15: 区间树...");
+    struct chx_rb_root_cached root = CHX_RB_ROOT_CACHED;
+    unsigned long points[NR_POINTS];
+
+    srand(15);
+    for (int i = 0; i < NR_INTERVALS; i++) {
+        nodes[i].start = rand() % SPAN;
+        nodes[i].last = nodes[i].start + rand() % 1000;
+        itv_insert(&nodes[i], &root);
+    }
+    /* 删除一半, 检查增强信息在删除后仍然正确 */
+    for (int i = 0; i < NR_INTERVALS; i += 2)
+        itv_remove(&nodes[i], &root);
+
+    /* 重叠查询与暴力扫描比较 */
+    for (int q = 0; q < NR_QUERIES; q++) {
+        unsigned long start = rand() % SPAN, last = start + rand() % 500;
+        int expect = 0, got = 0;
+        struct itv_node* n;
+
+        for (int i = 1; i < NR_INTERVALS; i += 2)
+            if (nodes[i].start <= last && start <= nodes[i].last)
+                expect++;
+        for (n = itv_iter_first(&root, start, last); n;
+             n = itv_iter_next(n, start, last)) {
+            if (!(n->start <= last && start <= n->last)) {
+                printf("失败 (返回了不重叠的区间)\n");
+                return 1;
+            }
+            got++;
+        }
+        if (got != expect) {
+            printf("失败 (查询结果数量错误: %d/%d)\n", got, expect);
+            return 1;
+        }
+    }
+
+    /* 批量点查询 */
+    for (int i = 0; i < NR_POINTS; i++)
+        points[i] = rand() % (SPAN + 1000);
+    qsort(points, NR_POINTS, sizeof(points[0]), cmp_ul);
+    hits_points = points;
+    itv_stab_batch(&root, points, NR_POINTS, count_hit, NULL);
+    for (int p = 0; p < NR_POINTS; p++) {
+        unsigned long expect = 0;
+        for (int i = 1; i < NR_INTERVALS; i += 2)
+            if (nodes[i].start <= points[p] && points[p] <= nodes[i].last)
+                expect++;
+        if (hits[p] != expect) {
+            printf("失败 (批量点查询错误: 点%lu %lu/%lu)\n", points[p],
+                   hits[p], expect);
+            return 1;
+        }
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_interval_tree(); }
@@ -0,0 +1,97 @@
+#include "test_helper.h"
+
+#define N 3000
+
+static struct test_node* sorted[N];
+
+static int node_key(struct chx_rb_node* node) {
+    return chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+/* 测试28: 基于栈的中序迭代器 */
+static int test_iter(void) {
+    printf("测试28: 栈迭代器...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_iter iter;
+    struct chx_rb_node* node;
+    int i, n = 0;
+
+    if (chx_rb_iter_first(&iter, &root) || chx_rb_iter_last(&iter, &root) ||
+        chx_rb_iter_next(&iter) || chx_rb_iter_prev(&iter)) {
+        printf("失败 (空树迭代结果不为NULL)\n");
+        return 1;
+    }
+
+    /* 偶数键, 含重复 */
+    srand(28);
+    for (i = 0; i < N; i++)
+        chx_rb_add(&create_node(rand() % N * 2)->rb, &root, less_func);
+    for (node = chx_rb_first(&root); node; node = chx_rb_next(node))
+        sorted[n++] = chx_rb_entry(node, struct test_node, rb);
+
+    /* 正向与反向都应与 chx_rb_next 的顺序相同 */
+    i = 0;
+    chx_rb_iter_for_each(node, &iter, &root) {
+        if (i >= n || node != &sorted[i]->rb)
+            break;
+        i++;
+    }
+    if (i != n || node) {
+        printf("失败 (正向迭代在第%d个节点出错)\n", i);
+        return 1;
+    }
+    i = n;
+    chx_rb_iter_for_each_reverse(node, &iter, &root) {
+        if (i <= 0 || node != &sorted[i - 1]->rb)
+            break;
+        i--;
+    }
+    if (i != 0 || node) {
+        printf("失败 (反向迭代在第%d个节点出错)\n", i);
+        return 1;
+    }
+
+    /* seek 到下界后可以向两个方向继续 */
+    for (int k = -1; k <= N * 2 + 1; k++) {
+        struct chx_rb_node* lb = chx_rb_lower_bound(&k, &root, key_cmp_func);
+
+        node = chx_rb_iter_seek(&iter, &k, &root, key_cmp_func);
+        if (node != lb) {
+            printf("失败 (seek到键%d的结果错误)\n", k);
+            return 1;
+        }
+        if (!lb)
+            continue;
+        for (i = 0; &sorted[i]->rb != lb; i++)
+            ;
+        node = chx_rb_iter_next(&iter);
+        if (node != (i + 1 < n ? &sorted[i + 1]->rb : NULL)) {
+            printf("失败 (seek到键%d后的next错误)\n", k);
+            return 1;
+        }
+        chx_rb_iter_seek(&iter, &k, &root, key_cmp_func);
+        if (chx_rb_iter_prev(&iter) != (i > 0 ? &sorted[i - 1]->rb : NULL) ||
+            (i > 0 && node_key(&sorted[i - 1]->rb) >= k)) {
+            printf("失败 (seek到键%d后的prev错误)\n", k);
+            return 1;
+        }
+    }
+
+    /* 来回走动 */
+    node = chx_rb_iter_first(&iter, &root);
+    for (i = 0; i < n / 2; i++)
+        node = chx_rb_iter_next(&iter);
+    for (int j = 0; j < 10; j++)
+        node = chx_rb_iter_prev(&iter);
+    if (node != &sorted[n / 2 - 10]->rb ||
+        chx_rb_iter_next(&iter) != &sorted[n / 2 - 9]->rb) {
+        printf("失败 (来回迭代结果错误)\n");
+        return 1;
+    }
+
+    clear_tree(&root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_iter(); }
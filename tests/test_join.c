@@ -0,0 +1,108 @@
+#include "test_helper.h"
+
+static int node_key(struct chx_rb_node* node) {
+    return chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+/* 按随机顺序插入 0..n-1, 每个键重复 dup 次 */
+static void fill_tree(struct chx_rb_root* root, int n, int dup) {
+    int* keys = malloc((n * dup + 1) * sizeof(*keys));
+
+    for (int i = 0; i < n * dup; i++)
+        keys[i] = i / dup;
+    for (int i = n * dup - 1; i > 0; i--) {
+        int j = rand() % (i + 1), t = keys[i];
+        keys[i] = keys[j];
+        keys[j] = t;
+    }
+    for (int i = 0; i < n * dup; i++)
+        chx_rb_add(&create_node(keys[i])->rb, root, less_func);
+    free(keys);
+}
+
+/* 测试19: 红黑树的拆分与合并 */
+static int test_join(void) {
+    printf("测试19: 拆分与合并...");
+
+    /* 在每个位置拆分, 再无枢轴地拼回去 */
+    for (int n = 0; n <= 120; n++) {
+        for (int dup = 1; dup <= 2; dup++) {
+            for (int k = -1; k <= n + 1; k++) {
+                struct chx_rb_root lt = CHX_RB_ROOT, ge = CHX_RB_ROOT;
+                int cut = k < 0 ? 0 : (k > n ? n : k);
+
+                fill_tree(&lt, n, dup);
+                chx_rb_split(&lt, &k, key_cmp_func, &ge);
+                if (!valid_tree(&lt, cut * dup) ||
+                    !valid_tree(&ge, (n - cut) * dup) ||
+                    (lt.rb_node && node_key(chx_rb_last(&lt)) >= k) ||
+                    (ge.rb_node && node_key(chx_rb_first(&ge)) < k)) {
+                    printf("失败 (n=%d k=%d 拆分结果错误)\n", n, k);
+                    return 1;
+                }
+                chx_rb_join(&lt, NULL, &ge);
+                if (!valid_tree(&lt, n * dup) || ge.rb_node) {
+                    printf("失败 (n=%d k=%d 拼接结果错误)\n", n, k);
+                    return 1;
+                }
+                clear_tree(&lt);
+            }
+        }
+    }
+
+    /* 两侧大小相差悬殊时带枢轴合并 */
+    for (int a = 0; a <= 200; a += 7) {
+        for (int b = 0; b <= 200; b += 13) {
+            struct chx_rb_root left = CHX_RB_ROOT, right = CHX_RB_ROOT;
+            struct test_node* pivot = create_node(a);
+
+            for (int i = 0; i < a; i++)
+                chx_rb_add(&create_node(i)->rb, &left, less_func);
+            for (int i = 0; i < b; i++)
+                chx_rb_add(&create_node(a + 1 + i)->rb, &right, less_func);
+            chx_rb_join(&left, &pivot->rb, &right);
+            if (!valid_tree(&left, a + b + 1) || right.rb_node) {
+                printf("失败 (a=%d b=%d 合并结果错误)\n", a, b);
+                return 1;
+            }
+            clear_tree(&left);
+        }
+    }
+
+    /* cached 版本, 以及大树上的反复拆分合并 */
+    const int N = 100000;
+    struct chx_rb_root_cached tree = CHX_RB_ROOT_CACHED;
+    struct chx_rb_root_cached ge = CHX_RB_ROOT_CACHED;
+
+    fill_tree(&tree.rb_root, N, 1);
+    tree.rb_leftmost = chx_rb_first(&tree.rb_root);
+    for (int round = 0; round < 1000; round++) {
+        int k = rand() % (N + 2) - 1;
+        int cut = k < 0 ? 0 : (k > N ? N : k);
+
+        chx_rb_split_cached(&tree, &k, key_cmp_func, &ge);
+        if (chx_rb_first_cached(&tree) != chx_rb_first(&tree.rb_root) ||
+            chx_rb_first_cached(&ge) != chx_rb_first(&ge.rb_root) ||
+            (round % 100 == 0 && (!valid_tree(&tree.rb_root, cut) ||
+                                  !valid_tree(&ge.rb_root, N - cut)))) {
+            printf("失败 (k=%d cached 拆分结果错误)\n", k);
+            return 1;
+        }
+        chx_rb_join_cached(&tree, NULL, &ge);
+        if (chx_rb_first_cached(&tree) != chx_rb_first(&tree.rb_root) ||
+            chx_rb_first_cached(&ge)) {
+            printf("失败 (k=%d cached 拼接结果错误)\n", k);
+            return 1;
+        }
+    }
+    if (!valid_tree(&tree.rb_root, N)) {
+        printf("失败 (反复拆分合并后树不合法)\n");
+        return 1;
+    }
+    clear_tree(&tree.rb_root);
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_join(); }
@@ -0,0 +1,104 @@
+#include "test_helper.h"
+#include "rbtree_latch.h"
+#include <pthread.h>
+
+struct latch_node {
+    int key;
+    struct chx_latch_tree_node lt;
+};
+
+static bool latch_less(struct chx_latch_tree_node* a,
+                       struct chx_latch_tree_node* b) {
+    return container_of(a, struct latch_node, lt)->key <
+           container_of(b, struct latch_node, lt)->key;
+}
+
+static int latch_comp(const void* key, struct chx_latch_tree_node* b) {
+    int k = *(const int*)key;
+    int bk = container_of(b, struct latch_node, lt)->key;
+    return k < bk ? -1 : k > bk;
+}
+
+static const struct chx_latch_tree_ops latch_ops = {
+    .less = latch_less,
+    .comp = latch_comp,
+};
+
+#define NR_STABLE 64
+#define NR_CHURN 256
+
+static struct chx_latch_tree_root ltr;
+static struct latch_node stable[NR_STABLE], churn[NR_CHURN];
+static volatile int stop;
+static volatile long misses, lookups;
+
+/* 读者: 稳定的键必须始终能找到 */
+static void* reader(void* arg __attribute__((unused))) {
+    long miss = 0, n = 0;
+
+    while (!stop) {
+        for (int i = 0; i < NR_STABLE; i++) {
+            int key = stable[i].key;
+            struct chx_latch_tree_node* found =
+                chx_latch_tree_find(&key, &ltr, &latch_ops);
+            if (!found || container_of(found, struct latch_node, lt) !=
+                              &stable[i])
+                miss++;
+            n++;
+        }
+    }
+    misses = miss;
+    lookups = n;
+    return NULL;
+}
+
+/* 测试13: latch tree 无锁精确查找 */
+static int test_latch(void) {
+    printf("测试13: latch tree...");
+    pthread_t tid;
+
+    ltr = CHX_LATCH_TREE_ROOT;
+    for (int i = 0; i < NR_STABLE; i++) {
+        stable[i].key = i * 2 * NR_CHURN / NR_STABLE;
+        chx_latch_tree_insert(&stable[i].lt, &ltr, &latch_ops);
+    }
+    for (int i = 0; i < NR_CHURN; i++)
+        churn[i].key = i * 2 + 1;
+
+    /* 单线程: 插入后可找到, 删除后找不到 */
+    chx_latch_tree_insert(&churn[0].lt, &ltr, &latch_ops);
+    int key = churn[0].key;
+    if (!chx_latch_tree_find(&key, &ltr, &latch_ops)) {
+        printf("失败 (未找到刚插入的键)\n");
+        return 1;
+    }
+    chx_latch_tree_erase(&churn[0].lt, &ltr, &latch_ops);
+    if (chx_latch_tree_find(&key, &ltr, &latch_ops)) {
+        printf("失败 (删除后仍能找到)\n");
+        return 1;
+    }
+
+    /* 并发: 写者不断插入删除, 读者查找稳定的键 */
+    if (pthread_create(&tid, NULL, reader, NULL)) {
+        printf("失败 (pthread_create)\n");
+        return 1;
+    }
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < NR_CHURN; i++)
+            chx_latch_tree_insert(&churn[i].lt, &ltr, &latch_ops);
+        for (int i = 0; i < NR_CHURN; i++)
+            chx_latch_tree_erase(&churn[i].lt, &ltr, &latch_ops);
+    }
+    stop = 1;
+    pthread_join(tid, NULL);
+
+    if (misses) {
+        printf("失败 (%ld/%ld 次查找漏掉了存在的键)\n", misses, lookups);
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_latch(); }
@@ -0,0 +1,163 @@
+#include "test_helper.h"
+#include "rbtree_mmap.h"
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#define N 3000
+#define PATH "test_mmap.map"
+
+/* 每条记录的数据: 键及其在原树中的位置 */
+struct record {
+    int key;
+    int pos;
+};
+
+static int node_pos(const struct chx_rb_node* node) {
+    int pos = 0;
+
+    for (node = chx_rb_prev(node); node; node = chx_rb_prev(node))
+        pos++;
+    return pos;
+}
+
+static void write_record(void* dst, const struct chx_rb_node* node) {
+    struct record* r = dst;
+
+    r->key = chx_rb_entry(node, struct test_node, rb)->key;
+    r->pos = node_pos(node);
+}
+
+static void write_key(void* dst, const struct chx_rb_node* node) {
+    *(int*)dst = chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+static int record_cmp(const void* key, const void* data) {
+    int k = *(const int*)key, rk = ((const struct record*)data)->key;
+    return k < rk ? -1 : k > rk;
+}
+
+static int record_key(const struct chx_rb_map_node* node) {
+    return ((const struct record*)chx_rb_map_data(node))->key;
+}
+
+static int record_pos(const struct chx_rb_map_node* node) {
+    return ((const struct record*)chx_rb_map_data(node))->pos;
+}
+
+/* 映射应与原树的顺序, 链接和查找结果一致 */
+static bool check(const struct chx_rb_map* map, struct chx_rb_root* root) {
+    const struct chx_rb_map_node* node;
+    struct chx_rb_node* rb = chx_rb_first(root);
+    int pos = 0;
+
+    chx_rb_map_for_each(node, map) {
+        const struct chx_rb_map_node* left = chx_rb_map_left(node);
+        const struct chx_rb_map_node* right = chx_rb_map_right(node);
+        const struct record* r = chx_rb_map_data(node);
+
+        if (!rb || r->key != chx_rb_entry(rb, struct test_node, rb)->key ||
+            r->pos != pos)
+            return false;
+        if ((left && chx_rb_map_parent(left) != node) ||
+            (right && chx_rb_map_parent(right) != node))
+            return false;
+        rb = chx_rb_next(rb);
+        pos++;
+    }
+    if (rb || (size_t)pos != chx_rb_map_count(map) ||
+        (chx_rb_map_root(map) && chx_rb_map_parent(chx_rb_map_root(map))))
+        return false;
+
+    for (int k = -1; k <= N * 2; k++) {
+        struct chx_rb_node* lb = chx_rb_lower_bound(&k, root, key_cmp_func);
+        const struct chx_rb_map_node* found =
+            chx_rb_map_find(map, &k, record_cmp);
+
+        node = chx_rb_map_lower_bound(map, &k, record_cmp);
+        if (!lb != !node || (node && record_pos(node) != node_pos(lb)))
+            return false;
+        if (!found != !chx_rb_find(&k, root, key_cmp_func) ||
+            (found && record_key(found) != k))
+            return false;
+    }
+    return true;
+}
+
+/* 测试32: 可映射的树文件 */
+static int test_mmap(void) {
+    printf("测试32: 树文件映射...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_map map, old;
+    uint64_t off;
+    FILE* f;
+
+    /* 空树 */
+    if (!chx_rb_map_write(&root, PATH, sizeof(struct record), write_record) ||
+        !chx_rb_map_open(&map, PATH) || chx_rb_map_first(&map) ||
+        !check(&map, &root)) {
+        printf("失败 (空树文件错误)\n");
+        return 1;
+    }
+    chx_rb_map_close(&map);
+
+    srand(32);
+    for (int i = 0; i < N; i++)
+        chx_rb_add(&create_node(rand() % (N * 2))->rb, &root, less_func);
+    if (!chx_rb_map_write(&root, PATH, sizeof(struct record), write_record) ||
+        !chx_rb_map_open(&map, PATH)) {
+        printf("失败 (写入或映射失败)\n");
+        return 1;
+    }
+    if (!check(&map, &root)) {
+        printf("失败 (映射内容与原树不一致)\n");
+        return 1;
+    }
+
+    /* 替换文件后, 已有的映射不受影响 */
+    old = map;
+    if (!chx_rb_map_write(&root, PATH, sizeof(int), write_key) ||
+        !chx_rb_map_open(&map, PATH) ||
+        chx_rb_map_header(&map)->data_size != sizeof(int) ||
+        !check(&old, &root)) {
+        printf("失败 (替换文件影响了旧映射)\n");
+        return 1;
+    }
+    chx_rb_map_close(&old);
+    chx_rb_map_close(&map);
+
+    /* 根偏移不在记录边界上 */
+    if (!chx_rb_map_write(&root, PATH, sizeof(int), write_key)) {
+        printf("失败 (写入文件失败)\n");
+        return 1;
+    }
+    f = fopen(PATH, "r+");
+    fseek(f, offsetof(struct chx_rb_map_header, root), SEEK_SET);
+    fread(&off, sizeof(off), 1, f);
+    off += 8;
+    fseek(f, offsetof(struct chx_rb_map_header, root), SEEK_SET);
+    fwrite(&off, sizeof(off), 1, f);
+    fclose(f);
+    if (chx_rb_map_open(&map, PATH) || errno != EINVAL) {
+        printf("失败 (接受了根偏移未对齐的文件)\n");
+        return 1;
+    }
+
+    /* 格式错误的文件 */
+    f = fopen(PATH, "w");
+    for (int i = 0; i < 100; i++)
+        fputs("not a tree ", f);
+    fclose(f);
+    if (chx_rb_map_open(&map, PATH) || errno != EINVAL) {
+        printf("失败 (接受了格式错误的文件)\n");
+        return 1;
+    }
+
+    unlink(PATH);
+    clear_tree(&root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_mmap(); }
@@ -0,0 +1,82 @@
+#include "test_helper.h"
+#include "rbtree_order.h"
+
+#define N 2000
+
+struct os_test_node {
+    int key;
+    struct chx_rb_os_node os;
+};
+
+#define os_key(n) chx_rb_entry(n, struct os_test_node, os.rb)->key
+
+static bool os_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return os_key(a) < os_key(b);
+}
+
+static int os_key_cmp(const void* key, const struct chx_rb_node* node) {
+    int k = *(const int*)key;
+    return k < os_key(node) ? -1 : k > os_key(node);
+}
+
+static struct os_test_node nodes[N];
+static bool present[N];
+
+/* 测试16: 顺序统计树 select/rank/count_range */
+static int test_order(void) {
+    printf("测试16: 顺序统计树...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    size_t expect = 0;
+
+    srand(16);
+    for (int i = 0; i < N; i++) {
+        nodes[i].key = rand() % (N * 4);
+        chx_rb_os_add(&nodes[i].os, &root, os_less);
+        present[i] = true;
+    }
+    for (int i = 0; i < N; i += 3) {
+        chx_rb_os_erase(&nodes[i].os, &root);
+        present[i] = false;
+    }
+    for (int i = 0; i < N; i++)
+        expect += present[i];
+
+    if (chx_rb_os_count(&root) != expect) {
+        printf("失败 (节点数错误: %zu/%zu)\n", chx_rb_os_count(&root), expect);
+        return 1;
+    }
+
+    /* select(k) 与中序遍历的第 k 个一致, rank 是其逆 */
+    size_t k = 0;
+    for (struct chx_rb_node* rb = chx_rb_first(&root); rb;
+         rb = chx_rb_next(rb), k++) {
+        struct chx_rb_os_node* sel = chx_rb_os_select(&root, k);
+        if (&sel->rb != rb || chx_rb_os_rank(sel) != k) {
+            printf("失败 (select/rank 错误 k=%zu)\n", k);
+            return 1;
+        }
+    }
+    if (chx_rb_os_select(&root, k)) {
+        printf("失败 (越界 select 应返回NULL)\n");
+        return 1;
+    }
+
+    /* count_range 与暴力统计比较 */
+    for (int q = 0; q < 200; q++) {
+        int lo = rand() % (N * 4), hi = lo + rand() % N;
+        size_t brute = 0;
+        for (int i = 0; i < N; i++)
+            if (present[i] && nodes[i].key >= lo && nodes[i].key < hi)
+                brute++;
+        size_t got = chx_rb_os_count_range(&lo, &hi, &root, os_key_cmp);
+        if (got != brute) {
+            printf("失败 (count_range 错误: %zu/%zu)\n", got, brute);
+            return 1;
+        }
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_order(); }
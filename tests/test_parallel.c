@@ -0,0 +1,155 @@
+#include "test_helper.h"
+#include "rbtree_order.h"
+#include <limits.h>
+
+#define N 200000
+#define THREADS 4
+
+struct os_test_node {
+    int key;
+    struct chx_rb_os_node os;
+};
+
+/* 按顺序的归约: 区间首尾与节点数 */
+struct span {
+    long first, last, count;
+    bool ok;
+};
+
+struct walk {
+    int (*key)(struct chx_rb_node* node);
+    long count, sum;
+};
+
+static struct os_test_node os_nodes[N];
+
+static int node_key(struct chx_rb_node* node) {
+    return chx_rb_entry(node, struct test_node, rb)->key;
+}
+
+static int os_key(struct chx_rb_node* node) {
+    return chx_rb_entry(node, struct os_test_node, os.rb)->key;
+}
+
+static bool os_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return os_key(a) < os_key((struct chx_rb_node*)b);
+}
+
+static void visit(struct chx_rb_node* node, void* ctx) {
+    struct walk* w = ctx;
+
+    __atomic_fetch_add(&w->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->sum, w->key(node), __ATOMIC_RELAXED);
+}
+
+static void fold(void* acc, struct chx_rb_node* node, void* ctx) {
+    struct span* s = acc;
+    long key = ((struct walk*)ctx)->key(node);
+
+    if (!s->count)
+        s->first = key;
+    else if (key < s->last)
+        s->ok = false;
+    s->last = key;
+    s->count++;
+}
+
+static void combine(void* acc, const void* right, void* ctx) {
+    struct span* s = acc;
+    const struct span* r = right;
+
+    (void)ctx;
+    if (!r->count)
+        return;
+    if (!s->count) {
+        *s = *r;
+        return;
+    }
+    s->ok = s->ok && r->ok && s->last <= r->first;
+    s->last = r->last;
+    s->count += r->count;
+}
+
+/* 并行遍历与顺序归约的结果应与顺序遍历一致 */
+static bool check(struct chx_rb_root* root, int (*key)(struct chx_rb_node*),
+                  bool os, unsigned nthreads, long count, long sum) {
+    struct walk w = {key, 0, 0};
+    struct span s = {0, 0, 0, true};
+
+    if (os)
+        chx_rb_os_parallel_for_each(root, visit, &w, nthreads);
+    else
+        chx_rb_parallel_for_each(root, visit, &w, nthreads);
+    if (w.count != count || w.sum != sum)
+        return false;
+
+    if (os)
+        chx_rb_os_parallel_reduce(root, fold, combine, &s, sizeof(s), &w,
+                                  nthreads);
+    else
+        chx_rb_parallel_reduce(root, fold, combine, &s, sizeof(s), &w,
+                               nthreads);
+    if (!count)
+        return !s.count;
+    return s.ok && s.count == count &&
+           s.first == key(chx_rb_first(root)) &&
+           s.last == key(chx_rb_last(root));
+}
+
+/* 测试29: 并行遍历与归约 */
+static int test_parallel(void) {
+    printf("测试29: 并行遍历与归约...");
+    struct chx_rb_root root = CHX_RB_ROOT, os_root = CHX_RB_ROOT;
+    long sum = 0;
+
+    if (!check(&root, node_key, false, THREADS, 0, 0)) {
+        printf("失败 (空树结果错误)\n");
+        return 1;
+    }
+
+    srand(29);
+    for (int i = 0; i < N; i++) {
+        int key = rand() % (N * 2);
+
+        chx_rb_add(&create_node(key)->rb, &root, less_func);
+        os_nodes[i].key = key;
+        chx_rb_os_add(&os_nodes[i].os, &os_root, os_less);
+        sum += key;
+    }
+
+    for (unsigned t = 1; t <= THREADS; t++) {
+        if (!check(&root, node_key, false, t, N, sum)) {
+            printf("失败 (%u线程结果错误)\n", t);
+            return 1;
+        }
+        if (!check(&os_root, os_key, true, t, N, sum)) {
+            printf("失败 (顺序统计树%u线程结果错误)\n", t);
+            return 1;
+        }
+    }
+
+    /* 线程数过大时被限制, 不会耗尽栈 */
+    if (!check(&root, node_key, false, UINT_MAX, N, sum) ||
+        !check(&os_root, os_key, true, 1u << 20, N, sum)) {
+        printf("失败 (线程数过大时结果错误)\n");
+        return 1;
+    }
+
+    /* 小树走单线程路径 */
+    clear_tree(&root);
+    sum = 0;
+    for (int i = 0; i < 100; i++) {
+        chx_rb_add(&create_node(i)->rb, &root, less_func);
+        sum += i;
+    }
+    if (!check(&root, node_key, false, THREADS, 100, sum)) {
+        printf("失败 (小树结果错误)\n");
+        return 1;
+    }
+
+    clear_tree(&root);
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_parallel(); }
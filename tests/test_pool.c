@@ -0,0 +1,172 @@
+#include "test_helper.h"
+#include "rbtree_pool.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#define NTHREADS 4
+#define PER_THREAD 20000
+
+struct big_node {
+    int key;
+    struct chx_rb_node rb;
+    char payload[100];
+};
+
+struct pool_worker {
+    struct chx_rb_pool* pool;
+    struct chx_rb_pool_mag mag;
+    struct chx_rb_root root;
+    int base;
+    int count;
+};
+
+static void* pool_worker_run(void* arg) {
+    struct pool_worker* w = arg;
+    struct chx_rb_node *node, *next;
+
+    chx_rb_pool_register(w->pool, &w->mag);
+    w->count = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < PER_THREAD; i++) {
+            struct test_node* tn = chx_rb_pool_new(&w->mag, struct test_node);
+
+            if (!tn)
+                return NULL;
+            tn->key = w->base + i;
+            chx_rb_add(&tn->rb, &w->root, less_func);
+            w->count++;
+        }
+        /* 删除一半, 下一轮会复用这些节点 */
+        for (node = chx_rb_first(&w->root); node; node = next) {
+            struct test_node* tn = chx_rb_entry(node, struct test_node, rb);
+
+            next = chx_rb_next(node);
+            if (tn->key % 2) {
+                chx_rb_erase(node, &w->root);
+                chx_rb_pool_delete(&w->mag, tn);
+                w->count--;
+            }
+        }
+    }
+    return NULL;
+}
+
+#define NRELEASE 1000
+
+static struct test_node* released[NRELEASE];
+
+/* 后序: 子节点必须先于父节点释放 */
+static void release_node(struct chx_rb_node* node, void* ctx) {
+    int* count = ctx;
+
+    if ((node->rb_left &&
+         chx_rb_entry(node->rb_left, struct test_node, rb)->key != -1) ||
+        (node->rb_right &&
+         chx_rb_entry(node->rb_right, struct test_node, rb)->key != -1)) {
+        *count = -NRELEASE;
+        return;
+    }
+    chx_rb_entry(node, struct test_node, rb)->key = -1;
+    if (*count >= 0)
+        released[*count] = chx_rb_entry(node, struct test_node, rb);
+    (*count)++;
+}
+
+/* 测试23: 节点内存池与整树销毁 */
+static int test_pool(void) {
+    printf("测试23: 节点内存池...");
+    struct chx_rb_pool pool;
+    struct chx_rb_pool_mag mag;
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct test_node* first;
+    struct big_node* big;
+
+    chx_rb_pool_init(&pool);
+    chx_rb_pool_register(&pool, &mag);
+
+    if (chx_rb_pool_alloc(&mag, 0) ||
+        chx_rb_pool_alloc(&mag, CHX_RB_POOL_MAX_SIZE + 1)) {
+        printf("失败 (超出范围的大小未返回NULL)\n");
+        return 1;
+    }
+
+    /* 释放后立即复用同一个对象 */
+    first = chx_rb_pool_new(&mag, struct test_node);
+    chx_rb_pool_delete(&mag, first);
+    if (chx_rb_pool_new(&mag, struct test_node) != first) {
+        printf("失败 (释放的对象未被复用)\n");
+        return 1;
+    }
+
+    /* 两种大小的节点混合在同一个池中 */
+    for (int i = 0; i < 10000; i++) {
+        struct test_node* tn = chx_rb_pool_new(&mag, struct test_node);
+
+        big = chx_rb_pool_new(&mag, struct big_node);
+        if (!tn || !big || (uintptr_t)tn % CHX_RB_POOL_ALIGN ||
+            (uintptr_t)big % CHX_RB_POOL_ALIGN) {
+            printf("失败 (分配失败或未对齐)\n");
+            return 1;
+        }
+        tn->key = i;
+        big->key = -i;
+        chx_rb_add(&tn->rb, &root, less_func);
+        chx_rb_pool_delete(&mag, big);
+    }
+    if (verify_order(&root) != 10000) {
+        printf("失败 (树中节点被破坏)\n");
+        return 1;
+    }
+
+    /* 每个线程使用自己的 magazine, 节点随整池销毁 */
+    struct pool_worker workers[NTHREADS];
+    pthread_t tids[NTHREADS];
+
+    for (int t = 0; t < NTHREADS; t++) {
+        workers[t] = (struct pool_worker){
+            .pool = &pool, .root = CHX_RB_ROOT, .base = t * PER_THREAD};
+        pthread_create(&tids[t], NULL, pool_worker_run, &workers[t]);
+    }
+    for (int t = 0; t < NTHREADS; t++)
+        pthread_join(tids[t], NULL);
+    for (int t = 0; t < NTHREADS; t++) {
+        struct pool_worker* w = &workers[t];
+        struct chx_rb_node* node;
+        int n = 0, expect = PER_THREAD / 2 * 3;
+
+        for (node = chx_rb_first(&w->root); node; node = chx_rb_next(node)) {
+            int key = chx_rb_entry(node, struct test_node, rb)->key;
+
+            if (key < w->base || key >= w->base + PER_THREAD || key % 2)
+                break;
+            n++;
+        }
+        if (n != expect || w->count != expect) {
+            printf("失败 (线程%d的树有%d个节点, 期望%d)\n", t, n, expect);
+            return 1;
+        }
+        chx_rb_pool_unregister(&w->mag);
+    }
+
+    /* 整池销毁, 不逐个删除节点 */
+    chx_rb_pool_destroy(&pool);
+    root = CHX_RB_ROOT;
+
+    /* 非池化的树: 后序释放, 不做平衡 */
+    srand(23);
+    for (int i = 0; i < NRELEASE; i++)
+        chx_rb_add(&create_node(rand())->rb, &root, less_func);
+    int count = 0;
+    chx_rb_destroy(&root, release_node, &count);
+    if (count != NRELEASE || root.rb_node) {
+        printf("失败 (后序销毁了%d个节点, 期望%d)\n", count, NRELEASE);
+        return 1;
+    }
+    for (int i = 0; i < NRELEASE; i++)
+        free(released[i]);
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_pool(); }
@@ -0,0 +1,53 @@
+#include "test_helper.h"
+
+#define N 3000
+
+/* 测试25: 预取版本的插入与查找 */
+static int test_prefetch(void) {
+    printf("测试25: 预取版本...");
+
+    for (unsigned depth = 1; depth <= 2; depth++) {
+        struct chx_rb_root root = CHX_RB_ROOT;
+        struct chx_rb_root_cached croot = CHX_RB_ROOT_CACHED;
+
+        srand(25);
+        for (int i = 0; i < N; i++) {
+            struct test_node* node = create_node(rand() % (N * 2));
+
+            if (i % 2) {
+                chx_rb_add_prefetch(&node->rb, &root, less_func, depth);
+            } else if (chx_rb_find_add_prefetch(&node->rb, &root, cmp_func,
+                                                depth)) {
+                free(node);
+            }
+            chx_rb_add_cached_prefetch(&create_node(i)->rb, &croot, less_func,
+                                       depth);
+        }
+        if (verify_order(&root) < 0 || verify_order(&croot.rb_root) != N ||
+            chx_rb_first_cached(&croot) != chx_rb_first(&croot.rb_root)) {
+            printf("失败 (插入后树不合法, depth=%u)\n", depth);
+            return 1;
+        }
+
+        /* 与普通 chx_rb_find 的结果一致 */
+        for (int k = 0; k < N * 2; k++) {
+            struct chx_rb_node* found =
+                chx_rb_find_prefetch(&k, &root, key_cmp_func, depth);
+            struct chx_rb_node* expect = chx_rb_find(&k, &root, key_cmp_func);
+            int got =
+                found ? chx_rb_entry(found, struct test_node, rb)->key : k;
+
+            if (!found != !expect || got != k) {
+                printf("失败 (查找键%d结果错误, depth=%u)\n", k, depth);
+                return 1;
+            }
+        }
+        clear_tree(&root);
+        clear_tree(&croot.rb_root);
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_prefetch(); }
@@ -0,0 +1,127 @@
+#include "test_helper.h"
+#include "rbtree_augmented.h"
+#include "rbtree_profile.h"
+#include "rbtree_rcu.h"
+#include <stdint.h>
+
+#define N 10000
+
+static struct test_node nodes[N], rcu_nodes[N];
+static struct chx_rb_root rcu_root = CHX_RB_ROOT;
+static struct chx_rb_rcu_domain domain;
+static volatile int stop;
+
+/* 后台线程在写者插入的同时反复剖析树 */
+static void* monitor(void* arg) {
+    struct chx_rb_rcu_reader self;
+    struct chx_rb_profile report;
+    long* bad = arg;
+
+    chx_rb_rcu_register(&domain, &self);
+    while (!stop) {
+        chx_rb_rcu_read_lock(&self);
+        chx_rb_profile_rcu(&rcu_root, &report);
+        chx_rb_rcu_read_unlock(&self);
+        if (report.count > N || report.max_depth > CHX_RB_ITER_DEPTH)
+            (*bad)++;
+    }
+    chx_rb_rcu_unregister(&self);
+    return NULL;
+}
+
+static size_t count_red(const struct chx_rb_node* node) {
+    if (!node)
+        return 0;
+    return chx_rb_is_red(node) + count_red(node->rb_left) +
+           count_red(node->rb_right);
+}
+
+/* 测试35: 树形剖析 */
+static int test_profile(void) {
+    printf("测试35: 树形剖析...");
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_profile report, after;
+    struct chx_rb_node* node;
+    uintptr_t lo, hi;
+    size_t sum = 0;
+    unsigned log2n = 0;
+    pthread_t tid;
+    long bad = 0;
+
+    chx_rb_profile(&root, &report);
+    if (report.count || report.max_depth || report.black_height ||
+        report.span_lines || !report.valid) {
+        printf("失败 (空树报告错误)\n");
+        return 1;
+    }
+
+    srand(35);
+    for (int i = 0; i < N; i++) {
+        nodes[i].key = rand();
+        chx_rb_add(&nodes[i].rb, &root, less_func);
+    }
+    chx_rb_profile(&root, &report);
+    for (unsigned d = 0; d < CHX_RB_PROFILE_DEPTHS; d++)
+        sum += report.depth[d];
+    while ((1u << log2n) <= N)
+        log2n++;
+    if (report.count != N || sum != N || report.depth[1] != 1 ||
+        report.max_depth < log2n || report.max_depth > 2 * log2n ||
+        report.avg_depth < 1 || report.avg_depth > report.max_depth) {
+        printf("失败 (节点数或深度错误)\n");
+        return 1;
+    }
+    if (!report.valid ||
+        report.black_height != __chx_rb_black_height(root.rb_node) ||
+        report.red != count_red(root.rb_node) ||
+        report.red_ratio != (double)report.red / N) {
+        printf("失败 (黑高或红节点统计错误)\n");
+        return 1;
+    }
+
+    /* 节点都在一个数组里 */
+    lo = (uintptr_t)&nodes[0].rb;
+    hi = (uintptr_t)&nodes[N - 1].rb + sizeof(struct chx_rb_node) - 1;
+    if (report.span_lines != hi / CHX_RB_PROFILE_LINE -
+                                 lo / CHX_RB_PROFILE_LINE + 1 ||
+        report.far_links >= N) {
+        printf("失败 (地址分布统计错误)\n");
+        return 1;
+    }
+
+    /* 把一个黑色非根节点染红后树不再合法 */
+    node = chx_rb_first(&root);
+    while (chx_rb_is_red(node))
+        node = chx_rb_parent(node);
+    node->__rb_parent_color ^= CHX_RB_BLACK;
+    chx_rb_profile(&root, &report);
+    node->__rb_parent_color ^= CHX_RB_BLACK;
+    if (report.valid) {
+        printf("失败 (未发现不合法的树)\n");
+        return 1;
+    }
+
+    /* RCU 读者在后台剖析, 写者同时插入 */
+    chx_rb_rcu_init(&domain);
+    pthread_create(&tid, NULL, monitor, &bad);
+    for (int i = 0; i < N; i++) {
+        rcu_nodes[i].key = rand();
+        chx_rb_find_add_rcu(&rcu_nodes[i].rb, &rcu_root, cmp_func);
+    }
+    stop = 1;
+    pthread_join(tid, NULL);
+    chx_rb_rcu_destroy(&domain);
+    chx_rb_profile(&rcu_root, &report);
+    chx_rb_profile_rcu(&rcu_root, &after);
+    if (bad || !after.valid || after.count != report.count ||
+        after.black_height != report.black_height ||
+        after.far_links != report.far_links) {
+        printf("失败 (RCU剖析结果错误)\n");
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_profile(); }
@@ -0,0 +1,121 @@
+#include "test_helper.h"
+#include "rbtree_ptree.h"
+#include "rbtree_augmented.h"
+#include <string.h>
+
+#define OPS 4000
+#define MAX_KEY 500
+#define SNAPSHOTS 8
+
+struct counters {
+    int live, copies;
+};
+
+static struct chx_rb_node* copy_node(const struct chx_rb_node* node,
+                                     void* ctx) {
+    struct counters* c = ctx;
+
+    c->live++;
+    c->copies++;
+    return &create_node(chx_rb_entry(node, struct test_node, rb)->key)->rb;
+}
+
+static void release_node(struct chx_rb_node* node, void* ctx) {
+    ((struct counters*)ctx)->live--;
+    free(chx_rb_entry(node, struct test_node, rb));
+}
+
+/* 版本内容应与计数一致 */
+static bool check(struct chx_rb_root* tree, const int* count) {
+    struct chx_rb_iter iter;
+    struct chx_rb_node* node;
+    int seen[MAX_KEY] = {0}, prev = -1;
+
+    if (check_rb(tree->rb_node, NULL, false) < 0 ||
+        (tree->rb_node && chx_rb_is_red(tree->rb_node)))
+        return false;
+    chx_rb_iter_for_each(node, &iter, tree) {
+        int key = chx_rb_entry(node, struct test_node, rb)->key;
+
+        if (key < prev)
+            return false;
+        prev = key;
+        seen[key]++;
+    }
+    return !memcmp(seen, count, sizeof(seen));
+}
+
+/* 测试33: 路径复制的持久化红黑树 */
+static int test_ptree(void) {
+    printf("测试33: 持久化红黑树...");
+    static int count[MAX_KEY], snap_count[SNAPSHOTS][MAX_KEY];
+    struct counters c = {0, 0};
+    struct chx_rb_ptree_ops ops = {copy_node, release_node, &c};
+    struct chx_rb_root tree = CHX_RB_ROOT, snaps[SNAPSHOTS];
+    int nsnaps = 0;
+
+    /* 没有快照时原地修改, 不复制节点 */
+    srand(33);
+    for (int i = 0; i < OPS; i++) {
+        int key = rand() % MAX_KEY;
+
+        if (rand() % 3) {
+            chx_rb_ptree_add(&create_node(key)->rb, &tree, less_func, &ops);
+            c.live++;
+            count[key]++;
+        } else if (chx_rb_ptree_erase(&key, &tree, key_cmp_func, &ops)) {
+            count[key]--;
+        }
+    }
+    if (c.copies || !check(&tree, count)) {
+        printf("失败 (无快照时树不合法或发生了复制)\n");
+        return 1;
+    }
+
+    /* 修改过程中定期取快照, 快照内容不再变化 */
+    for (int i = 0; i < OPS; i++) {
+        int key = rand() % MAX_KEY;
+
+        if (i % (OPS / SNAPSHOTS) == 0) {
+            snaps[nsnaps] = chx_rb_ptree_snapshot(&tree);
+            memcpy(snap_count[nsnaps++], count, sizeof(count));
+        }
+        if (rand() % 2) {
+            chx_rb_ptree_add(&create_node(key)->rb, &tree, less_func, &ops);
+            c.live++;
+            count[key]++;
+        } else if (chx_rb_ptree_erase(&key, &tree, key_cmp_func, &ops)) {
+            count[key]--;
+        }
+    }
+    if (!check(&tree, count)) {
+        printf("失败 (当前版本不合法)\n");
+        return 1;
+    }
+    for (int s = 0; s < nsnaps; s++) {
+        if (!check(&snaps[s], snap_count[s])) {
+            printf("失败 (快照%d被修改)\n", s);
+            return 1;
+        }
+    }
+
+    /* 以任意顺序释放各版本后, 所有节点都被回收 */
+    for (int s = 0; s < nsnaps; s += 2)
+        chx_rb_ptree_release(&snaps[s], &ops);
+    if (!check(&snaps[1], snap_count[1]) || !check(&tree, count)) {
+        printf("失败 (释放快照影响了其他版本)\n");
+        return 1;
+    }
+    chx_rb_ptree_release(&tree, &ops);
+    for (int s = 1; s < nsnaps; s += 2)
+        chx_rb_ptree_release(&snaps[s], &ops);
+    if (c.live != 0) {
+        printf("失败 (释放后仍有%d个节点)\n", c.live);
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_ptree(); }
@@ -0,0 +1,108 @@
+#include "test_helper.h"
+#include "rbtree_rcu.h"
+
+#define NR_KEYS 512
+#define POISON (-1)
+
+struct rcu_node {
+    int key;
+    struct chx_rb_node rb;
+    struct chx_rb_rcu_head rcu;
+};
+
+static struct chx_rb_rcu_domain domain;
+static struct chx_rb_root root = CHX_RB_ROOT;
+static volatile int stop;
+static long bad, reclaimed;
+static struct rcu_node* graveyard[NR_KEYS * 64];
+
+static int rcu_cmp(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    int ka = chx_rb_entry(a, struct rcu_node, rb)->key;
+    int kb = chx_rb_entry(b, struct rcu_node, rb)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int rcu_key_cmp(const void* key, const struct chx_rb_node* node) {
+    int k = *(const int*)key;
+    int nk = chx_rb_entry(node, struct rcu_node, rb)->key;
+    return k < nk ? -1 : k > nk;
+}
+
+/* 回调在写者线程中执行: 打上毒值, 延后到测试结束时再真正释放 */
+static void rcu_free(struct chx_rb_rcu_head* head) {
+    struct rcu_node* n = container_of(head, struct rcu_node, rcu);
+    n->key = POISON;
+    graveyard[reclaimed++] = n;
+}
+
+static void* reader(void* arg __attribute__((unused))) {
+    struct chx_rb_rcu_reader self;
+    long err = 0;
+
+    chx_rb_rcu_register(&domain, &self);
+    while (!stop) {
+        chx_rb_rcu_read_lock(&self);
+        for (int key = 0; key < NR_KEYS; key++) {
+            struct chx_rb_node* found =
+                chx_rb_find_rcu(&key, &root, rcu_key_cmp);
+            /* 找到的节点必须仍然有效 (未被回收) */
+            if (found && chx_rb_entry(found, struct rcu_node, rb)->key != key)
+                err++;
+        }
+        chx_rb_rcu_read_unlock(&self);
+    }
+    chx_rb_rcu_unregister(&self);
+    bad = err;
+    return NULL;
+}
+
+/* 测试14: RCU 发布与基于 epoch 的延迟回收 */
+static int test_rcu(void) {
+    printf("测试14: RCU延迟回收...");
+    pthread_t tid;
+    long deferred = 0;
+
+    chx_rb_rcu_init(&domain);
+    if (pthread_create(&tid, NULL, reader, NULL)) {
+        printf("失败 (pthread_create)\n");
+        return 1;
+    }
+
+    for (int round = 0; round < 32; round++) {
+        struct rcu_node* nodes[NR_KEYS];
+
+        for (int i = 0; i < NR_KEYS; i++) {
+            nodes[i] = malloc(sizeof(*nodes[i]));
+            nodes[i]->key = i;
+            chx_rb_find_add_rcu(&nodes[i]->rb, &root, rcu_cmp);
+        }
+        for (int i = 0; i < NR_KEYS; i++) {
+            chx_rb_erase(&nodes[i]->rb, &root);
+            chx_rb_defer_free(&domain, &nodes[i]->rcu, rcu_free);
+            deferred++;
+        }
+        chx_rb_rcu_poll(&domain);
+    }
+
+    stop = 1;
+    pthread_join(tid, NULL);
+    chx_rb_rcu_barrier(&domain);
+    chx_rb_rcu_destroy(&domain);
+
+    for (long i = 0; i < reclaimed; i++)
+        free(graveyard[i]);
+
+    if (bad) {
+        printf("失败 (读者看到了已回收的节点 %ld 次)\n", bad);
+        return 1;
+    }
+    if (reclaimed != deferred) {
+        printf("失败 (回收数量错误: %ld/%ld)\n", reclaimed, deferred);
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_rcu(); }
@@ -0,0 +1,117 @@
+#include "test_helper.h"
+#include <string.h>
+
+#define MAX_KEYS 200000
+
+enum { OP_UNION, OP_INTERSECT, OP_DIFFERENCE };
+
+static struct test_node a_nodes[MAX_KEYS], b_nodes[MAX_KEYS];
+static bool in_a[MAX_KEYS], in_b[MAX_KEYS];
+static int dropped_a[MAX_KEYS], dropped_b[MAX_KEYS];
+
+static int set_cmp(const struct chx_rb_node* a, const struct chx_rb_node* b) {
+    int ka = chx_rb_entry(a, struct test_node, rb)->key;
+    int kb = chx_rb_entry(b, struct test_node, rb)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+/* 可能在多个线程中被调用 */
+static void set_drop(struct chx_rb_node* node, void* ctx) {
+    struct test_node* tn = chx_rb_entry(node, struct test_node, rb);
+    int* count = ctx;
+
+    if (tn >= a_nodes && tn < a_nodes + MAX_KEYS)
+        __atomic_add_fetch(&dropped_a[tn - a_nodes], 1, __ATOMIC_RELAXED);
+    else
+        __atomic_add_fetch(&dropped_b[tn - b_nodes], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+}
+
+static void build(struct chx_rb_root* root, struct test_node* nodes,
+                  bool* in, int nkeys, int percent) {
+    for (int k = 0; k < nkeys; k++) {
+        in[k] = rand() % 100 < percent;
+        if (in[k]) {
+            nodes[k].key = k;
+            chx_rb_add(&nodes[k].rb, root, less_func);
+        }
+    }
+}
+
+/* 执行一次集合运算并与逐键计算的结果比较, 成功返回 0 */
+static int run_one(int op, int nkeys, int pa, int pb, unsigned nthreads) {
+    struct chx_rb_root a = CHX_RB_ROOT, b = CHX_RB_ROOT;
+    struct chx_rb_node* node;
+    int drops = 0, expect_drops = 0, kept = 0, k = 0;
+
+    build(&a, a_nodes, in_a, nkeys, pa);
+    build(&b, b_nodes, in_b, nkeys, pb);
+    memset(dropped_a, 0, nkeys * sizeof(int));
+    memset(dropped_b, 0, nkeys * sizeof(int));
+
+    if (op == OP_UNION)
+        chx_rb_union(&a, &b, set_cmp, set_drop, &drops, nthreads);
+    else if (op == OP_INTERSECT)
+        chx_rb_intersect(&a, &b, set_cmp, set_drop, &drops, nthreads);
+    else
+        chx_rb_difference(&a, &b, set_cmp, set_drop, &drops, nthreads);
+
+    if (b.rb_node)
+        return 1;
+
+    node = chx_rb_first(&a);
+    for (k = 0; k < nkeys; k++) {
+        bool keep_b =
+            in_b[k] && (op == OP_UNION || (op == OP_INTERSECT && in_a[k]));
+        bool keep_a = in_a[k] && !in_b[k] && op != OP_INTERSECT;
+        struct test_node* want =
+            keep_b ? &b_nodes[k] : (keep_a ? &a_nodes[k] : NULL);
+
+        if (want) {
+            if (node != &want->rb)
+                return 1;
+            node = chx_rb_next(node);
+            kept++;
+        }
+        /* 不在结果中的节点恰好被 drop 一次 */
+        if (dropped_a[k] != (in_a[k] && !keep_a) ||
+            dropped_b[k] != (in_b[k] && !keep_b))
+            return 1;
+        expect_drops += dropped_a[k] + dropped_b[k];
+    }
+    if (node || drops != expect_drops || !valid_tree(&a, kept))
+        return 1;
+    return 0;
+}
+
+/* 测试20: 基于 join/split 的并行集合运算 */
+static int test_setops(void) {
+    static const char* const names[] = {"并集", "交集", "差集"};
+
+    printf("测试20: 集合运算...");
+    srand(20);
+
+    for (int op = OP_UNION; op <= OP_DIFFERENCE; op++) {
+        for (int round = 0; round < 300; round++) {
+            int nkeys = 1 + rand() % 300;
+            int pa = rand() % 101, pb = rand() % 101;
+
+            if (run_one(op, nkeys, pa, pb, 1)) {
+                printf("失败 (%s, nkeys=%d)\n", names[op], nkeys);
+                return 1;
+            }
+        }
+        /* 足够大的树才会真正分到多个线程 */
+        if (run_one(op, MAX_KEYS, 50, 50, 4) ||
+            run_one(op, MAX_KEYS, 90, 2, 4) ||
+            run_one(op, MAX_KEYS, 2, 90, 3)) {
+            printf("失败 (%s, 多线程)\n", names[op]);
+            return 1;
+        }
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_setops(); }
@@ -0,0 +1,132 @@
+#include "test_helper.h"
+#include "rbtree_order.h"
+#include <pthread.h>
+#include <string.h>
+
+#define N 5000
+
+struct os_test_node {
+    int key;
+    struct chx_rb_os_node os;
+};
+
+static struct os_test_node os_nodes[N];
+static struct test_node typed_nodes[N];
+
+CHX_RB_DECLARE_TREE(stat_tree, struct test_node, rb, int, key,
+                    chx_rb_cmp_scalar)
+
+static bool os_less(struct chx_rb_node* a, const struct chx_rb_node* b) {
+    return chx_rb_entry(a, struct os_test_node, os.rb)->key <
+           chx_rb_entry(b, struct os_test_node, os.rb)->key;
+}
+
+static bool is_zero(const struct chx_rb_stats* s) {
+    static const struct chx_rb_stats zero;
+    return !memcmp(s, &zero, sizeof(zero));
+}
+
+/*
+ * 插入, 查找, 求上下界并删除 N 个节点, 再在顺序统计树上增删,
+ * 最后在类型化树上插入并查找
+ */
+static void workload(void) {
+    struct chx_rb_root root = CHX_RB_ROOT, os_root = CHX_RB_ROOT;
+    struct chx_rb_root typed_root = CHX_RB_ROOT;
+    struct chx_rb_node *node, *end;
+
+    for (int i = 0; i < N; i++)
+        chx_rb_add(&create_node(rand() % N)->rb, &root, less_func);
+    for (int k = 0; k < N; k++) {
+        int hi = k + 10;
+
+        chx_rb_find(&k, &root, key_cmp_func);
+        chx_rb_lower_bound(&k, &root, key_cmp_func);
+        chx_rb_upper_bound(&k, &root, key_cmp_func);
+        chx_rb_floor(&k, &root, key_cmp_func);
+        chx_rb_range_first(&k, &hi, &root, key_cmp_func, &end);
+    }
+    while ((node = root.rb_node)) {
+        chx_rb_erase(node, &root);
+        free(chx_rb_entry(node, struct test_node, rb));
+    }
+
+    for (int i = 0; i < N; i++) {
+        os_nodes[i].key = rand() % N;
+        chx_rb_os_add(&os_nodes[i].os, &os_root, os_less);
+    }
+    for (int i = 0; i < N; i++)
+        chx_rb_os_erase(&os_nodes[i].os, &os_root);
+
+    for (int i = 0; i < N; i++) {
+        typed_nodes[i].key = rand() % N;
+        stat_tree_insert(&typed_nodes[i], &typed_root);
+    }
+    for (int k = 0; k < N; k++) {
+        stat_tree_find(k, &typed_root);
+        stat_tree_lower_bound(k, &typed_root);
+    }
+}
+
+static void* thread_fn(void* arg) {
+    workload();
+    chx_rb_stats_snapshot(arg);
+    return NULL;
+}
+
+/* 测试34: 热路径统计计数 */
+static int test_stats(void) {
+    printf("测试34: 统计计数...");
+    struct chx_rb_stats s, other, again;
+    pthread_t thread;
+    bool ok;
+
+    srand(34);
+    chx_rb_stats_reset();
+    workload();
+    chx_rb_stats_snapshot(&s);
+#ifdef CHX_RB_STATS
+    if (s.descents != 10 * N || s.descent_steps <= s.descents ||
+        s.erase_cases[0] + s.erase_cases[1] + s.erase_cases[2] != 2 * N) {
+        printf("失败 (下降或删除情况计数错误)\n");
+        return 1;
+    }
+    if (!s.insert_recolors || !s.insert_rotations || !s.erase_recolors ||
+        !s.erase_rotations || !s.erase_cases[2] || !s.successor_steps ||
+        !s.propagate_steps) {
+        printf("失败 (有计数未增长)\n");
+        return 1;
+    }
+#else
+    if (!is_zero(&s)) {
+        printf("失败 (未启用统计时计数不为零)\n");
+        return 1;
+    }
+#endif
+
+    /* 计数按线程分开, 另一线程做同样的工作 */
+    pthread_create(&thread, NULL, thread_fn, &other);
+    pthread_join(thread, NULL);
+    chx_rb_stats_snapshot(&again);
+#ifdef CHX_RB_STATS
+    ok = other.descents == s.descents;
+#else
+    ok = is_zero(&other);
+#endif
+    if (!ok || memcmp(&again, &s, sizeof(s))) {
+        printf("失败 (线程之间的计数互相影响)\n");
+        return 1;
+    }
+
+    chx_rb_stats_reset();
+    chx_rb_stats_snapshot(&s);
+    if (!is_zero(&s)) {
+        printf("失败 (重置后计数不为零)\n");
+        return 1;
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_stats(); }
@@ -0,0 +1,91 @@
+#include "test_helper.h"
+
+#define N 5000
+
+struct typed_node {
+    struct chx_rb_node rb;
+    long key;
+};
+
+CHX_RB_DECLARE_TREE(typed, struct typed_node, rb, long, key, chx_rb_cmp_scalar)
+
+/* 测试24: 宏生成的类型化树 */
+static int test_typed(void) {
+    printf("测试24: 类型化树...");
+    static struct typed_node nodes[N], dups[N];
+    struct chx_rb_root root = CHX_RB_ROOT;
+    struct chx_rb_root_cached croot = CHX_RB_ROOT_CACHED;
+    struct typed_node* t;
+
+    /* 偶数键, 乱序插入 */
+    for (int i = 0; i < N; i++) {
+        nodes[i].key = (long)((i * 7919L) % N) * 2;
+        typed_insert(&nodes[i], &root);
+    }
+    for (long k = 0; k < 2 * N; k++) {
+        t = typed_find(k, &root);
+        if (k % 2 ? t != NULL : !t || t->key != k) {
+            printf("失败 (查找键%ld结果错误)\n", k);
+            return 1;
+        }
+        t = typed_lower_bound(k, &root);
+        if (k == 2 * N - 1 ? t != NULL : !t || t->key != (k + 1) / 2 * 2) {
+            printf("失败 (键%ld的下界错误)\n", k);
+            return 1;
+        }
+    }
+
+    /* 重复键: find_add 返回已有节点, lower_bound 返回最左的一个 */
+    for (int i = 0; i < N; i++) {
+        dups[i].key = nodes[i].key;
+        if (typed_find_add(&dups[i], &root) != &nodes[i]) {
+            printf("失败 (find_add未返回已有节点)\n");
+            return 1;
+        }
+        typed_insert(&dups[i], &root);
+    }
+    for (int i = 0; i < N; i++) {
+        t = typed_lower_bound(nodes[i].key, &root);
+        if (t != &nodes[i]) {
+            printf("失败 (重复键的下界不是最左节点)\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < N; i++)
+        typed_erase(&nodes[i], &root);
+    for (int i = 0; i < N; i++) {
+        if (typed_find(dups[i].key, &root) != &dups[i]) {
+            printf("失败 (删除后查找错误)\n");
+            return 1;
+        }
+        typed_erase(&dups[i], &root);
+    }
+    if (root.rb_node) {
+        printf("失败 (删除后树不为空)\n");
+        return 1;
+    }
+
+    /* cached 版本维护最左节点 */
+    for (int i = 0; i < N; i++) {
+        if (i % 2)
+            typed_insert_cached(&nodes[i], &croot);
+        else if (typed_find_add_cached(&nodes[i], &croot))
+            continue;
+        if (chx_rb_first_cached(&croot) != chx_rb_first(&croot.rb_root)) {
+            printf("失败 (最左节点缓存错误)\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        typed_erase_cached(&nodes[i], &croot);
+        if (chx_rb_first_cached(&croot) != chx_rb_first(&croot.rb_root)) {
+            printf("失败 (删除后最左节点缓存错误)\n");
+            return 1;
+        }
+    }
+
+    printf("通过\n");
+    return 0;
+}
+
+int main(void) { return test_typed(); }